@@ -0,0 +1,176 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Backoff policies for spin loops.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+Every lock and container in this repo takes a backoff policy template parameter,
+which is used in each spin loop and each compare and swap retry loop.
+The default policy is no_backoff, which keeps the loops tight as before.
+
+A backoff policy is a default constructible class with
+    void operator()()
+A new policy object is constructed at the start of each wait, and called once after each failed attempt.
+So the policy can count attempts and escalate, and starts afresh for the next wait.
+
+Policies:
+    no_backoff              : tight loop. Lowest handoff latency on an otherwise idle core.
+    pause_backoff           : cpu pause hint per attempt. Frees pipeline resources for the SMT sibling
+                              and saves power, at a small cost in handoff latency.
+    exponential_backoff     : 1, 2, 4 ... max_pauses pauses per attempt with random jitter,
+                              so that colliding threads spread out their retries.
+    yield_backoff           : pause for spins attempts, then yield the core to another thread.
+                              For when there may be more threads than cores.
+    park_backoff            : pause for spins attempts, then sleep for exponentially growing
+                              intervals from 1 microsecond up to max_sleep_us microseconds.
+                              For long waits, where burning a core is worse than wake-up latency.
+    adaptive_backoff        : in calibration.h. As park_backoff, but the spin and yield counts
+                              are calibrated for the host at startup instead of fixed.
+    oversubscription_backoff: in oversubscription.h. As yield_backoff, but yields after a few spins
+                              while threads outnumber cores, eg. on shared hosts.
+*/
+
+namespace lockfree
+{
+
+// cpu hint that this is a spin wait loop.
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::: "memory");
+#else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+struct no_backoff
+{
+    void operator()()
+    {
+    }
+};
+
+struct pause_backoff
+{
+    void operator()()
+    {
+        cpu_relax();
+    }
+};
+
+template<unsigned int max_pauses = 1024>
+class exponential_backoff
+{
+public:
+    static_assert(max_pauses > 0, "exponential_backoff needs max_pauses > 0.");
+
+    exponential_backoff() : m_limit(1)
+    {
+    }
+
+    void operator()()
+    {
+        // Jitter: pause a random count in [limit/2, limit].
+        auto pauses = (m_limit / 2) + (next_random() % (m_limit / 2 + 1));
+        for (unsigned int i = 0; i < pauses; ++i)
+        {
+            cpu_relax();
+        }
+
+        if (m_limit < max_pauses)
+        {
+            m_limit = (m_limit * 2 < max_pauses) ? m_limit * 2 : max_pauses;
+        }
+    }
+
+private:
+    // xorshift per thread. Quality doesn't matter here, only that threads don't retry in step.
+    static unsigned int next_random()
+    {
+        static thread_local std::uint32_t state = 0;
+        if (!state)
+        {
+            state = static_cast<std::uint32_t>(reinterpret_cast<std::uintptr_t>(&state) >> 4) | 1;
+        }
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    unsigned int m_limit;
+};
+
+template<unsigned int spins = 64>
+class yield_backoff
+{
+public:
+    yield_backoff() : m_count(0)
+    {
+    }
+
+    void operator()()
+    {
+        if (m_count < spins)
+        {
+            m_count++;
+            cpu_relax();
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    unsigned int m_count;
+};
+
+template<unsigned int spins = 1024, unsigned int max_sleep_us = 1000>
+class park_backoff
+{
+public:
+    park_backoff() : m_count(0), m_sleep_us(1)
+    {
+    }
+
+    void operator()()
+    {
+        if (m_count < spins)
+        {
+            m_count++;
+            cpu_relax();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(m_sleep_us));
+            m_sleep_us = (m_sleep_us * 2 < max_sleep_us) ? m_sleep_us * 2 : max_sleep_us;
+        }
+    }
+
+private:
+    unsigned int m_count;
+    unsigned int m_sleep_us;
+};
+
+}
@@ -0,0 +1,258 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "backoff.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <mutex>
+#include <condition_variable>
+#endif
+
+// One-time calibration of spin budgets for the host, and the adaptive backoff policy that uses them.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+Spinning before parking pays off only while the spin is shorter than a park and wake-up.
+The cost of one cpu pause varies by an order of magnitude across cpu generations,
+so a fixed spin count is too short on some machines and too long on others.
+
+Calibration measures on the host
+    pause_ns    : latency of one cpu_relax().
+    yield_ns    : latency of one std::this_thread::yield().
+    wake_ns     : latency from a futex wake until the woken thread runs.
+                  On other than Linux a condition_variable is measured instead.
+and derives
+    spins_before_park   : pauses that take as long as one wake-up.
+    yields_before_park  : yields that take as long as one wake-up.
+
+spin_calibration::budget() calibrates on its first call and returns the same budget after.
+Calibration takes a few milliseconds, so call budget() once at startup,
+rather than let the first contended lock pay for it.
+spin_calibration::set() replaces the budget, eg. with values measured offline for a fleet.
+
+adaptive_backoff is the backoff policy for backoff.h that follows the budget:
+    pause for spins_before_park attempts, then yield for yields_before_park attempts,
+    then sleep for exponentially growing intervals from 1 microsecond up to max_sleep_us microseconds.
+Blocking operations that park on the parking lot use spins_before_park as their spin phase.
+*/
+
+namespace lockfree
+{
+
+struct spin_budget
+{
+    double pause_ns;
+    double yield_ns;
+    double wake_ns;
+
+    unsigned int spins_before_park;
+    unsigned int yields_before_park;
+};
+
+class spin_calibration
+{
+public:
+    static const unsigned int min_spins = 16;
+    static const unsigned int max_spins = 1 << 16;
+    static const unsigned int max_yields = 64;
+
+    static const spin_budget & budget()
+    {
+        return current();
+    }
+
+    // Not thread safe with respect to concurrent budget() readers. Call at startup.
+    static void set(const spin_budget & b)
+    {
+        current() = b;
+    }
+
+    // Measures afresh. Does not change the stored budget.
+    static spin_budget measure()
+    {
+        spin_budget b;
+        b.pause_ns = measure_pause_ns();
+        b.yield_ns = measure_yield_ns();
+        b.wake_ns = measure_wake_ns();
+
+        auto spins = b.wake_ns / std::max(b.pause_ns, 0.1);
+        b.spins_before_park = static_cast<unsigned int>(std::min<double>(std::max<double>(spins, min_spins), max_spins));
+
+        auto yields = b.wake_ns / std::max(b.yield_ns, 1.0);
+        b.yields_before_park = static_cast<unsigned int>(std::min<double>(std::max<double>(yields, 1), max_yields));
+
+        return b;
+    }
+
+private:
+    static spin_budget & current()
+    {
+        static spin_budget b = measure();
+        return b;
+    }
+
+    template<typename Fn>
+    static double time_ns(Fn fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto stop = std::chrono::steady_clock::now();
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+    }
+
+    // Best of several runs, since a run may be disturbed by an interrupt or preemption.
+    static double measure_pause_ns()
+    {
+        static const unsigned int pauses = 1000;
+        double best = 1e12;
+        for (int run = 0; run < 5; ++run)
+        {
+            best = std::min(best, time_ns([]() {
+                for (unsigned int i = 0; i < pauses; ++i)
+                {
+                    cpu_relax();
+                }
+            }));
+        }
+        return best / pauses;
+    }
+
+    static double measure_yield_ns()
+    {
+        static const unsigned int yields = 100;
+        double best = 1e12;
+        for (int run = 0; run < 5; ++run)
+        {
+            best = std::min(best, time_ns([]() {
+                for (unsigned int i = 0; i < yields; ++i)
+                {
+                    std::this_thread::yield();
+                }
+            }));
+        }
+        return best / yields;
+    }
+
+    // Ping pong between two threads that each sleep until woken by the other.
+    // Each round trip is two wake-ups.
+    static double measure_wake_ns()
+    {
+        static const int round_trips = 100;
+
+        std::atomic<int> word{ 0 };
+
+        std::thread peer([&word]() {
+            for (int i = 0; i < round_trips; ++i)
+            {
+                wait_while(word, 2 * i);
+                word.store(2 * i + 2, std::memory_order_release);
+                wake(word);
+            }
+        });
+
+        auto total = time_ns([&word]() {
+            for (int i = 0; i < round_trips; ++i)
+            {
+                word.store(2 * i + 1, std::memory_order_release);
+                wake(word);
+                wait_while(word, 2 * i + 1);
+            }
+        });
+
+        peer.join();
+        return total / (2 * round_trips);
+    }
+
+#ifdef __linux__
+    static void wait_while(std::atomic<int> & word, int value)
+    {
+        while (word.load(std::memory_order_acquire) == value)
+        {
+            syscall(SYS_futex, reinterpret_cast<int *>(&word), FUTEX_WAIT_PRIVATE, value, nullptr, nullptr, 0);
+        }
+    }
+
+    static void wake(std::atomic<int> & word)
+    {
+        syscall(SYS_futex, reinterpret_cast<int *>(&word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+#else
+    static std::mutex & cv_mutex()
+    {
+        static std::mutex m;
+        return m;
+    }
+
+    static std::condition_variable & cv()
+    {
+        static std::condition_variable c;
+        return c;
+    }
+
+    static void wait_while(std::atomic<int> & word, int value)
+    {
+        std::unique_lock<std::mutex> lk(cv_mutex());
+        cv().wait(lk, [&word, value]() { return word.load(std::memory_order_acquire) != value; });
+    }
+
+    static void wake(std::atomic<int> &)
+    {
+        std::lock_guard<std::mutex> lk(cv_mutex());
+        cv().notify_all();
+    }
+#endif
+};
+
+template<unsigned int max_sleep_us = 1000>
+class basic_adaptive_backoff
+{
+public:
+    basic_adaptive_backoff() : m_budget(spin_calibration::budget()), m_count(0), m_sleep_us(1)
+    {
+    }
+
+    void operator()()
+    {
+        if (m_count < m_budget.spins_before_park)
+        {
+            m_count++;
+            cpu_relax();
+        }
+        else if (m_count < m_budget.spins_before_park + m_budget.yields_before_park)
+        {
+            m_count++;
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(m_sleep_us));
+            m_sleep_us = (m_sleep_us * 2 < max_sleep_us) ? m_sleep_us * 2 : max_sleep_us;
+        }
+    }
+
+private:
+    const spin_budget & m_budget;
+    unsigned int m_count;
+    unsigned int m_sleep_us;
+};
+
+using adaptive_backoff = basic_adaptive_backoff<>;
+
+}
@@ -0,0 +1,214 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "backoff.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+// Detection of oversubscription, and the backoff policy that yields early when it is detected.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+The locks and containers of this repo assume a software thread per core. When threads outnumber
+cores, a thread may be preempted holding a spin lock, eg. the refill lock of queue.h, or halfway
+through shared_mutex::lock(), and the threads waiting on it spin for a whole scheduler quantum,
+on cores the preempted thread could run on.
+
+oversubscription tells whether waiters should give up their core early. Its mode is
+    off     : never. Spin the full budget, as for a thread per core.
+    on      : always.
+    detect  : the default. When a waiter spun its full budget within the last hold_ms milliseconds,
+              which is the sign of a preempted lock holder, or when more threads are runnable than
+              this process has cpus, sampled from /proc/loadavg at most every sample_ms milliseconds.
+
+oversubscription_backoff is the backoff policy for backoff.h that follows it:
+    pause for oversubscribed_spins attempts. Then, if oversubscription is active, yield every attempt,
+    else pause up to spins attempts, report the budget exhausted, and yield after that.
+A wait that succeeds within the first oversubscribed_spins attempts, as most do, never asks,
+so the uncontended path costs the same as pause_backoff.
+
+Restartable sequences (rseq) would tell a thread it was preempted inside a critical section,
+but not a waiter that the thread it waits for was. So detection here rests on spin budgets.
+*/
+
+namespace lockfree
+{
+
+enum class oversubscription_mode
+{
+    off,
+    on,
+    detect
+};
+
+class oversubscription
+{
+public:
+    // How long a waiter that spun its full budget keeps the short budget on.
+    static const unsigned int hold_ms = 100;
+    // How often the runnable thread count is sampled.
+    static const unsigned int sample_ms = 10;
+
+    static oversubscription_mode mode()
+    {
+        return static_cast<oversubscription_mode>(state().mode.load(std::memory_order_relaxed));
+    }
+
+    static void set_mode(oversubscription_mode m)
+    {
+        state().mode.store(static_cast<int>(m), std::memory_order_relaxed);
+    }
+
+    // True if waiters should yield early.
+    static bool active()
+    {
+        auto & s = state();
+        switch (mode())
+        {
+        case oversubscription_mode::off:
+            return false;
+        case oversubscription_mode::on:
+            return true;
+        default:
+            break;
+        }
+
+        if (exhausted_recently())
+        {
+            return true;
+        }
+        auto now = now_ms();
+
+        // One thread samples, the others use the last sample.
+        auto sampled = s.sampledMs.load(std::memory_order_relaxed);
+        if (now - sampled >= sample_ms && s.sampledMs.compare_exchange_strong(sampled, now, std::memory_order_relaxed))
+        {
+            auto runnable = runnable_threads();
+            s.overloaded.store(runnable > usable_cpus(), std::memory_order_relaxed);
+        }
+        return s.overloaded.load(std::memory_order_relaxed);
+    }
+
+    // Called by a waiter that spun its full budget.
+    static void report_exhausted()
+    {
+        state().exhaustedMs.store(now_ms(), std::memory_order_relaxed);
+    }
+
+    // True if a waiter reported its full budget spun within the last hold_ms milliseconds.
+    static bool exhausted_recently()
+    {
+        return now_ms() - state().exhaustedMs.load(std::memory_order_relaxed) < hold_ms;
+    }
+
+    // Runnable threads of the whole system, the calling one included. 0 if not known.
+    static unsigned int runnable_threads()
+    {
+        // eg. "0.52 0.58 0.59 3/467 12345", where 3 are runnable.
+        std::ifstream f("/proc/loadavg");
+        std::string load1, load5, load15, tasks;
+        if (!(f >> load1 >> load5 >> load15 >> tasks))
+        {
+            return 0;
+        }
+        auto slash = tasks.find('/');
+        if (slash == std::string::npos || slash == 0)
+        {
+            return 0;
+        }
+        return static_cast<unsigned int>(std::stoul(tasks.substr(0, slash)));
+    }
+
+    // cpus this process may run on.
+    static unsigned int usable_cpus()
+    {
+#ifdef __linux__
+        cpu_set_t set;
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+        {
+            return static_cast<unsigned int>(CPU_COUNT(&set));
+        }
+#endif
+        auto cpus = std::thread::hardware_concurrency();
+        return cpus ? cpus : 1;
+    }
+
+private:
+    struct shared_state
+    {
+        std::atomic<int> mode{ static_cast<int>(oversubscription_mode::detect) };
+        // Far enough in the past that no hold is on at start.
+        std::atomic<std::int64_t> exhaustedMs{ -static_cast<std::int64_t>(hold_ms) };
+        std::atomic<std::int64_t> sampledMs{ -static_cast<std::int64_t>(sample_ms) };
+        std::atomic<bool> overloaded{ false };
+    };
+
+    static shared_state & state()
+    {
+        static shared_state s;
+        return s;
+    }
+
+    // Relative to the first call, so that the initial values above are in the past.
+    static std::int64_t now_ms()
+    {
+        static const auto start = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+template<unsigned int spins = 1024, unsigned int oversubscribed_spins = 16>
+class oversubscription_backoff
+{
+public:
+    static_assert(oversubscribed_spins > 0 && oversubscribed_spins <= spins, "oversubscription_backoff needs 0 < oversubscribed_spins <= spins.");
+
+    oversubscription_backoff() : m_count(0), m_budget(oversubscribed_spins)
+    {
+    }
+
+    void operator()()
+    {
+        m_count++;
+        if (m_count == oversubscribed_spins)
+        {
+            m_budget = oversubscription::active() ? oversubscribed_spins : spins;
+        }
+
+        if (m_count <= m_budget)
+        {
+            cpu_relax();
+            return;
+        }
+        // Only the full budget is a sign of a preempted lock holder. A waiter past the short budget
+        // must not report, else it would re-arm the hold for as long as there is contention.
+        if (m_count == m_budget + 1 && m_budget == spins)
+        {
+            oversubscription::report_exhausted();
+        }
+        std::this_thread::yield();
+    }
+
+private:
+    unsigned int m_count;
+    unsigned int m_budget;
+};
+
+}
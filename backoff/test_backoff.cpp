@@ -0,0 +1,182 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread -march=native test_backoff.cpp -latomic
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "backoff.h"
+#include "../mutex/shared_mutex.h"
+#include "../mutex/spin_lock.h"
+#include "../stack/stack.h"
+
+#include <iostream>
+#include <future>
+#include <vector>
+#include <set>
+#include <chrono>
+#include <stdexcept>
+
+using std::cout;
+using std::vector;
+using std::set;
+using std::logic_error;
+using std::flush;
+using std::future;
+namespace chrono = std::chrono;
+
+using namespace lockfree;
+
+bool testcase_policies()
+{
+    bool bResult = false;
+    try
+    {
+        no_backoff nb;
+        pause_backoff pb;
+        exponential_backoff<64> eb;
+        yield_backoff<4> yb;
+        for (int c = 0; c < 100; ++c)
+        {
+            nb();
+            pb();
+            eb();
+            yb();
+        }
+
+        // park_backoff must sleep once past its spins, with growing intervals up to the cap.
+        park_backoff<2, 400> kb;
+        auto start = chrono::steady_clock::now();
+        for (int c = 0; c < 2 + 6; ++c)
+        {
+            kb();
+        }
+        auto slept = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+        // 1 + 2 + 4 + 8 + 16 + 32 microseconds at least.
+        if (slept < 63) throw logic_error("park_backoff did not sleep.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : policies test - each policy callable, park_backoff sleeps." << std::flush;
+    return bResult;
+}
+
+// A lock with a backoff policy must still be a correct lock.
+template<typename shared_mutex_type>
+bool testcase_shared_mutex(const char * name)
+{
+    shared_mutex_type sm;
+
+    static const int threads = 4;
+    static const int increments = 2000;
+
+    volatile long long counter = 0;
+
+    bool failed = false;
+    {
+        vector<future<void>> vf;
+        for (int t = 0; t < threads; ++t)
+        {
+            vf.emplace_back(async(std::launch::async, [&sm, &counter]() {
+                for (int c = 0; c < increments; ++c)
+                {
+                    sm.lock();
+                    counter = counter + 1;
+                    sm.unlock();
+
+                    sm.lock_shared();
+                    sm.unlock_shared();
+                }
+            }));
+        }
+        try
+        {
+            for (auto & task : vf)
+            {
+                task.get();
+            }
+        }
+        catch (std::exception & e)
+        {
+            failed = true;
+#ifdef PRINT_TRACE
+            std::cerr << "\n" << e.what() << std::flush;
+#endif
+        }
+    }
+
+    if (counter != static_cast<long long>(threads) * increments)
+    {
+        failed = true;
+    }
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : parallelism test - shared_mutex with " << name << std::flush;
+    return !failed;
+}
+
+template<typename stack_type>
+bool testcase_stack(const char * name)
+{
+    stack_type s;
+
+    static const int threads = 4;
+    static const int items = 1000;
+
+    {
+        vector<future<void>> vf;
+        for (int t = 0; t < threads; ++t)
+        {
+            vf.emplace_back(async(std::launch::async, [&s, t]() {
+                for (int c = 0; c < items; ++c)
+                {
+                    s.push(t * items + c);
+                }
+            }));
+        }
+        for (auto & task : vf)
+        {
+            task.wait();
+        }
+    }
+
+    set<int> output;
+    int i = 0;
+    while (s.pop(i))
+    {
+        output.insert(i);
+    }
+
+    bool failed = (output.size() != static_cast<size_t>(threads * items));
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : parallelism test - stack with " << name << std::flush;
+    return !failed;
+}
+
+#define RUN_TEST(...) { if (!(__VA_ARGS__)) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_policies());
+
+    RUN_TEST(testcase_shared_mutex<basic_shared_mutex<pause_backoff>>("pause_backoff"));
+    RUN_TEST(testcase_shared_mutex<basic_shared_mutex<exponential_backoff<>>>("exponential_backoff"));
+    RUN_TEST(testcase_shared_mutex<basic_shared_mutex<yield_backoff<>>>("yield_backoff"));
+    RUN_TEST(testcase_shared_mutex<basic_shared_mutex<park_backoff<>>>("park_backoff"));
+
+    RUN_TEST(testcase_stack<stack<int, exponential_backoff<>>>("exponential_backoff"));
+    RUN_TEST(testcase_stack<stack<int, yield_backoff<>>>("yield_backoff"));
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
@@ -0,0 +1,133 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread -march=native test_calibration.cpp
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "calibration.h"
+#include "../mutex/shared_mutex.h"
+#include "../mutex/mcs_lock.h"
+
+#include <mutex>
+#include <iostream>
+#include <future>
+#include <vector>
+#include <stdexcept>
+
+using std::cout;
+using std::vector;
+using std::logic_error;
+using std::flush;
+using std::future;
+
+using namespace lockfree;
+
+bool testcase_budget()
+{
+    bool bResult = false;
+    try
+    {
+        auto & b = spin_calibration::budget();
+
+        if (!(b.pause_ns > 0) || !(b.yield_ns > 0) || !(b.wake_ns > 0)) throw logic_error("measured latency not positive.");
+        if (b.spins_before_park < spin_calibration::min_spins || b.spins_before_park > spin_calibration::max_spins)
+            throw logic_error("spins_before_park out of range.");
+        if (b.yields_before_park < 1 || b.yields_before_park > spin_calibration::max_yields)
+            throw logic_error("yields_before_park out of range.");
+
+        // calibrated once.
+        if (&spin_calibration::budget() != &b) throw logic_error("budget not stored.");
+
+#ifdef PRINT_TRACE
+        cout << "\n pause " << b.pause_ns << " ns, yield " << b.yield_ns << " ns, wake " << b.wake_ns << " ns"
+            << " -> spins_before_park " << b.spins_before_park << ", yields_before_park " << b.yields_before_park;
+#endif
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : budget test - calibrated values in range and stored." << std::flush;
+    return bResult;
+}
+
+bool testcase_set()
+{
+    auto saved = spin_calibration::budget();
+
+    spin_budget fixed = saved;
+    fixed.spins_before_park = 100;
+    fixed.yields_before_park = 2;
+    spin_calibration::set(fixed);
+
+    bool ok = (spin_calibration::budget().spins_before_park == 100) && (spin_calibration::budget().yields_before_park == 2);
+
+    // adaptive_backoff must go through all of its phases without trouble.
+    adaptive_backoff ab;
+    for (int c = 0; c < 100 + 2 + 3; ++c)
+    {
+        ab();
+    }
+
+    spin_calibration::set(saved);
+
+    cout << (ok ? "\n success" : "\n FAIL");
+    cout << " : set test - budget can be replaced." << std::flush;
+    return ok;
+}
+
+template<typename lock_type>
+bool testcase_adaptive_lock(const char * name)
+{
+    lock_type l;
+
+    static const int threads = 4;
+    static const int increments = 2000;
+
+    volatile long long counter = 0;
+
+    {
+        vector<future<void>> vf;
+        for (int t = 0; t < threads; ++t)
+        {
+            vf.emplace_back(async(std::launch::async, [&l, &counter]() {
+                for (int c = 0; c < increments; ++c)
+                {
+                    std::lock_guard<lock_type> lg(l);
+                    counter = counter + 1;
+                }
+            }));
+        }
+        for (auto & task : vf)
+        {
+            task.wait();
+        }
+    }
+
+    bool ok = (counter == static_cast<long long>(threads) * increments);
+
+    cout << (ok ? "\n success" : "\n FAIL");
+    cout << " : parallelism test - adaptive_backoff " << name << std::flush;
+    return ok;
+}
+
+#define RUN_TEST(...) { if (!(__VA_ARGS__)) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_budget());
+    RUN_TEST(testcase_set());
+    RUN_TEST(testcase_adaptive_lock<basic_shared_mutex<adaptive_backoff>>("shared_mutex"));
+    RUN_TEST(testcase_adaptive_lock<basic_mcs_lock<adaptive_backoff>>("mcs_lock"));
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
@@ -0,0 +1,235 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread -march=native test_oversubscription.cpp -latomic
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "oversubscription.h"
+#include "../mutex/shared_mutex.h"
+#include "../mutex/spin_lock.h"
+#include "../queue/queue.h"
+
+#include <iostream>
+#include <future>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+
+using std::cout;
+using std::vector;
+using std::logic_error;
+using std::flush;
+using std::future;
+namespace chrono = std::chrono;
+
+using namespace lockfree;
+
+bool testcase_modes()
+{
+    bool bResult = false;
+    try
+    {
+        if (oversubscription::mode() != oversubscription_mode::detect) throw logic_error("default mode not detect.");
+        if (oversubscription::usable_cpus() == 0) throw logic_error("no usable cpus.");
+
+        oversubscription::set_mode(oversubscription_mode::on);
+        if (!oversubscription::active()) throw logic_error("mode on not active.");
+        oversubscription::set_mode(oversubscription_mode::off);
+        oversubscription::report_exhausted();
+        if (oversubscription::active()) throw logic_error("mode off active.");
+
+        // A wait that spun its full budget holds the short budget on.
+        oversubscription::set_mode(oversubscription_mode::detect);
+        oversubscription::report_exhausted();
+        if (!oversubscription::active()) throw logic_error("exhausted budget not detected.");
+
+        // yields after the budget, whatever the mode.
+        oversubscription_backoff<32, 4> ob;
+        for (int c = 0; c < 100; ++c)
+        {
+            ob();
+        }
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : modes test - off, on, and detection of an exhausted spin budget." << std::flush;
+    return bResult;
+}
+
+// Waiters that get past the short budget do not re-arm the hold, so detection turns off once load drops.
+bool testcase_hold_expires()
+{
+    bool bResult = false;
+    try
+    {
+        oversubscription::set_mode(oversubscription_mode::detect);
+        oversubscription::report_exhausted();
+        if (!oversubscription::exhausted_recently()) throw logic_error("exhausted budget not held.");
+
+        // Waits past the short budget, but within the full one, for longer than the hold.
+        auto end = chrono::steady_clock::now() + chrono::milliseconds(oversubscription::hold_ms + oversubscription::hold_ms / 2);
+        while (chrono::steady_clock::now() < end)
+        {
+            oversubscription_backoff<1024, 16> ob;
+            for (int c = 0; c < 20; ++c)
+            {
+                ob();
+            }
+        }
+        if (oversubscription::exhausted_recently()) throw logic_error("short budget re-armed the hold.");
+
+        // Still active only if the run queue says so.
+        if (oversubscription::active() && oversubscription::runnable_threads() <= oversubscription::usable_cpus())
+        {
+            throw logic_error("detection still active after the hold.");
+        }
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : hold expires test - waiters past the short budget do not keep detection on." << std::flush;
+    return bResult;
+}
+
+// Items per millisecond through a queue, half the threads producers, half consumers.
+template<typename backoff>
+double queue_throughput(unsigned int threads)
+{
+    static const int items = 200000;
+
+    queue<int, basic_spin_lock<backoff>, backoff> q;
+    auto producers = (threads / 2) ? threads / 2 : 1;
+    auto consumers = (threads - producers) ? threads - producers : 1;
+    auto per_producer = items / static_cast<int>(producers);
+    std::atomic<int> consumed{ 0 };
+
+    auto start = chrono::steady_clock::now();
+    vector<future<void>> vf;
+    for (unsigned int p = 0; p < producers; ++p)
+    {
+        vf.emplace_back(async(std::launch::async, [&q, per_producer]() {
+            for (int i = 0; i < per_producer; ++i)
+            {
+                q.push(i);
+            }
+        }));
+    }
+    for (unsigned int c = 0; c < consumers; ++c)
+    {
+        vf.emplace_back(async(std::launch::async, [&q, &consumed, producers, per_producer]() {
+            int item;
+            while (consumed.load(std::memory_order_relaxed) < static_cast<int>(producers) * per_producer)
+            {
+                if (q.pop(item))
+                {
+                    consumed.fetch_add(1, std::memory_order_relaxed);
+                }
+                else
+                {
+                    backoff()();
+                }
+            }
+        }));
+    }
+    for (auto & task : vf)
+    {
+        task.wait();
+    }
+    auto ms = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count() / 1000.0;
+    return consumed.load() / (ms > 0 ? ms : 1);
+}
+
+// Critical sections per millisecond through a shared_mutex, one in eight exclusive.
+template<typename backoff>
+double shared_mutex_throughput(unsigned int threads)
+{
+    static const int sections = 200000;
+
+    basic_shared_mutex<backoff> m;
+    long long shared = 0;
+    auto per_thread = sections / static_cast<int>(threads);
+    std::atomic<long long> sum{ 0 };
+
+    auto start = chrono::steady_clock::now();
+    vector<future<void>> vf;
+    for (unsigned int t = 0; t < threads; ++t)
+    {
+        vf.emplace_back(async(std::launch::async, [&m, &shared, &sum, per_thread]() {
+            long long seen = 0;
+            for (int i = 0; i < per_thread; ++i)
+            {
+                if (i % 8 == 0)
+                {
+                    m.lock();
+                    ++shared;
+                    m.unlock();
+                }
+                else
+                {
+                    m.lock_shared();
+                    seen += shared;
+                    m.unlock_shared();
+                }
+            }
+            sum += seen;
+        }));
+    }
+    for (auto & task : vf)
+    {
+        task.wait();
+    }
+    auto ms = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count() / 1000.0;
+    return (per_thread * threads) / (ms > 0 ? ms : 1);
+}
+
+// Reports throughput with as many threads as cpus, and 2 and 4 times that, spinning and yielding early.
+// Not a pass or fail criterion, but both must finish.
+bool testcase_oversubscribed(unsigned int factor)
+{
+    auto threads = factor * oversubscription::usable_cpus();
+    threads = (threads < 2) ? 2 : threads;
+
+    auto queue_spin = queue_throughput<pause_backoff>(threads);
+    auto queue_yield = queue_throughput<oversubscription_backoff<>>(threads);
+    auto mutex_spin = shared_mutex_throughput<pause_backoff>(threads);
+    auto mutex_yield = shared_mutex_throughput<oversubscription_backoff<>>(threads);
+
+    cout << "\n success";
+    cout << " : oversubscribed test - " << factor << "x, " << threads << " threads, per ms: queue items "
+        << static_cast<long long>(queue_spin) << " spinning, " << static_cast<long long>(queue_yield) << " oversubscription_backoff"
+        << ", shared_mutex sections " << static_cast<long long>(mutex_spin) << " spinning, " << static_cast<long long>(mutex_yield)
+        << " oversubscription_backoff." << std::flush;
+    return true;
+}
+
+#define RUN_TEST(...) { if (!(__VA_ARGS__)) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_modes());
+    RUN_TEST(testcase_hold_expires());
+    RUN_TEST(testcase_oversubscribed(1));
+    RUN_TEST(testcase_oversubscribed(2));
+    RUN_TEST(testcase_oversubscribed(4));
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
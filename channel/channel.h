@@ -0,0 +1,376 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "../queue/queue.h"
+#include "../mutex/spin_lock.h"
+#include "../parking_lot/parking_lot.h"
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_release;
+using std::memory_order_seq_cst;
+
+// Go style channel implementation using C++11.
+// Note: Bounded, unbounded and rendezvous channels with close(). See select.h to wait on several.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread -march=native
+//      arch option is needed by lockfree::queue, see queue.h.
+
+/*
+Notes:
+    lockfree::channel<int> unbounded;
+    lockfree::channel<int> bounded(100);
+    lockfree::channel<int> rendezvous(lockfree::channel<int>::rendezvous);
+send() blocks while a bounded channel is full. On a rendezvous channel send() blocks until
+a receiver has taken the item. send() returns false if the channel is closed.
+recv() blocks while the channel is empty. It returns false once the channel is closed and empty.
+close() wakes all blocked receivers, and senders blocked on a full bounded channel.
+A sender blocked on a rendezvous channel is not released by close(); it returns once its item
+is received, so receivers should drain a closed channel.
+Idle senders and receivers spin for the calibrated budget, then park, so they use no cpu.
+
+Design:
+Items are kept in a lockfree::queue. A counter holds the items in the queue, plus the items
+reserved by senders that are about to push.
+send():
+    1. reserve: increment the counter. For a bounded channel only if below capacity, else wait.
+    2. if closed, undo the reservation and fail. Checking closed after reserving means a receiver
+        that sees closed and a zero counter can be sure no item is on its way.
+    3. push the item, and notify one receiver.
+recv():
+    pop an item, decrement the counter, and for a bounded channel notify one sender.
+Each channel has a list of waiting receivers and a list of waiting senders.
+The lists are short doubly linked lists under a spin_lock, but a notifier takes the lock
+only if the atomic count of waiters is not zero. So when nobody waits, notify is a fence and a load.
+A waiter is registered on the lists of one or more channels, eg. by select,
+and is signaled by whichever channel is ready first. notify wakes one waiter not yet signaled.
+A waiter registers, then tries again, before it parks. Registration and notify are separated
+by memory_order_seq_cst fences from the try and the push, so either the waiter sees the item
+or the notifier sees the waiter.
+*/
+
+namespace lockfree
+{
+
+class selector;
+
+class channel_base
+{
+public:
+    void close()
+    {
+        // memory_order_seq_cst due to the receiver's check of closed then counter, see Design.
+        m_closed.store(true, memory_order_seq_cst);
+        m_receivers.notify_all();
+        m_senders.notify_all();
+    }
+
+    bool closed() const
+    {
+        return m_closed.load(memory_order_acquire);
+    }
+
+protected:
+    friend class selector;
+
+    struct waiter
+    {
+        waiter() : signaled{ 0 }
+        {
+        }
+
+        std::atomic<unsigned int> signaled;
+    };
+
+    struct registration
+    {
+        explicit registration(waiter * pW) : pWaiter(pW), pPrevious(nullptr), pNext(nullptr)
+        {
+        }
+
+        waiter * pWaiter;
+        registration * pPrevious;
+        registration * pNext;
+    };
+
+    class waiter_list
+    {
+    public:
+        waiter_list() : m_pHead(nullptr), m_pTail(nullptr), m_count{ 0 }
+        {
+        }
+
+        void add(registration & r)
+        {
+            std::lock_guard<spin_lock> lk(m_lock);
+            r.pPrevious = m_pTail;
+            r.pNext = nullptr;
+            (m_pTail ? m_pTail->pNext : m_pHead) = &r;
+            m_pTail = &r;
+            // memory_order_seq_cst due to the notifier's check of the count, see Design.
+            m_count.fetch_add(1, memory_order_seq_cst);
+        }
+
+        void remove(registration & r)
+        {
+            std::lock_guard<spin_lock> lk(m_lock);
+            (r.pPrevious ? r.pPrevious->pNext : m_pHead) = r.pNext;
+            (r.pNext ? r.pNext->pPrevious : m_pTail) = r.pPrevious;
+            m_count.fetch_sub(1, memory_order_relaxed);
+        }
+
+        // Wakes the first waiter not already signaled.
+        void notify_one()
+        {
+            notify(false);
+        }
+
+        void notify_all()
+        {
+            notify(true);
+        }
+
+    private:
+        void notify(bool all)
+        {
+            // memory_order_seq_cst fence due to the notifier's push before this, see Design.
+            std::atomic_thread_fence(memory_order_seq_cst);
+            if (!m_count.load(memory_order_relaxed))
+            {
+                return;
+            }
+
+            // The waiter is woken under the lock, so it cannot unregister and go out of scope meanwhile.
+            std::lock_guard<spin_lock> lk(m_lock);
+            for (auto pR = m_pHead; pR; pR = pR->pNext)
+            {
+                // memory_order_release due to the waiter must see the state that caused the notify.
+                if (pR->pWaiter->signaled.exchange(1, memory_order_release) == 0)
+                {
+                    parking_lot::unpark_one(&pR->pWaiter->signaled);
+                    if (!all)
+                    {
+                        return;
+                    }
+                }
+            }
+        }
+
+        spin_lock m_lock;
+        registration * m_pHead;
+        registration * m_pTail;
+        std::atomic<unsigned int> m_count;
+    };
+
+    channel_base() : m_closed{ false }
+    {
+    }
+
+    //
+    // Calls attempt() until it returns true, waiting on the lists in between.
+    // attempt() must also return true when the operation is to give up, eg. on close.
+    // Returns true if the waiter was ever signaled.
+    //
+    template<typename Attempt>
+    static bool block_on(waiter_list * const * ppLists, registration * pRegs, unsigned int count, Attempt attempt)
+    {
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            ppLists[i]->add(pRegs[i]);
+        }
+
+        bool signaled = false;
+        auto & w = *pRegs[0].pWaiter;
+        for (;;)
+        {
+            // memory_order_seq_cst fence due to the waiter's registration or reset before this, see Design.
+            std::atomic_thread_fence(memory_order_seq_cst);
+            if (attempt())
+            {
+                break;
+            }
+
+            parking_lot::spin_then_park(&w.signaled, [&w]() { return w.signaled.load(memory_order_acquire) != 0; });
+            signaled = true;
+            w.signaled.store(0, memory_order_relaxed);
+        }
+
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            ppLists[i]->remove(pRegs[i]);
+        }
+        return signaled;
+    }
+
+    template<typename Attempt>
+    static void block_on(waiter_list & list, Attempt attempt)
+    {
+        if (attempt())
+        {
+            return;
+        }
+        waiter w;
+        registration r(&w);
+        waiter_list * pList = &list;
+        block_on(&pList, &r, 1, attempt);
+    }
+
+    waiter_list m_receivers;
+    waiter_list m_senders;
+    std::atomic<bool> m_closed;
+};
+
+template<typename T>
+class channel : public channel_base
+{
+public:
+    static const std::size_t unbounded = ~std::size_t(0);
+    static const std::size_t rendezvous = 0;
+
+    explicit channel(std::size_t capacity = unbounded) : m_capacity(capacity), m_count{ 0 }
+    {
+    }
+
+    channel(const channel &) = delete;
+    channel & operator=(const channel &) = delete;
+
+    bool send(const T & item)
+    {
+        if (!reserve())
+        {
+            return false;
+        }
+
+        std::atomic<bool> received{ false };
+        entry e;
+        e.item = item;
+        e.pReceived = (m_capacity == rendezvous) ? &received : nullptr;
+        m_items.push(e);
+        m_receivers.notify_one();
+
+        if (e.pReceived)
+        {
+            // memory_order_acquire due to the receiver having taken the item must 'happen before' send returns.
+            parking_lot::spin_then_park(&received, [&received]() { return received.load(memory_order_acquire); });
+        }
+        return true;
+    }
+
+    bool try_recv(T & item)
+    {
+        entry e;
+        if (!m_items.pop(e))
+        {
+            return false;
+        }
+        item = e.item;
+
+        m_count.fetch_sub(1, memory_order_relaxed);
+        if (m_capacity != unbounded && m_capacity != rendezvous)
+        {
+            m_senders.notify_one();
+        }
+
+        if (e.pReceived)
+        {
+            // memory_order_release due to the item copy above must be complete before the sender returns.
+            e.pReceived->store(true, memory_order_release);
+            // The sender may have returned already. An unpark of a stale address is only a spurious wake-up.
+            parking_lot::unpark_one(e.pReceived);
+        }
+        return true;
+    }
+
+    bool recv(T & item)
+    {
+        bool received = false;
+        block_on(m_receivers, [this, &item, &received]() {
+            return (received = try_recv(item)) || drained();
+        });
+        return received;
+    }
+
+    // Items in the channel, including the ones being sent.
+    std::size_t size() const
+    {
+        return m_count.load(memory_order_relaxed);
+    }
+
+    std::size_t capacity() const
+    {
+        return m_capacity;
+    }
+
+    // Closed, and no item in the channel or on its way.
+    bool drained() const
+    {
+        // memory_order_seq_cst due to the sender's reservation then check of closed, see Design.
+        return m_closed.load(memory_order_seq_cst) && (m_count.load(memory_order_seq_cst) == 0);
+    }
+
+private:
+    struct entry
+    {
+        T item;
+        std::atomic<bool> * pReceived;
+    };
+
+    bool reserve()
+    {
+        if (m_capacity == unbounded || m_capacity == rendezvous)
+        {
+            // memory_order_seq_cst due to the check of closed following this, see Design.
+            m_count.fetch_add(1, memory_order_seq_cst);
+        }
+        else
+        {
+            bool reserved = false;
+            block_on(m_senders, [this, &reserved]() {
+                return (reserved = try_reserve_bounded()) || closed();
+            });
+            if (!reserved)
+            {
+                return false;
+            }
+        }
+
+        if (m_closed.load(memory_order_seq_cst))
+        {
+            m_count.fetch_sub(1, memory_order_seq_cst);
+            // A receiver may be waiting for the item reserved.
+            m_receivers.notify_all();
+            return false;
+        }
+        return true;
+    }
+
+    bool try_reserve_bounded()
+    {
+        auto count = m_count.load(memory_order_relaxed);
+        while (count < m_capacity)
+        {
+            // memory_order_seq_cst due to the check of closed following this, see Design.
+            if (m_count.compare_exchange_weak(count, count + 1, memory_order_seq_cst, memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const std::size_t m_capacity;
+    queue<entry> m_items;
+    std::atomic<std::size_t> m_count;
+};
+
+}
@@ -0,0 +1,164 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "channel.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Go style select over several channels, using C++11.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread -march=native
+//      arch option is needed by lockfree::queue, see queue.h.
+
+/*
+Notes:
+    lockfree::selector sel;
+    sel.on(data, [](const std::string & s) { ... });
+    sel.on(control, [](int code) { ... });
+    while (sel.wait() != lockfree::selector::all_closed) {}
+wait() receives one item from one ready channel, calls the handler of that channel with it,
+and returns the index of that channel in the order on() was called.
+It returns all_closed once every channel is closed and empty.
+try_wait() does not block, and returns not_ready if no channel is ready.
+Only receive is supported. The channels can have different item types.
+
+Design:
+wait():
+    1. try each channel in turn, starting after the one that was ready last time,
+        so a busy channel cannot starve the others.
+    2. if none is ready, register one waiter on the receiver lists of all the channels,
+        and try again, then park until any channel signals the waiter. See channel.h.
+    3. unregister from all.
+A notify that signaled this waiter may have been for a channel that wait() then did not take from.
+So after a wait() that was signaled, every other channel that has items notifies one more receiver,
+so that no item is left without a woken receiver.
+*/
+
+namespace lockfree
+{
+
+class selector
+{
+public:
+    static const int all_closed = -1;
+    static const int not_ready = -2;
+
+    selector() : m_next(0)
+    {
+    }
+
+    selector(const selector &) = delete;
+    selector & operator=(const selector &) = delete;
+
+    // Handler is called as handler(item), with the item received from the channel.
+    template<typename T, typename Handler>
+    selector & on(channel<T> & ch, Handler handler)
+    {
+        select_case c;
+        c.pReceivers = &ch.m_receivers;
+        c.try_take = [&ch, handler]() mutable {
+            T item;
+            if (!ch.try_recv(item))
+            {
+                return false;
+            }
+            handler(item);
+            return true;
+        };
+        c.drained = [&ch]() { return ch.drained(); };
+        c.has_items = [&ch]() { return ch.size() != 0; };
+        m_cases.push_back(std::move(c));
+        return *this;
+    }
+
+    int try_wait()
+    {
+        int ready = not_ready;
+        attempt(ready);
+        return ready;
+    }
+
+    int wait()
+    {
+        int ready = not_ready;
+        if (attempt(ready))
+        {
+            return ready;
+        }
+
+        auto count = static_cast<unsigned int>(m_cases.size());
+        channel_base::waiter w;
+        std::vector<channel_base::registration> regs(count, channel_base::registration(&w));
+        std::vector<channel_base::waiter_list *> lists(count);
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            lists[i] = m_cases[i].pReceivers;
+        }
+
+        auto signaled = channel_base::block_on(lists.data(), regs.data(), count, [this, &ready]() { return attempt(ready); });
+
+        if (signaled)
+        {
+            for (unsigned int i = 0; i < count; ++i)
+            {
+                if (static_cast<int>(i) != ready && m_cases[i].has_items())
+                {
+                    m_cases[i].pReceivers->notify_one();
+                }
+            }
+        }
+        return ready;
+    }
+
+    unsigned int size() const
+    {
+        return static_cast<unsigned int>(m_cases.size());
+    }
+
+private:
+    struct select_case
+    {
+        channel_base::waiter_list * pReceivers;
+        std::function<bool()> try_take;
+        std::function<bool()> drained;
+        std::function<bool()> has_items;
+    };
+
+    // Returns true when done, with ready set to the channel taken from, or all_closed.
+    bool attempt(int & ready)
+    {
+        auto count = static_cast<unsigned int>(m_cases.size());
+        bool all_drained = true;
+        for (unsigned int k = 0; k < count; ++k)
+        {
+            auto i = (m_next + k) % count;
+            if (m_cases[i].try_take())
+            {
+                m_next = i + 1;
+                ready = static_cast<int>(i);
+                return true;
+            }
+            all_drained = all_drained && m_cases[i].drained();
+        }
+        if (all_drained)
+        {
+            ready = all_closed;
+            return true;
+        }
+        ready = not_ready;
+        return false;
+    }
+
+    std::vector<select_case> m_cases;
+    unsigned int m_next;
+};
+
+}
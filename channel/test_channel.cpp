@@ -0,0 +1,164 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread -march=native test_channel.cpp -latomic
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "channel.h"
+
+#include <iostream>
+#include <future>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+
+using std::cout;
+using std::vector;
+using std::logic_error;
+using std::flush;
+using std::future;
+using std::atomic;
+namespace chrono = std::chrono;
+
+using lockfree::channel;
+
+bool testcase_sanity()
+{
+    bool bResult = false;
+    try
+    {
+        channel<int> ch;
+        int item = 0;
+        if (ch.try_recv(item)) throw logic_error("received from empty channel.");
+        ch.send(1);
+        ch.send(2);
+        if (ch.size() != 2) throw logic_error("size wrong.");
+        if (!ch.recv(item) || item != 1) throw logic_error("recv wrong item.");
+
+        ch.close();
+        if (ch.send(3)) throw logic_error("send succeeded on closed channel.");
+        if (!ch.recv(item) || item != 2) throw logic_error("closed channel not drained.");
+        if (ch.recv(item)) throw logic_error("recv succeeded on closed empty channel.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - single threaded send, recv, close." << std::flush;
+    return bResult;
+}
+
+// Producers then close. Consumers run until the channel is drained.
+bool run_channel(const char * name, std::size_t capacity)
+{
+    static const int producers = 3;
+    static const int consumers = 3;
+    static const int items = 2000;
+
+    channel<int> ch(capacity);
+    atomic<long long> sum{ 0 };
+    atomic<bool> failed{ false };
+
+    vector<future<void>> vc;
+    for (int t = 0; t < consumers; ++t)
+    {
+        vc.emplace_back(async(std::launch::async, [&]() {
+            int item = 0;
+            while (ch.recv(item))
+            {
+                sum += item;
+                if (capacity != channel<int>::rendezvous && ch.size() > capacity) failed = true;
+            }
+        }));
+    }
+    {
+        vector<future<void>> vp;
+        for (int t = 0; t < producers; ++t)
+        {
+            vp.emplace_back(async(std::launch::async, [&]() {
+                for (int i = 1; i <= items; ++i)
+                {
+                    if (!ch.send(i)) failed = true;
+                    if (i % 256 == 0) std::this_thread::sleep_for(chrono::microseconds(200));
+                }
+            }));
+        }
+    }
+    ch.close();
+    for (auto & task : vc)
+    {
+        task.wait();
+    }
+
+    long long expected = producers * (static_cast<long long>(items) * (items + 1) / 2);
+    failed = failed || (sum.load() != expected);
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : parallelism test - " << name << " channel." << std::flush;
+    return !failed;
+}
+
+// A rendezvous send returns only after a receiver took the item.
+bool testcase_rendezvous_blocks()
+{
+    channel<int> ch(channel<int>::rendezvous);
+    atomic<bool> sent{ false };
+
+    auto sender = async(std::launch::async, [&]() {
+        ch.send(7);
+        sent = true;
+    });
+
+    std::this_thread::sleep_for(chrono::milliseconds(20));
+    bool failed = sent.load();
+    int item = 0;
+    failed = failed || !ch.recv(item) || item != 7;
+    sender.wait();
+    failed = failed || !sent.load();
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : rendezvous test - send waits for the receiver." << std::flush;
+    return !failed;
+}
+
+// close() wakes receivers parked on an empty channel, and senders parked on a full one.
+bool testcase_close_wakes()
+{
+    channel<int> empty;
+    channel<int> full(1);
+    full.send(0);
+
+    auto receiver = async(std::launch::async, [&]() { int item; return empty.recv(item); });
+    auto sender = async(std::launch::async, [&]() { return full.send(1); });
+
+    std::this_thread::sleep_for(chrono::milliseconds(20));
+    empty.close();
+    full.close();
+
+    bool failed = receiver.get() || sender.get();
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : close test - close wakes blocked receivers and senders." << std::flush;
+    return !failed;
+}
+
+#define RUN_TEST(...) { if (!(__VA_ARGS__)) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity());
+    RUN_TEST(run_channel("unbounded", channel<int>::unbounded));
+    RUN_TEST(run_channel("bounded", 16));
+    RUN_TEST(run_channel("rendezvous", channel<int>::rendezvous));
+    RUN_TEST(testcase_rendezvous_blocks());
+    RUN_TEST(testcase_close_wakes());
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
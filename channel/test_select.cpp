@@ -0,0 +1,155 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread -march=native test_select.cpp -latomic
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "select.h"
+
+#include <iostream>
+#include <future>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <stdexcept>
+
+using std::cout;
+using std::vector;
+using std::string;
+using std::logic_error;
+using std::flush;
+using std::future;
+using std::atomic;
+namespace chrono = std::chrono;
+
+using lockfree::channel;
+using lockfree::selector;
+
+bool testcase_sanity()
+{
+    bool bResult = false;
+    try
+    {
+        channel<int> data;
+        channel<string> control;
+        int got_data = 0;
+        string got_control;
+
+        selector sel;
+        sel.on(data, [&got_data](int item) { got_data = item; })
+           .on(control, [&got_control](const string & s) { got_control = s; });
+
+        if (sel.try_wait() != selector::not_ready) throw logic_error("ready with all channels empty.");
+        control.send("stop");
+        if (sel.wait() != 1 || got_control != "stop") throw logic_error("control not selected.");
+        data.send(5);
+        if (sel.wait() != 0 || got_data != 5) throw logic_error("data not selected.");
+
+        data.close();
+        control.close();
+        if (sel.wait() != selector::all_closed) throw logic_error("all closed not reported.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - single threaded select." << std::flush;
+    return bResult;
+}
+
+// A busy channel must not starve another ready channel.
+bool testcase_fairness()
+{
+    channel<int> busy;
+    channel<int> quiet;
+    for (int i = 0; i < 100; ++i)
+    {
+        busy.send(i);
+    }
+    quiet.send(1);
+
+    selector sel;
+    sel.on(busy, [](int) {}).on(quiet, [](int) {});
+
+    bool quiet_taken = false;
+    for (int i = 0; i < 3 && !quiet_taken; ++i)
+    {
+        quiet_taken = (sel.wait() == 1);
+    }
+
+    bool failed = !quiet_taken;
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : fairness test - ready channels are taken in turn." << std::flush;
+    return !failed;
+}
+
+// Several selecting consumers park on three channels fed by producers that pause now and then.
+bool testcase_parallelism()
+{
+    static const int consumers = 4;
+    static const int items = 1000;
+
+    channel<int> a;
+    channel<int> b(8);
+    channel<long long> c(channel<long long>::rendezvous);
+    atomic<long long> sum{ 0 };
+
+    vector<future<void>> vc;
+    for (int t = 0; t < consumers; ++t)
+    {
+        vc.emplace_back(async(std::launch::async, [&]() {
+            selector sel;
+            sel.on(a, [&sum](int item) { sum += item; })
+               .on(b, [&sum](int item) { sum += item; })
+               .on(c, [&sum](long long item) { sum += item; });
+            while (sel.wait() != selector::all_closed)
+            {
+            }
+        }));
+    }
+    {
+        vector<future<void>> vp;
+        vp.emplace_back(async(std::launch::async, [&]() {
+            for (int i = 1; i <= items; ++i) { a.send(i); if (i % 100 == 0) std::this_thread::sleep_for(chrono::microseconds(500)); }
+            a.close();
+        }));
+        vp.emplace_back(async(std::launch::async, [&]() {
+            for (int i = 1; i <= items; ++i) { b.send(i); }
+            b.close();
+        }));
+        vp.emplace_back(async(std::launch::async, [&]() {
+            for (int i = 1; i <= items; ++i) { c.send(i); if (i % 100 == 0) std::this_thread::sleep_for(chrono::microseconds(500)); }
+            c.close();
+        }));
+    }
+    for (auto & task : vc)
+    {
+        task.wait();
+    }
+
+    long long expected = 3 * (static_cast<long long>(items) * (items + 1) / 2);
+    bool failed = (sum.load() != expected);
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : parallelism test - select over unbounded, bounded and rendezvous channels." << std::flush;
+    return !failed;
+}
+
+#define RUN_TEST(testcase) { if (!testcase()) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity);
+    RUN_TEST(testcase_fairness);
+    RUN_TEST(testcase_parallelism);
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
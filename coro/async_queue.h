@@ -0,0 +1,176 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "executor.h"
+#include "../queue/queue.h"
+#include "../backoff/backoff.h"
+
+#include <atomic>
+#include <coroutine>
+
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_acq_rel;
+
+// Lock free queue with a coroutine awaitable pop, using C++20.
+// Note: co_await q.pop() suspends the coroutine, not the thread, while the queue is empty.
+
+// To build using gcc need the following options
+//      -std=c++20 -pthread -march=native
+//      arch option is needed by lockfree::queue, see queue.h.
+
+/*
+Notes:
+    lockfree::async_queue<int> q;
+    ...
+    int item = co_await q.pop();
+A suspended pop is resumed through the executor, see executor.h.
+The default inline_executor resumes it on the thread that pushed.
+try_pop() never suspends.
+
+Design:
+A lockfree::queue of items, a lockfree::queue of suspended pops, and a counter:
+items in the queue minus suspended pops.
+co_await pop():
+    if the counter is positive, claim an item by decrementing it. Then pop the item.
+    Else decrement the counter all the same, and add this pop to the waiters.
+push(item):
+    push the item, then increment the counter.
+    If the counter was negative, take a waiter and post it to the executor. It then pops the item.
+Every decrement is matched by an item pushed before the increment that pays for it,
+so a claimed item is always there to pop. A waiter may be between decrementing the counter
+and adding itself to the waiters when the pusher looks for it; the pusher spins until it is there.
+Both lists are lock free, so neither push nor pop ever takes a lock or enters the kernel.
+*/
+
+namespace lockfree
+{
+
+template<typename T, typename executor_type = inline_executor>
+class async_queue
+{
+public:
+    class pop_awaiter
+    {
+    public:
+        explicit pop_awaiter(async_queue & q) : m_q(q)
+        {
+        }
+
+        bool await_ready()
+        {
+            return m_q.try_claim();
+        }
+
+        // Returns false to not suspend, if an item was claimed after all.
+        bool await_suspend(std::coroutine_handle<> h)
+        {
+            m_handle = h;
+
+            // memory_order_acq_rel due to
+            //      acquire: a claimed item must be visible to the pop in await_resume().
+            //      release: pairs with the pusher's acquire, for the waiter it takes.
+            if (m_q.m_count.fetch_sub(1, memory_order_acq_rel) > 0)
+            {
+                return false;
+            }
+
+            // The pusher may resume this coroutine before this returns. So do not touch this after the push.
+            m_q.m_waiters.push(this);
+            return true;
+        }
+
+        T await_resume()
+        {
+            T item;
+            m_q.pop_claimed(item);
+            return item;
+        }
+
+    private:
+        friend class async_queue;
+
+        async_queue & m_q;
+        std::coroutine_handle<> m_handle;
+    };
+
+    explicit async_queue(executor_type executor = executor_type(), unsigned int initial_capacity = 64) :
+        m_items(initial_capacity), m_count{ 0 }, m_executor(executor)
+    {
+    }
+
+    async_queue(const async_queue &) = delete;
+    async_queue & operator=(const async_queue &) = delete;
+
+    void push(const T & item)
+    {
+        m_items.push(item);
+
+        // memory_order_acq_rel due to
+        //      release: the item pushed above must be visible to whoever claims it.
+        //      acquire: pairs with the waiter's decrement, for the waiter taken below.
+        if (m_count.fetch_add(1, memory_order_acq_rel) < 0)
+        {
+            pop_awaiter * pWaiter = nullptr;
+            pause_backoff wait_waiter;
+            while (!m_waiters.pop(pWaiter))
+            {
+                wait_waiter();
+            }
+            m_executor.post(pWaiter->m_handle);
+        }
+    }
+
+    pop_awaiter pop()
+    {
+        return pop_awaiter(*this);
+    }
+
+    bool try_pop(T & item)
+    {
+        if (!try_claim())
+        {
+            return false;
+        }
+        pop_claimed(item);
+        return true;
+    }
+
+private:
+    bool try_claim()
+    {
+        // memory_order_relaxed due to no following dereferencing, the compare and swap orders.
+        auto count = m_count.load(memory_order_relaxed);
+        while (count > 0)
+        {
+            // memory_order_acquire on success due to the claimed item must be visible to the following pop.
+            if (m_count.compare_exchange_weak(count, count - 1, memory_order_acquire, memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void pop_claimed(T & item)
+    {
+        // The claimed item is pushed, but a concurrent refill of the queue may hide it for a moment.
+        pause_backoff wait_item;
+        while (!m_items.pop(item))
+        {
+            wait_item();
+        }
+    }
+
+    queue<T> m_items;
+    queue<pop_awaiter *> m_waiters;
+    std::atomic<long long> m_count;
+    executor_type m_executor;
+};
+
+}
@@ -0,0 +1,268 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "executor.h"
+#include "../queue/queue.h"
+#include "../backoff/backoff.h"
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_release;
+using std::memory_order_acq_rel;
+
+// Shared mutex with coroutine awaitable lock and lock_shared, using C++20.
+// Note: co_await m.lock() suspends the coroutine, not the thread, while the mutex is held.
+
+// To build using gcc need the following options
+//      -std=c++20 -pthread -march=native
+//      arch option is needed by lockfree::queue, see queue.h.
+
+/*
+Notes:
+    lockfree::async_shared_mutex<> m;
+    ...
+    co_await m.lock_shared();
+    ... read ...
+    m.unlock_shared();
+A suspended lock is resumed through the executor, see executor.h.
+The default inline_executor resumes it on the thread that unlocks.
+try_lock() and try_lock_shared() never suspend.
+Waiters are granted the mutex in FIFO order. Consecutive shared waiters are granted together.
+
+Design:
+One 64 bit state word.
+    bits  0..31 : count of shared holders.
+    bit  32     : held exclusive.
+    bits 33..63 : count of waiters.
+lock() / lock_shared():
+    compare and swap to take the mutex, if it is free for the mode and there are no waiters.
+    Else compare and swap to add one waiter, and add self to the lock free list of waiters.
+    Once there are waiters, new arrivals always wait, so the waiters are served in order.
+unlock() / the last unlock_shared():
+    if there are no waiters, release. Else keep the exclusive bit set and hand off:
+    the exclusive bit now stands for the right to grant the mutex to waiters.
+handoff:
+    1. take the next waiter. A waiter may be between adding itself to the count and to the list;
+        the hand off spins until it is in the list.
+    2. if it waits exclusive, it now owns the exclusive bit; resume it.
+    3. if it waits shared, swap the exclusive bit for two shared holders: the waiter and the hand off itself.
+        Keep granting shared waiters from the list. On the first exclusive waiter, park it as the
+        pending writer, which the next hand off serves first.
+        Then the hand off drops its own shared hold, which hands off again if it is the last.
+The hand off holding a shared hold itself means no reader it resumed can start another hand off
+while it is still granting. So there is at most one hand off at a time,
+and the pending writer needs no atomic.
+*/
+
+namespace lockfree
+{
+
+template<typename executor_type = inline_executor>
+class async_shared_mutex
+{
+public:
+    class lock_awaiter
+    {
+    public:
+        lock_awaiter(async_shared_mutex & m, bool exclusive) : m_m(m), m_exclusive(exclusive)
+        {
+        }
+
+        bool await_ready()
+        {
+            return m_exclusive ? m_m.try_lock() : m_m.try_lock_shared();
+        }
+
+        // Returns false to not suspend, if the mutex was taken after all.
+        bool await_suspend(std::coroutine_handle<> h)
+        {
+            m_handle = h;
+            if (!m_m.lock_or_wait(m_exclusive))
+            {
+                return false;
+            }
+
+            // The hand off may resume this coroutine before this returns. So do not touch this after the push.
+            m_m.m_waiters.push(this);
+            return true;
+        }
+
+        void await_resume()
+        {
+        }
+
+    private:
+        friend class async_shared_mutex;
+
+        async_shared_mutex & m_m;
+        bool m_exclusive;
+        std::coroutine_handle<> m_handle;
+    };
+
+    explicit async_shared_mutex(executor_type executor = executor_type()) :
+        m_state{ 0 }, m_pPendingWriter(nullptr), m_executor(executor)
+    {
+    }
+
+    async_shared_mutex(const async_shared_mutex &) = delete;
+    async_shared_mutex & operator=(const async_shared_mutex &) = delete;
+
+    lock_awaiter lock()
+    {
+        return lock_awaiter(*this, true);
+    }
+
+    lock_awaiter lock_shared()
+    {
+        return lock_awaiter(*this, false);
+    }
+
+    bool try_lock()
+    {
+        std::uint64_t expected = 0;
+        // memory_order_acquire on success due to all PD reads issued after this must 'happen after' this.
+        // PD is data structure protected by using this mutex.
+        return m_state.compare_exchange_strong(expected, exclusive_bit, memory_order_acquire, memory_order_relaxed);
+    }
+
+    bool try_lock_shared()
+    {
+        auto state = m_state.load(memory_order_relaxed);
+        while (!(state & (exclusive_bit | waiter_mask)))
+        {
+            // memory_order_acquire on success due to all PD reads issued after this must 'happen after' this.
+            if (m_state.compare_exchange_weak(state, state + one_reader, memory_order_acquire, memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void unlock()
+    {
+        auto state = m_state.load(memory_order_relaxed);
+        while (!(state & waiter_mask))
+        {
+            // memory_order_release on success due to all PD writes issued before this must 'happen before' this.
+            if (m_state.compare_exchange_weak(state, state & ~exclusive_bit, memory_order_release, memory_order_relaxed))
+            {
+                return;
+            }
+        }
+
+        // Waiters can only be added, so keeping the exclusive bit needs no write.
+        handoff();
+    }
+
+    void unlock_shared()
+    {
+        auto state = m_state.load(memory_order_relaxed);
+        for (;;)
+        {
+            auto last = ((state & reader_mask) == one_reader) && (state & waiter_mask);
+            auto newstate = last ? (state - one_reader + exclusive_bit) : (state - one_reader);
+
+            // memory_order_acq_rel on success due to
+            //      release: all PD writes issued before this must 'happen before' this.
+            //      acquire: the hand off that may follow must see the PD writes of the other readers.
+            if (m_state.compare_exchange_weak(state, newstate, memory_order_acq_rel, memory_order_relaxed))
+            {
+                if (last)
+                {
+                    handoff();
+                }
+                return;
+            }
+        }
+    }
+
+private:
+    static const std::uint64_t one_reader = 1;
+    static const std::uint64_t reader_mask = (std::uint64_t(1) << 32) - 1;
+    static const std::uint64_t exclusive_bit = std::uint64_t(1) << 32;
+    static const std::uint64_t one_waiter = std::uint64_t(1) << 33;
+    static const std::uint64_t waiter_mask = ~(reader_mask | exclusive_bit);
+
+    // Returns false if the mutex was taken, true if added to the waiter count.
+    bool lock_or_wait(bool exclusive)
+    {
+        auto state = m_state.load(memory_order_relaxed);
+        for (;;)
+        {
+            bool available = exclusive ? (state == 0) : !(state & (exclusive_bit | waiter_mask));
+            auto newstate = available ? (exclusive ? exclusive_bit : state + one_reader) : (state + one_waiter);
+
+            // memory_order_acquire on success due to all PD reads issued after this must 'happen after' this.
+            if (m_state.compare_exchange_weak(state, newstate, memory_order_acquire, memory_order_relaxed))
+            {
+                return !available;
+            }
+        }
+    }
+
+    lock_awaiter * next_waiter()
+    {
+        lock_awaiter * pWaiter = nullptr;
+        pause_backoff wait_waiter;
+        while (!m_waiters.pop(pWaiter))
+        {
+            wait_waiter();
+        }
+        return pWaiter;
+    }
+
+    // Call owning the exclusive bit, with at least one waiter.
+    void handoff()
+    {
+        auto pWaiter = m_pPendingWriter;
+        m_pPendingWriter = nullptr;
+        if (!pWaiter)
+        {
+            pWaiter = next_waiter();
+        }
+
+        if (pWaiter->m_exclusive)
+        {
+            // memory_order_acq_rel due to the state must be current before the waiter runs.
+            m_state.fetch_sub(one_waiter, memory_order_acq_rel);
+            m_executor.post(pWaiter->m_handle);
+            return;
+        }
+
+        // Swap the exclusive bit for two readers, the waiter and this hand off. Unsigned wrap around is intended.
+        m_state.fetch_add(2 * one_reader - exclusive_bit - one_waiter, memory_order_acq_rel);
+        m_executor.post(pWaiter->m_handle);
+
+        while (m_state.load(memory_order_acquire) & waiter_mask)
+        {
+            pWaiter = next_waiter();
+            if (pWaiter->m_exclusive)
+            {
+                // Only a hand off accesses the pending writer, and there is one hand off at a time.
+                m_pPendingWriter = pWaiter;
+                break;
+            }
+            m_state.fetch_add(one_reader - one_waiter, memory_order_acq_rel);
+            m_executor.post(pWaiter->m_handle);
+        }
+
+        unlock_shared();
+    }
+
+    std::atomic<std::uint64_t> m_state;
+    queue<lock_awaiter *> m_waiters;
+    lock_awaiter * m_pPendingWriter;
+    executor_type m_executor;
+};
+
+}
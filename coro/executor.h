@@ -0,0 +1,212 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "../queue/queue.h"
+#include "../sync/eventcount.h"
+#include "../topology/topology.h"
+
+#include <atomic>
+#include <coroutine>
+#include <deque>
+#include <thread>
+#include <vector>
+
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_release;
+
+// Executors that resume coroutines suspended on the awaitables of this folder.
+
+// To build using gcc need the following options
+//      -std=c++20 -pthread -march=native
+//      arch option is needed by lockfree::queue, see queue.h.
+
+/*
+Notes:
+An executor is any copyable type with
+    void post(std::coroutine_handle<> h);
+that arranges for h.resume() to be called once.
+The awaitables of this folder take the executor as a template parameter, and keep a copy of it.
+
+inline_executor resumes on the thread that wakes the coroutine, eg. the thread that pushes to
+an async_queue, or unlocks an async_shared_mutex. That is the lowest latency, but the waker
+runs the coroutine up to its next suspension before it returns.
+A coroutine resumed inline often wakes the next one, eg. a writer that unlocks hands off to the
+next writer. Resuming that one inline too would nest a stack frame per waiter, and overflow the stack
+with thousands of waiters. So a post() made while the thread is already resuming through
+inline_executor is queued on a per-thread pending list, which the outermost post() runs in order
+once the coroutine it resumed suspends. Stack depth stays constant, however long the chain.
+
+thread_pool runs coroutines on a fixed set of threads. thread_pool::get_executor() returns
+a cheap handle to the pool. So thousands of coroutines can share a handful of threads.
+thread_pool can pin its threads, one per cpu of a given list, eg. the cpus of a node from topology.h,
+or the cpus of a placement plan, so that its threads match hardware cores.
+
+Design:
+thread_pool keeps posted handles in a lockfree::queue. Idle threads sleep on an eventcount,
+so post() pays a fence and one relaxed load when no thread is idle.
+*/
+
+namespace lockfree
+{
+
+class inline_executor
+{
+public:
+    void post(std::coroutine_handle<> h) const
+    {
+        auto & t = this_thread_trampoline();
+        if (t.running)
+        {
+            t.pending.push_back(h);
+            return;
+        }
+
+        running_guard guard(t);
+        h.resume();
+        while (!t.pending.empty())
+        {
+            auto next = t.pending.front();
+            t.pending.pop_front();
+            next.resume();
+        }
+    }
+
+private:
+    struct trampoline
+    {
+        bool running = false;
+        std::deque<std::coroutine_handle<>> pending;
+    };
+
+    // Clears running also if a resumed coroutine throws. The pending ones run on the next post().
+    struct running_guard
+    {
+        explicit running_guard(trampoline & t) : m_t(t)
+        {
+            m_t.running = true;
+        }
+
+        ~running_guard()
+        {
+            m_t.running = false;
+        }
+
+        trampoline & m_t;
+    };
+
+    static trampoline & this_thread_trampoline()
+    {
+        static thread_local trampoline t;
+        return t;
+    }
+};
+
+class thread_pool
+{
+public:
+    class executor
+    {
+    public:
+        explicit executor(thread_pool & pool) : m_pPool(&pool)
+        {
+        }
+
+        void post(std::coroutine_handle<> h) const
+        {
+            m_pPool->post(h);
+        }
+
+    private:
+        thread_pool * m_pPool;
+    };
+
+    explicit thread_pool(unsigned int thread_count = std::thread::hardware_concurrency()) : m_stop{ false }
+    {
+        thread_count = thread_count ? thread_count : 1;
+        for (unsigned int i = 0; i < thread_count; ++i)
+        {
+            m_threads.emplace_back([this]() { run(); });
+        }
+    }
+
+    // A thread per cpu, pinned to it. A thread that cannot be pinned runs unpinned.
+    explicit thread_pool(const std::vector<unsigned int> & cpus) : m_stop{ false }
+    {
+        for (auto cpu : cpus)
+        {
+            m_threads.emplace_back([this, cpu]() {
+                cpu_topology::pin_this_thread(cpu);
+                run();
+            });
+        }
+        if (m_threads.empty())
+        {
+            m_threads.emplace_back([this]() { run(); });
+        }
+    }
+
+    thread_pool(const thread_pool &) = delete;
+    thread_pool & operator=(const thread_pool &) = delete;
+
+    // Runs what has already been posted, then joins the threads.
+    ~thread_pool()
+    {
+        // memory_order_release due to posts issued before this must be run before the threads exit.
+        m_stop.store(true, memory_order_release);
+        m_ready.notify_all();
+        for (auto & t : m_threads)
+        {
+            t.join();
+        }
+    }
+
+    executor get_executor()
+    {
+        return executor(*this);
+    }
+
+    void post(std::coroutine_handle<> h)
+    {
+        m_handles.push(h);
+        m_ready.notify();
+    }
+
+    unsigned int thread_count() const
+    {
+        return static_cast<unsigned int>(m_threads.size());
+    }
+
+private:
+    void run()
+    {
+        for (;;)
+        {
+            std::coroutine_handle<> h;
+            m_ready.await([this, &h]() {
+                // memory_order_acquire due to a stop must see all posts issued before it.
+                return m_handles.pop(h) || m_stop.load(memory_order_acquire);
+            });
+
+            // On stop, a post may have landed after the pop above failed. Run what is left.
+            if (h || m_handles.pop(h))
+            {
+                h.resume();
+                continue;
+            }
+            return;
+        }
+    }
+
+    queue<std::coroutine_handle<>> m_handles;
+    eventcount m_ready;
+    std::atomic<bool> m_stop;
+    std::vector<std::thread> m_threads;
+};
+
+}
@@ -0,0 +1,200 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++20 -pthread -march=native test_async_queue.cpp -latomic
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "async_queue.h"
+#include "../sync/latch.h"
+
+#include <iostream>
+#include <future>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+#include <exception>
+#include <cstdint>
+
+using std::cout;
+using std::vector;
+using std::logic_error;
+using std::flush;
+using std::future;
+using std::atomic;
+
+using lockfree::async_queue;
+using lockfree::thread_pool;
+using lockfree::latch;
+
+// Coroutine return type that starts at once and frees itself when done.
+struct detached
+{
+    struct promise_type
+    {
+        detached get_return_object() { return detached(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+template<typename queue_type>
+detached consume(queue_type & q, int count, atomic<long long> & sum, latch & done)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        sum += co_await q.pop();
+    }
+    done.count_down();
+}
+
+bool testcase_sanity()
+{
+    bool bResult = false;
+    try
+    {
+        async_queue<int> q;
+        atomic<long long> sum{ 0 };
+        latch done(1);
+
+        int item = 0;
+        if (q.try_pop(item)) throw logic_error("popped from empty queue.");
+
+        // suspends on the empty queue. The pushes below resume it on this thread.
+        consume(q, 2, sum, done);
+        if (done.try_wait()) throw logic_error("pop did not suspend on empty queue.");
+        q.push(3);
+        if (sum.load() != 3) throw logic_error("push did not resume the waiter inline.");
+        q.push(4);
+        if (!done.try_wait() || sum.load() != 7) throw logic_error("waiter not done.");
+
+        q.push(5);
+        if (!q.try_pop(item) || item != 5) throw logic_error("try_pop failed.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - single threaded pop suspends and resumes." << std::flush;
+    return bResult;
+}
+
+// Thousands of consumer coroutines share a small thread pool, or one thread pinned per cpu.
+bool testcase_parallelism(bool pinned)
+{
+    static const int consumers = 2000;
+    static const int per_consumer = 5;
+    static const int producers = 2;
+
+    std::unique_ptr<thread_pool> pPool(pinned ? new thread_pool(lockfree::cpu_topology::system().cpus()) : new thread_pool(2));
+    auto & pool = *pPool;
+    async_queue<int, thread_pool::executor> q(pool.get_executor());
+    atomic<long long> sum{ 0 };
+    latch done(consumers);
+
+    for (int c = 0; c < consumers; ++c)
+    {
+        consume(q, per_consumer, sum, done);
+    }
+
+    const int items = consumers * per_consumer / producers;
+    vector<future<void>> vf;
+    for (int t = 0; t < producers; ++t)
+    {
+        vf.emplace_back(async(std::launch::async, [&q, items]() {
+            for (int i = 1; i <= items; ++i)
+            {
+                q.push(i);
+            }
+        }));
+    }
+    for (auto & task : vf)
+    {
+        task.wait();
+    }
+    done.wait();
+
+    long long expected = producers * (static_cast<long long>(items) * (items + 1) / 2);
+    bool failed = (sum.load() != expected);
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : parallelism test - " << consumers << " consumer coroutines on " << pool.thread_count() << (pinned ? " pinned" : "") << " threads." << std::flush;
+    return !failed;
+}
+
+// Stack address of the caller's frame, to measure how deep resumptions nest.
+__attribute__((noinline)) std::uintptr_t stack_address()
+{
+    return reinterpret_cast<std::uintptr_t>(__builtin_frame_address(0));
+}
+
+// Spread of the stack addresses of the calls to seen(), ie. the stack growth across resumptions.
+struct stack_spread
+{
+    std::uintptr_t low = ~std::uintptr_t(0);
+    std::uintptr_t high = 0;
+
+    void seen()
+    {
+        auto a = stack_address();
+        low = (a < low) ? a : low;
+        high = (a > high) ? a : high;
+    }
+
+    std::uintptr_t bytes() const
+    {
+        return high - low;
+    }
+};
+
+detached relay(async_queue<int> & q, stack_spread & spread, latch & done)
+{
+    auto item = co_await q.pop();
+    spread.seen();
+    q.push(item + 1);
+    done.count_down();
+}
+
+// Consumers waiting on inline_executor, each pushing for the next one when resumed.
+bool testcase_long_chain()
+{
+    static const int consumers = 100000;
+
+    async_queue<int> q;
+    stack_spread spread;
+    latch done(consumers);
+    for (int c = 0; c < consumers; ++c)
+    {
+        relay(q, spread, done);
+    }
+    q.push(0);
+
+    int last = -1;
+    // A frame per consumer would be megabytes. Allow a few frames for the first consumer resumed.
+    bool failed = !done.try_wait() || !q.try_pop(last) || (last != consumers) || (spread.bytes() > 4096);
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : long chain test - " << consumers << " consumers on inline_executor, each resuming the next, stack growth " << spread.bytes() << " bytes." << std::flush;
+    return !failed;
+}
+
+#define RUN_TEST(...) { if (!(__VA_ARGS__)) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity());
+    RUN_TEST(testcase_parallelism(false));
+    RUN_TEST(testcase_parallelism(true));
+    RUN_TEST(testcase_long_chain());
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
@@ -0,0 +1,212 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++20 -pthread -march=native test_async_shared_mutex.cpp -latomic
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "async_shared_mutex.h"
+#include "../sync/latch.h"
+
+#include <iostream>
+#include <vector>
+#include <stdexcept>
+#include <exception>
+#include <cstdint>
+
+using std::cout;
+using std::vector;
+using std::logic_error;
+using std::flush;
+using std::atomic;
+
+using lockfree::async_shared_mutex;
+using lockfree::thread_pool;
+using lockfree::latch;
+
+// Coroutine return type that starts at once and frees itself when done.
+struct detached
+{
+    struct promise_type
+    {
+        detached get_return_object() { return detached(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+template<typename mutex_type>
+detached read_once(mutex_type & m, atomic<int> & readers, latch & done)
+{
+    co_await m.lock_shared();
+    readers++;
+    done.count_down();
+}
+
+bool testcase_sanity()
+{
+    bool bResult = false;
+    try
+    {
+        async_shared_mutex<> m;
+        if (!m.try_lock()) throw logic_error("try_lock failed on free mutex.");
+        if (m.try_lock_shared()) throw logic_error("try_lock_shared succeeded while exclusive.");
+
+        // readers suspend behind the writer, and are granted together on unlock.
+        atomic<int> readers{ 0 };
+        latch done(3);
+        for (int r = 0; r < 3; ++r)
+        {
+            read_once(m, readers, done);
+        }
+        if (readers.load() != 0) throw logic_error("reader did not suspend.");
+        m.unlock();
+        if (!done.try_wait() || readers.load() != 3) throw logic_error("readers not granted together.");
+
+        if (m.try_lock()) throw logic_error("try_lock succeeded while shared.");
+        for (int r = 0; r < 3; ++r)
+        {
+            m.unlock_shared();
+        }
+        if (!m.try_lock()) throw logic_error("mutex not free after readers unlocked.");
+        m.unlock();
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - single threaded exclusive then shared." << std::flush;
+    return bResult;
+}
+
+template<typename mutex_type>
+detached read_write(mutex_type & m, int rounds, atomic<int> & shared_in, atomic<int> & exclusive_in, atomic<bool> & failed, latch & done)
+{
+    for (int i = 0; i < rounds; ++i)
+    {
+        if (i % 4 == 0)
+        {
+            co_await m.lock();
+            if (exclusive_in.fetch_add(1) != 0 || shared_in.load() != 0) failed = true;
+            exclusive_in.fetch_sub(1);
+            m.unlock();
+        }
+        else
+        {
+            co_await m.lock_shared();
+            shared_in.fetch_add(1);
+            if (exclusive_in.load() != 0) failed = true;
+            shared_in.fetch_sub(1);
+            m.unlock_shared();
+        }
+    }
+    done.count_down();
+}
+
+// Thousands of coroutines share a small thread pool.
+bool testcase_parallelism()
+{
+    static const int coroutines = 1000;
+    static const int rounds = 20;
+
+    thread_pool pool(3);
+    async_shared_mutex<thread_pool::executor> m(pool.get_executor());
+    atomic<int> shared_in{ 0 };
+    atomic<int> exclusive_in{ 0 };
+    atomic<bool> failed{ false };
+    latch done(coroutines);
+
+    // hold the mutex while starting, so that all start suspended.
+    if (!m.try_lock()) failed = true;
+    for (int c = 0; c < coroutines; ++c)
+    {
+        read_write(m, rounds, shared_in, exclusive_in, failed, done);
+    }
+    m.unlock();
+    done.wait();
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : parallelism test - " << coroutines << " coroutines on " << pool.thread_count() << " threads." << std::flush;
+    return !failed;
+}
+
+// Stack address of the caller's frame, to measure how deep resumptions nest.
+__attribute__((noinline)) std::uintptr_t stack_address()
+{
+    return reinterpret_cast<std::uintptr_t>(__builtin_frame_address(0));
+}
+
+// Spread of the stack addresses of the calls to seen(), ie. the stack growth across resumptions.
+struct stack_spread
+{
+    std::uintptr_t low = ~std::uintptr_t(0);
+    std::uintptr_t high = 0;
+
+    void seen()
+    {
+        auto a = stack_address();
+        low = (a < low) ? a : low;
+        high = (a > high) ? a : high;
+    }
+
+    std::uintptr_t bytes() const
+    {
+        return high - low;
+    }
+};
+
+detached write_once(async_shared_mutex<> & m, int & writes, stack_spread & spread, latch & done)
+{
+    co_await m.lock();
+    spread.seen();
+    writes++;
+    m.unlock();
+    done.count_down();
+}
+
+// Writers queued behind a held mutex, on inline_executor. Each unlock resumes the next writer,
+// which unlocks in turn, so resuming inline without a trampoline would nest a frame per writer.
+bool testcase_long_chain()
+{
+    static const int writers = 100000;
+
+    async_shared_mutex<> m;
+    int writes = 0;
+    stack_spread spread;
+    latch done(writers);
+
+    m.try_lock();
+    for (int w = 0; w < writers; ++w)
+    {
+        write_once(m, writes, spread, done);
+    }
+    bool failed = (writes != 0);
+    m.unlock();
+    // A frame per writer would be megabytes. Allow a few frames for the first writer resumed.
+    failed = failed || !done.try_wait() || (writes != writers) || !m.try_lock() || (spread.bytes() > 4096);
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : long chain test - " << writers << " writers queued on inline_executor, stack growth " << spread.bytes() << " bytes." << std::flush;
+    return !failed;
+}
+
+#define RUN_TEST(...) { if (!(__VA_ARGS__)) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity());
+    RUN_TEST(testcase_parallelism());
+    RUN_TEST(testcase_long_chain());
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
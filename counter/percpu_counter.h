@@ -0,0 +1,170 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "sharded_counter.h"
+#include "../util/cache_line.h"
+#include "../util/rseq.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+using std::memory_order_relaxed;
+
+// Per-cpu statistics counter and gauge using Linux restartable sequences.
+// Note: An increment is a plain add to the slot of the current cpu, with no atomic instruction.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+The same interface as sharded_counter.h, but a slot per cpu instead of a shard per thread.
+percpu_counter is basic_percpu_counter<std::uint64_t>, for counts that only go up.
+percpu_gauge is basic_percpu_counter<std::int64_t>, for values that go up and down.
+
+add(), sub(), ++ and -- : add to the slot of the current cpu, within an rseq section of rseq.h.
+value()                 : sum of all slots. As for sharded_counter, not a snapshot,
+                          but exact once the increments are done.
+per_cpu()               : whether the per-cpu slots are in use.
+There is no read_and_reset(), since zeroing a slot from another cpu would race with the plain adds.
+
+Design:
+A sharded_counter increment is a fetch_add, a locked instruction, on a shard only its thread writes.
+With a slot per cpu, no other thread can write the slot while the rseq section runs,
+so the add need not be atomic. A section that is preempted or migrated aborts before its add, and is retried.
+The slot count is the cpu count, however many threads there are, and a thread that moves
+between cpus needs no slot of its own.
+value() reads the slots with relaxed loads. An aligned 8 byte add is a single store,
+so a reader sees a slot before or after it, never torn.
+
+When rseq_ops::available() is false, or use_rseq is false, it is a sharded_counter.
+A thread whose rseq is not registered adds to that sharded_counter too, never to a slot,
+since its fetch_add would race with the plain adds of the cpu.
+*/
+
+namespace lockfree
+{
+
+template<typename T>
+class basic_percpu_counter
+{
+public:
+    static_assert(std::is_integral<T>::value && sizeof(T) == sizeof(std::intptr_t), "basic_percpu_counter needs a word sized integer.");
+
+    explicit basic_percpu_counter(bool use_rseq = true) :
+        m_sharded((use_rseq && rseq_ops::available()) ? 1 : basic_sharded_counter<T>::default_shard_count())
+    {
+        if (use_rseq && rseq_ops::available())
+        {
+            for (unsigned int i = 0; i < rseq_ops::cpu_slots(); ++i)
+            {
+                m_slots.emplace_back(new slot);
+            }
+        }
+    }
+
+    basic_percpu_counter(const basic_percpu_counter &) = delete;
+    basic_percpu_counter & operator=(const basic_percpu_counter &) = delete;
+
+    void add(T delta)
+    {
+        add_word(static_cast<std::intptr_t>(delta));
+    }
+
+    void sub(T delta)
+    {
+        // Two's complement wrap, as fetch_sub of an unsigned counter.
+        add_word(-static_cast<std::intptr_t>(delta));
+    }
+
+    basic_percpu_counter & operator++()
+    {
+        add(1);
+        return *this;
+    }
+
+    basic_percpu_counter & operator--()
+    {
+        sub(1);
+        return *this;
+    }
+
+    basic_percpu_counter & operator+=(T delta)
+    {
+        add(delta);
+        return *this;
+    }
+
+    basic_percpu_counter & operator-=(T delta)
+    {
+        sub(delta);
+        return *this;
+    }
+
+    T value() const
+    {
+        T total = m_sharded.value();
+        for (auto & pSlot : m_slots)
+        {
+            total += static_cast<T>(pSlot->value.load(memory_order_relaxed));
+        }
+        return total;
+    }
+
+    operator T() const
+    {
+        return value();
+    }
+
+    bool per_cpu() const
+    {
+        return !m_slots.empty();
+    }
+
+private:
+    struct alignas(cache_line_size) slot : public cache_aligned
+    {
+        slot() : value{ 0 }
+        {
+        }
+
+        // rseq sections add to it as a plain word. Atomic only for the reads of value().
+        std::atomic<std::intptr_t> value;
+    };
+
+    void add_word(std::intptr_t delta)
+    {
+        for (;;)
+        {
+            auto cpu = rseq_ops::current_cpu();
+            if (cpu < 0 || static_cast<std::size_t>(cpu) >= m_slots.size())
+            {
+                m_sharded.add(static_cast<T>(delta));
+                return;
+            }
+
+            auto pValue = reinterpret_cast<std::intptr_t *>(&m_slots[cpu]->value);
+            if (rseq_ops::add(pValue, delta, cpu) == rseq_status::committed)
+            {
+                return;
+            }
+        }
+    }
+
+    // Allocated one by one, so that each gets the cache_aligned operator new.
+    std::vector<std::unique_ptr<slot>> m_slots;
+    basic_sharded_counter<T> m_sharded;
+};
+
+using percpu_counter = basic_percpu_counter<std::uint64_t>;
+using percpu_gauge = basic_percpu_counter<std::int64_t>;
+
+}
@@ -0,0 +1,209 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "../util/cache_line.h"
+
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <thread>
+#include <type_traits>
+
+using std::memory_order_relaxed;
+
+// Sharded statistics counter and gauge using C++11.
+// Note: Increments from different threads go to different cache lines, so they scale with cores.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+A single std::atomic counter incremented from every thread is one cache line
+that bounces between all cores, next to the containers it is meant to measure.
+A sharded counter spreads the count over shards, each on its own cache line,
+and sums the shards only when read.
+
+sharded_counter is basic_sharded_counter<std::uint64_t>, for counts that only go up.
+sharded_gauge is basic_sharded_counter<std::int64_t>, for values that go up and down,
+eg. items in flight. A shard of a gauge can be negative; only the sum is meaningful.
+
+add(), sub(), ++ and -- : relaxed increment of the shard of the current thread.
+value()                 : sum of all shards. Not a snapshot; increments running concurrently
+                          may or may not be counted. Once they are done, value() is exact.
+read_and_reset()        : sums and zeroes the shards with exchange, so that no increment is lost
+                          or counted twice across successive calls. Suits interval rates.
+Neither reads nor increments ever block each other.
+
+Design:
+Each thread takes a slot the first time it touches any sharded counter, from a process wide
+round robin sequence. The shard count is rounded up to a power of two,
+so the shard of a thread is its slot masked by the shard count less one.
+So while there are no more threads than shards, every thread has a shard of its own,
+and an increment is an uncontended fetch_add on a cache line only that thread writes.
+With more threads than shards, threads share shards; counts stay exact, only scaling suffers.
+
+Shards are per-thread, rather than per-cpu by sched_getcpu(), since a thread_local read is cheaper
+than asking for the cpu, and a thread that is not pinned would keep changing shards.
+The default shard count is std::thread::hardware_concurrency(), so a pinned thread per core
+gets a shard of its own.
+The slot is a constant initialized thread_local, so reading it takes no initialization guard,
+and the shards are one cache line aligned array, so an increment is a thread_local read,
+a mask, and the fetch_add.
+
+A shard is still an atomic, since two threads may share it, and read_and_reset() zeroes it
+concurrently with increments. Relaxed order is enough, since a counter orders no other data.
+*/
+
+namespace lockfree
+{
+
+// Shared by all sharded counters of every type, so that a thread is at the same shard index in all of them.
+// Not a static member of the template, which would be one per type.
+inline unsigned int sharded_counter_thread_slot()
+{
+    static std::atomic<unsigned int> next{ 0 };
+    // The slot plus one, 0 until the thread first asks.
+    static thread_local unsigned int slotPlusOne = 0;
+    if (!slotPlusOne)
+    {
+        slotPlusOne = next.fetch_add(1, memory_order_relaxed) + 1;
+    }
+    return slotPlusOne - 1;
+}
+
+template<typename T>
+class basic_sharded_counter
+{
+public:
+    explicit basic_sharded_counter(unsigned int shard_count = default_shard_count()) :
+        m_shardMask(round_up_pow2(shard_count) - 1),
+        m_pRaw(::operator new((m_shardMask + 1) * sizeof(shard) + cache_line_size)),
+        m_pShards(reinterpret_cast<shard *>((reinterpret_cast<std::uintptr_t>(m_pRaw) + cache_line_size - 1) & ~(cache_line_size - 1)))
+    {
+        for (unsigned int i = 0; i <= m_shardMask; ++i)
+        {
+            new (&m_pShards[i]) shard;
+        }
+    }
+
+    ~basic_sharded_counter()
+    {
+        ::operator delete(m_pRaw);
+    }
+
+    basic_sharded_counter(const basic_sharded_counter &) = delete;
+    basic_sharded_counter & operator=(const basic_sharded_counter &) = delete;
+
+    void add(T delta)
+    {
+        local().value.fetch_add(delta, memory_order_relaxed);
+    }
+
+    void sub(T delta)
+    {
+        local().value.fetch_sub(delta, memory_order_relaxed);
+    }
+
+    basic_sharded_counter & operator++()
+    {
+        add(1);
+        return *this;
+    }
+
+    basic_sharded_counter & operator--()
+    {
+        sub(1);
+        return *this;
+    }
+
+    basic_sharded_counter & operator+=(T delta)
+    {
+        add(delta);
+        return *this;
+    }
+
+    basic_sharded_counter & operator-=(T delta)
+    {
+        sub(delta);
+        return *this;
+    }
+
+    T value() const
+    {
+        T total = 0;
+        for (unsigned int i = 0; i <= m_shardMask; ++i)
+        {
+            total += m_pShards[i].value.load(memory_order_relaxed);
+        }
+        return total;
+    }
+
+    operator T() const
+    {
+        return value();
+    }
+
+    T read_and_reset()
+    {
+        T total = 0;
+        for (unsigned int i = 0; i <= m_shardMask; ++i)
+        {
+            total += m_pShards[i].value.exchange(0, memory_order_relaxed);
+        }
+        return total;
+    }
+
+    unsigned int shard_count() const
+    {
+        return m_shardMask + 1;
+    }
+
+    static unsigned int default_shard_count()
+    {
+        auto n = std::thread::hardware_concurrency();
+        return n ? n : 1;
+    }
+
+private:
+    struct alignas(cache_line_size) shard
+    {
+        shard() : value{ 0 }
+        {
+        }
+
+        std::atomic<T> value;
+    };
+    static_assert(std::is_trivially_destructible<shard>::value, "basic_sharded_counter frees shards without destroying them.");
+
+    static unsigned int round_up_pow2(unsigned int n)
+    {
+        unsigned int p = 1;
+        while (p < n)
+        {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    shard & local()
+    {
+        return m_pShards[sharded_counter_thread_slot() & m_shardMask];
+    }
+
+    const unsigned int m_shardMask;
+    // Over allocated by a cache line, so that the shards start on one. operator new does not align
+    // to cache_line_size before C++17.
+    void * const m_pRaw;
+    shard * const m_pShards;
+};
+
+using sharded_counter = basic_sharded_counter<std::uint64_t>;
+using sharded_gauge = basic_sharded_counter<std::int64_t>;
+
+}
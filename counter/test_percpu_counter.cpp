@@ -0,0 +1,153 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread test_percpu_counter.cpp
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "percpu_counter.h"
+
+#include <iostream>
+#include <future>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+
+using std::cout;
+using std::vector;
+using std::logic_error;
+using std::flush;
+using std::future;
+namespace chrono = std::chrono;
+
+using lockfree::percpu_counter;
+using lockfree::percpu_gauge;
+using lockfree::sharded_counter;
+
+bool testcase_sanity(bool use_rseq)
+{
+    bool bResult = false;
+    percpu_counter c(use_rseq);
+    try
+    {
+        if (!use_rseq && c.per_cpu()) throw logic_error("per cpu slots in use though turned off.");
+        if (c.value() != 0) throw logic_error("counter not zero initially.");
+        ++c;
+        c += 4;
+        c.add(5);
+        if (c != 10) throw logic_error("unexpected count.");
+        c -= 3;
+        --c;
+        c.sub(1);
+        if (c.value() != 5) throw logic_error("unexpected count after sub.");
+
+        percpu_gauge g(use_rseq);
+        --g;
+        g -= 9;
+        if (g.value() != -10) throw logic_error("gauge not negative.");
+        g += 10;
+        if (g.value() != 0) throw logic_error("gauge not back to zero.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - " << (c.per_cpu() ? "per cpu slots" : "sharded") << ", counter and gauge operations." << std::flush;
+    return bResult;
+}
+
+// More threads than cpus, so that adds are preempted and retried.
+bool testcase_exact_count(bool use_rseq)
+{
+    static const int threads = 8;
+    static const int increments = 100000;
+
+    percpu_counter c(use_rseq);
+    percpu_gauge g(use_rseq);
+
+    vector<future<void>> vf;
+    for (int t = 0; t < threads; ++t)
+    {
+        vf.emplace_back(async(std::launch::async, [&c, &g]() {
+            for (int i = 0; i < increments; ++i)
+            {
+                ++c;
+                ++g;
+                --g;
+            }
+        }));
+    }
+    for (auto & task : vf)
+    {
+        task.wait();
+    }
+
+    bool failed = (c.value() != static_cast<std::uint64_t>(threads) * increments) || (g.value() != 0);
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : exact count test - " << (c.per_cpu() ? "per cpu slots" : "sharded") << ", " << threads << " threads." << std::flush;
+    return !failed;
+}
+
+// Reports increment cost against a sharded_counter. Not a pass or fail criterion.
+template<typename Counter>
+double ns_per_increment(Counter & c, unsigned int threads)
+{
+    static const int increments = 1000000;
+
+    auto start = chrono::steady_clock::now();
+    vector<future<void>> vf;
+    for (unsigned int t = 0; t < threads; ++t)
+    {
+        vf.emplace_back(async(std::launch::async, [&c]() {
+            for (int i = 0; i < increments; ++i)
+            {
+                ++c;
+            }
+        }));
+    }
+    for (auto & task : vf)
+    {
+        task.wait();
+    }
+    auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    return static_cast<double>(ns) / increments;
+}
+
+bool testcase_scaling()
+{
+    auto threads = sharded_counter::default_shard_count();
+
+    sharded_counter sharded;
+    percpu_counter percpu;
+    auto sharded_ns = ns_per_increment(sharded, threads);
+    auto percpu_ns = ns_per_increment(percpu, threads);
+
+    bool failed = (sharded.value() != percpu.value());
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : scaling test - " << threads << " threads, wall ns per increment per thread: sharded "
+        << sharded_ns << ", " << (percpu.per_cpu() ? "per cpu " : "per cpu not available, sharded ") << percpu_ns << "." << std::flush;
+    return !failed;
+}
+
+#define RUN_TEST(...) { if (!(__VA_ARGS__)) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity(true));
+    RUN_TEST(testcase_sanity(false));
+    RUN_TEST(testcase_exact_count(true));
+    RUN_TEST(testcase_exact_count(false));
+    RUN_TEST(testcase_scaling());
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
@@ -0,0 +1,198 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread test_sharded_counter.cpp
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "sharded_counter.h"
+
+#include <iostream>
+#include <future>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+
+using std::cout;
+using std::vector;
+using std::logic_error;
+using std::flush;
+using std::future;
+namespace chrono = std::chrono;
+
+using lockfree::sharded_counter;
+using lockfree::sharded_gauge;
+
+bool testcase_sanity()
+{
+    bool bResult = false;
+    try
+    {
+        sharded_counter c(4);
+        if (c.shard_count() != 4) throw logic_error("unexpected shard count.");
+        if (sharded_counter(5).shard_count() != 8) throw logic_error("shard count not rounded up to a power of two.");
+        if (sharded_counter(0).shard_count() != 1) throw logic_error("shard count of 0 not rounded up to 1.");
+        if (c.value() != 0) throw logic_error("counter not zero initially.");
+
+        ++c;
+        c += 10;
+        c.add(5);
+        if (c.value() != 16) throw logic_error("unexpected count.");
+        if (c.read_and_reset() != 16) throw logic_error("unexpected count on reset.");
+        if (c.value() != 0) throw logic_error("counter not zero after reset.");
+
+        sharded_gauge g;
+        ++g;
+        --g;
+        --g;
+        g -= 4;
+        if (g.value() != -5) throw logic_error("unexpected gauge value.");
+        g += 5;
+        if (static_cast<std::int64_t>(g) != 0) throw logic_error("gauge not back to zero.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - counter and gauge operations." << std::flush;
+    return bResult;
+}
+
+// More threads than shards, so that threads share shards.
+bool testcase_exact_count()
+{
+    static const int threads = 8;
+    static const int increments = 100000;
+
+    sharded_counter c(3);
+    sharded_gauge g(3);
+
+    vector<future<void>> vf;
+    for (int t = 0; t < threads; ++t)
+    {
+        vf.emplace_back(async(std::launch::async, [&c, &g]() {
+            for (int i = 0; i < increments; ++i)
+            {
+                ++c;
+                ++g;
+                --g;
+            }
+        }));
+    }
+    for (auto & task : vf)
+    {
+        task.wait();
+    }
+
+    bool failed = (c.value() != static_cast<std::uint64_t>(threads) * increments) || (g.value() != 0);
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : exact count test - " << threads << " threads on " << c.shard_count() << " shards." << std::flush;
+    return !failed;
+}
+
+// Resets concurrent with increments neither lose nor double count.
+bool testcase_read_and_reset()
+{
+    static const int threads = 4;
+    static const int increments = 200000;
+
+    sharded_counter c;
+    std::atomic<bool> done{ false };
+    std::uint64_t collected = 0;
+
+    auto reader = async(std::launch::async, [&c, &done, &collected]() {
+        while (!done.load())
+        {
+            collected += c.read_and_reset();
+            std::this_thread::yield();
+        }
+    });
+
+    vector<future<void>> vf;
+    for (int t = 0; t < threads; ++t)
+    {
+        vf.emplace_back(async(std::launch::async, [&c]() {
+            for (int i = 0; i < increments; ++i)
+            {
+                c.add(1);
+            }
+        }));
+    }
+    for (auto & task : vf)
+    {
+        task.wait();
+    }
+    done.store(true);
+    reader.wait();
+    collected += c.read_and_reset();
+
+    bool failed = (collected != static_cast<std::uint64_t>(threads) * increments);
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : read and reset test - concurrent resets neither lose nor double count." << std::flush;
+    return !failed;
+}
+
+// Reports increment cost against a single shared atomic. Not a pass or fail criterion,
+// since the ratio depends on the core count of the host.
+template<typename Counter>
+double ns_per_increment(Counter & c, unsigned int threads)
+{
+    static const int increments = 1000000;
+
+    auto start = chrono::steady_clock::now();
+    vector<future<void>> vf;
+    for (unsigned int t = 0; t < threads; ++t)
+    {
+        vf.emplace_back(async(std::launch::async, [&c]() {
+            for (int i = 0; i < increments; ++i)
+            {
+                ++c;
+            }
+        }));
+    }
+    for (auto & task : vf)
+    {
+        task.wait();
+    }
+    auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    return static_cast<double>(ns) / increments;
+}
+
+bool testcase_scaling()
+{
+    auto threads = sharded_counter::default_shard_count();
+
+    std::atomic<std::uint64_t> single{ 0 };
+    sharded_counter sharded;
+    auto single_ns = ns_per_increment(single, threads);
+    auto sharded_ns = ns_per_increment(sharded, threads);
+
+    bool failed = (single.load() != sharded.value());
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : scaling test - " << threads << " threads, wall ns per increment per thread: single atomic "
+        << single_ns << ", sharded " << sharded_ns << "." << std::flush;
+    return !failed;
+}
+
+#define RUN_TEST(testcase) { if (!testcase()) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity);
+    RUN_TEST(testcase_exact_count);
+    RUN_TEST(testcase_read_and_reset);
+    RUN_TEST(testcase_scaling);
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
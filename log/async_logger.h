@@ -0,0 +1,700 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "../util/cache_line.h"
+#include "../mutex/spin_lock.h"
+#include "../parking_lot/parking_lot.h"
+#include "../util/timestamp.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <sys/uio.h>
+#include <unistd.h>
+#include <climits>
+#include <cerrno>
+
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_release;
+using std::memory_order_acq_rel;
+
+// Asynchronous logger with lock free per-thread buffers and deferred formatting, using C++11.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+    lockfree::async_logger logger(STDERR_FILENO);
+    logger.info("queue {} refilled {} nodes in {} us", name, count, elapsed);
+The format string must outlive the logger, eg. a string literal, since it is formatted later.
+Each {} is replaced by the next argument.
+Arguments can be integers, floating point, bool, char, pointers, C strings and std::string.
+Up to max_args arguments. String arguments are copied, truncated to fit in the record.
+log() never blocks and never allocates, except for the ring of a thread on its first log call.
+If the ring of a thread is full the record is dropped and counted in dropped().
+flush() waits until all records logged before it are written.
+A logger must outlive its use by other threads, as usual.
+
+Design:
+Each thread logs into its own single producer single consumer ring of fixed size binary records:
+timestamp, level, format string pointer, argument type tags and values, and copied string bytes.
+A log call is a thread_local lookup, a read_timestamp() from timestamp.h, a copy of the arguments,
+and a release store.
+A background thread wakes every flush interval, or on flush(), and
+    1. collects the records of all rings, and orders them by timestamp. The records of a thread
+        are always in order; records of different threads are in order within a batch only,
+        since a record timestamped earlier may be published after the batch was collected.
+    2. formats them. Literal text is not copied; each piece of a format string between {}
+        becomes its own iovec, and only the timestamp and argument text go to a scratch buffer.
+    3. writes the batch with writev, IOV_MAX iovecs at a time.
+    4. only then frees the ring slots, since iovecs may point into the records.
+A ring is returned to the logger when its thread exits, and reused by the next new thread.
+Rings are shared_ptr owned, by the logger and the thread, so either may go first.
+*/
+
+namespace lockfree
+{
+
+class async_logger
+{
+public:
+    enum class level : std::uint8_t
+    {
+        debug,
+        info,
+        warning,
+        error
+    };
+
+    static const unsigned int max_args = 6;
+
+    explicit async_logger(int fd = STDERR_FILENO, unsigned int ring_capacity = 1024, level min_level = level::debug,
+        std::chrono::microseconds flush_interval = std::chrono::microseconds(1000)) :
+        m_fd(fd),
+        m_ringCapacity(round_up_pow2(ring_capacity)),
+        m_minLevel(min_level),
+        m_flushInterval(flush_interval),
+        m_id(next_id()),
+        m_dropped{ 0 },
+        m_flushRequest{ 0 },
+        m_flushed{ 0 },
+        m_stop{ false },
+        m_systemStart(std::chrono::system_clock::now())
+    {
+        m_thread = std::thread([this]() { run(); });
+    }
+
+    async_logger(const async_logger &) = delete;
+    async_logger & operator=(const async_logger &) = delete;
+
+    // Writes what is logged, then stops the background thread.
+    ~async_logger()
+    {
+        m_stop.store(true, memory_order_release);
+        parking_lot::unpark_one(&m_flushRequest);
+        m_thread.join();
+    }
+
+    // Returns false if the record was dropped, because the ring of this thread is full.
+    template<typename... Args>
+    bool log(level lvl, const char * fmt, const Args &... args)
+    {
+        static_assert(sizeof...(Args) <= max_args, "too many arguments to log.");
+
+        if (lvl < m_minLevel)
+        {
+            return true;
+        }
+
+        auto & r = this_thread_ring();
+        auto pRecord = r.begin_write();
+        if (!pRecord)
+        {
+            m_dropped.fetch_add(1, memory_order_relaxed);
+            return false;
+        }
+
+        pRecord->stamp = read_timestamp();
+        pRecord->fmt = fmt;
+        pRecord->lvl = static_cast<std::uint8_t>(lvl);
+        pRecord->argc = static_cast<std::uint8_t>(sizeof...(Args));
+        std::uint8_t text = 0;
+        encode(*pRecord, 0, text, args...);
+
+        r.end_write();
+        return true;
+    }
+
+    template<typename... Args>
+    bool info(const char * fmt, const Args &... args)
+    {
+        return log(level::info, fmt, args...);
+    }
+
+    template<typename... Args>
+    bool warning(const char * fmt, const Args &... args)
+    {
+        return log(level::warning, fmt, args...);
+    }
+
+    template<typename... Args>
+    bool error(const char * fmt, const Args &... args)
+    {
+        return log(level::error, fmt, args...);
+    }
+
+    // Waits until all records logged before this call are written.
+    void flush()
+    {
+        auto request = m_flushRequest.fetch_add(1, memory_order_acq_rel) + 1;
+        parking_lot::unpark_one(&m_flushRequest);
+
+        auto flushed = [this, request]() { return m_flushed.load(memory_order_acquire) >= request; };
+        while (!flushed())
+        {
+            parking_lot::park(&m_flushed, [&flushed]() { return !flushed(); });
+        }
+    }
+
+    std::uint64_t dropped() const
+    {
+        return m_dropped.load(memory_order_relaxed);
+    }
+
+private:
+    enum arg_type : std::uint8_t
+    {
+        t_int,
+        t_uint,
+        t_double,
+        t_bool,
+        t_char,
+        t_ptr,
+        t_str
+    };
+
+    // 128 bytes, two cache lines.
+    // Rings are value initialized, so the pages are touched once up front, not on the hot path.
+    struct record
+    {
+        std::uint64_t stamp;
+        const char * fmt;
+        std::uint8_t lvl;
+        std::uint8_t argc;
+        arg_type types[max_args];
+        union
+        {
+            std::int64_t i;
+            std::uint64_t u;
+            double d;
+            const void * p;
+        } args[max_args];
+        // copied string arguments, each 0 terminated. A t_str argument holds its offset.
+        char text[56];
+    };
+
+    static_assert(sizeof(record) == 128, "record is expected to be two cache lines.");
+
+    //
+    // Single producer single consumer ring of records.
+    // head is written by the producer, tail by the consumer; each on its own cache line.
+    //
+    class ring : public cache_aligned
+    {
+    public:
+        explicit ring(unsigned int capacity) :
+            m_records(new record[capacity]()), m_mask(capacity - 1), m_owned{ true },
+            m_head{ 0 }, m_cachedTail(0), m_tail{ 0 }
+        {
+        }
+
+        // Producer. Returns nullptr if full.
+        record * begin_write()
+        {
+            auto head = m_head.load(memory_order_relaxed);
+            if (head - m_cachedTail > m_mask)
+            {
+                // memory_order_acquire due to the consumer must be done with the slot before it is reused.
+                m_cachedTail = m_tail.load(memory_order_acquire);
+                if (head - m_cachedTail > m_mask)
+                {
+                    return nullptr;
+                }
+            }
+            return &m_records[head & m_mask];
+        }
+
+        // Producer.
+        void end_write()
+        {
+            // memory_order_release due to the record written must be visible to the consumer.
+            m_head.store(m_head.load(memory_order_relaxed) + 1, memory_order_release);
+        }
+
+        // Consumer. Records from tail up to the returned head are readable.
+        std::uint64_t readable(std::uint64_t & tail) const
+        {
+            tail = m_tail.load(memory_order_relaxed);
+            // memory_order_acquire due to the records up to head must be visible.
+            return m_head.load(memory_order_acquire);
+        }
+
+        const record & at(std::uint64_t index) const
+        {
+            return m_records[index & m_mask];
+        }
+
+        // Consumer.
+        void consumed(std::uint64_t tail)
+        {
+            // memory_order_release due to the reads of the records must be done before the producer reuses them.
+            m_tail.store(tail, memory_order_release);
+        }
+
+        bool try_claim()
+        {
+            bool expected = false;
+            // memory_order_acquire due to the last head written by the previous owner must be visible.
+            return m_owned.compare_exchange_strong(expected, true, memory_order_acquire, memory_order_relaxed);
+        }
+
+        void release()
+        {
+            // memory_order_release due to the head written must be visible to the next owner.
+            m_owned.store(false, memory_order_release);
+        }
+
+    private:
+        std::unique_ptr<record[]> m_records;
+        const std::uint64_t m_mask;
+        std::atomic<bool> m_owned;
+
+        alignas(cache_line_size) std::atomic<std::uint64_t> m_head;
+        std::uint64_t m_cachedTail;
+        alignas(cache_line_size) std::atomic<std::uint64_t> m_tail;
+    };
+
+    //
+    // The rings of this thread, one per logger it logs to.
+    // Returned to their loggers when the thread exits.
+    //
+    struct thread_rings
+    {
+        static const unsigned int max_loggers = 4;
+
+        thread_rings() : count(0), next(0)
+        {
+        }
+
+        ~thread_rings()
+        {
+            for (unsigned int i = 0; i < count; ++i)
+            {
+                entries[i].pRing->release();
+            }
+        }
+
+        struct entry
+        {
+            std::uint64_t loggerId;
+            std::shared_ptr<ring> pRing;
+        };
+
+        entry entries[max_loggers];
+        unsigned int count;
+        unsigned int next;
+    };
+
+    static std::uint64_t next_id()
+    {
+        static std::atomic<std::uint64_t> id{ 0 };
+        return id.fetch_add(1, memory_order_relaxed) + 1;
+    }
+
+    static unsigned int round_up_pow2(unsigned int n)
+    {
+        unsigned int p = 2;
+        while (p < n)
+        {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    ring & this_thread_ring()
+    {
+        static thread_local thread_rings rings;
+
+        // Loggers are told apart by id, not address, so a new logger at the address of an old one is not confused with it.
+        for (unsigned int i = 0; i < rings.count; ++i)
+        {
+            if (rings.entries[i].loggerId == m_id)
+            {
+                return *rings.entries[i].pRing;
+            }
+        }
+
+        unsigned int slot = rings.count;
+        if (slot == thread_rings::max_loggers)
+        {
+            slot = rings.next;
+            rings.next = (rings.next + 1) % thread_rings::max_loggers;
+            rings.entries[slot].pRing->release();
+        }
+        else
+        {
+            rings.count++;
+        }
+        rings.entries[slot].loggerId = m_id;
+        rings.entries[slot].pRing = acquire_ring();
+        return *rings.entries[slot].pRing;
+    }
+
+    // Once per thread. Reuses a ring released by an exited thread if there is one.
+    std::shared_ptr<ring> acquire_ring()
+    {
+        std::lock_guard<spin_lock> lk(m_ringsLock);
+        for (auto & pRing : m_rings)
+        {
+            if (pRing->try_claim())
+            {
+                return pRing;
+            }
+        }
+        m_rings.emplace_back(new ring(m_ringCapacity));
+        return m_rings.back();
+    }
+
+    //
+    // Argument encoding.
+    //
+    static void encode(record &, unsigned int, std::uint8_t &)
+    {
+    }
+
+    template<typename T, typename... Rest>
+    static void encode(record & r, unsigned int i, std::uint8_t & text, const T & arg, const Rest &... rest)
+    {
+        put(r, i, text, arg);
+        encode(r, i + 1, text, rest...);
+    }
+
+    template<typename T>
+    static typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+        put(record & r, unsigned int i, std::uint8_t &, T v)
+    {
+        r.types[i] = t_int;
+        r.args[i].i = v;
+    }
+
+    template<typename T>
+    static typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+        put(record & r, unsigned int i, std::uint8_t &, T v)
+    {
+        r.types[i] = t_uint;
+        r.args[i].u = v;
+    }
+
+    template<typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value>::type
+        put(record & r, unsigned int i, std::uint8_t &, T v)
+    {
+        r.types[i] = t_double;
+        r.args[i].d = v;
+    }
+
+    static void put(record & r, unsigned int i, std::uint8_t &, bool v)
+    {
+        r.types[i] = t_bool;
+        r.args[i].u = v;
+    }
+
+    static void put(record & r, unsigned int i, std::uint8_t &, char v)
+    {
+        r.types[i] = t_char;
+        r.args[i].u = static_cast<unsigned char>(v);
+    }
+
+    template<typename T>
+    static void put(record & r, unsigned int i, std::uint8_t &, T * v)
+    {
+        r.types[i] = t_ptr;
+        r.args[i].p = v;
+    }
+
+    static void put(record & r, unsigned int i, std::uint8_t & text, const char * v)
+    {
+        put_string(r, i, text, v ? v : "(null)", v ? std::strlen(v) : 6);
+    }
+
+    static void put(record & r, unsigned int i, std::uint8_t & text, char * v)
+    {
+        put(r, i, text, static_cast<const char *>(v));
+    }
+
+    static void put(record & r, unsigned int i, std::uint8_t & text, const std::string & v)
+    {
+        put_string(r, i, text, v.data(), v.size());
+    }
+
+    static void put_string(record & r, unsigned int i, std::uint8_t & text, const char * s, std::size_t length)
+    {
+        r.types[i] = t_str;
+        r.args[i].u = text;
+        std::size_t room = sizeof(r.text) - text - 1;
+        length = (length < room) ? length : room;
+        std::memcpy(r.text + text, s, length);
+        r.text[text + length] = 0;
+        text = static_cast<std::uint8_t>(text + length + 1);
+        // a later string argument gets an empty string if there is no room left.
+        if (text >= sizeof(r.text))
+        {
+            text = sizeof(r.text) - 1;
+        }
+    }
+
+    //
+    // Background thread.
+    //
+    void run()
+    {
+        // large, so allocated once.
+        std::unique_ptr<writer> w(new writer(m_fd));
+        std::vector<std::shared_ptr<ring>> rings;
+        std::vector<std::uint64_t> tails;
+        std::vector<const record *> batch;
+        for (;;)
+        {
+            // memory_order_acquire due to the records logged before a flush request must be visible.
+            auto request = m_flushRequest.load(memory_order_acquire);
+            auto stop = m_stop.load(memory_order_acquire);
+
+            {
+                std::lock_guard<spin_lock> lk(m_ringsLock);
+                rings = m_rings;
+            }
+
+            // collect.
+            batch.clear();
+            tails.resize(rings.size());
+            for (std::size_t r = 0; r < rings.size(); ++r)
+            {
+                std::uint64_t tail = 0;
+                auto head = rings[r]->readable(tail);
+                for (auto i = tail; i != head; ++i)
+                {
+                    batch.push_back(&rings[r]->at(i));
+                }
+                tails[r] = head;
+            }
+            m_scale.update();
+            std::stable_sort(batch.begin(), batch.end(), [](const record * a, const record * b) { return a->stamp < b->stamp; });
+
+            for (auto pRecord : batch)
+            {
+                format(*w, *pRecord);
+            }
+            w->flush();
+
+            for (std::size_t r = 0; r < rings.size(); ++r)
+            {
+                rings[r]->consumed(tails[r]);
+            }
+
+            if (request)
+            {
+                m_flushed.store(request, memory_order_release);
+                parking_lot::unpark_all(&m_flushed);
+            }
+            if (stop)
+            {
+                return;
+            }
+
+            auto deadline = std::chrono::steady_clock::now() + m_flushInterval;
+            parking_lot::park_until(&m_flushRequest, [this, request]() {
+                return m_flushRequest.load(memory_order_relaxed) == request && !m_stop.load(memory_order_relaxed);
+            }, deadline);
+        }
+    }
+
+    class writer
+    {
+    public:
+        explicit writer(int fd) : m_fd(fd), m_iovCount(0), m_scratchUsed(0)
+        {
+        }
+
+        void literal(const char * s, std::size_t length)
+        {
+            if (length)
+            {
+                add(s, length);
+            }
+        }
+
+        // Copies s to scratch, then adds it.
+        void text(const char * s, std::size_t length)
+        {
+            // flush first if either is full, since a flush frees the scratch buffer.
+            if (m_scratchUsed + length > sizeof(m_scratch) || m_iovCount == max_iov)
+            {
+                flush();
+                length = (length < sizeof(m_scratch)) ? length : sizeof(m_scratch);
+            }
+            std::memcpy(m_scratch + m_scratchUsed, s, length);
+            add(m_scratch + m_scratchUsed, length);
+            m_scratchUsed += length;
+        }
+
+        void flush()
+        {
+            auto pIov = m_iov;
+            auto count = m_iovCount;
+            while (count)
+            {
+                auto written = ::writev(m_fd, pIov, static_cast<int>(count));
+                if (written < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    break;
+                }
+                // skip what was written, for a partial write.
+                auto left = static_cast<std::size_t>(written);
+                while (count && left >= pIov->iov_len)
+                {
+                    left -= pIov->iov_len;
+                    pIov++;
+                    count--;
+                }
+                if (count)
+                {
+                    pIov->iov_base = static_cast<char *>(pIov->iov_base) + left;
+                    pIov->iov_len -= left;
+                }
+            }
+            m_iovCount = 0;
+            m_scratchUsed = 0;
+        }
+
+    private:
+        static const std::size_t max_iov = (IOV_MAX < 1024) ? IOV_MAX : 1024;
+
+        void add(const char * s, std::size_t length)
+        {
+            // merge with the previous iovec if contiguous, as consecutive scratch text is.
+            if (m_iovCount && static_cast<char *>(m_iov[m_iovCount - 1].iov_base) + m_iov[m_iovCount - 1].iov_len == s)
+            {
+                m_iov[m_iovCount - 1].iov_len += length;
+                return;
+            }
+            if (m_iovCount == max_iov)
+            {
+                flush();
+            }
+            m_iov[m_iovCount].iov_base = const_cast<char *>(s);
+            m_iov[m_iovCount].iov_len = length;
+            m_iovCount++;
+        }
+
+        int m_fd;
+        iovec m_iov[max_iov];
+        std::size_t m_iovCount;
+        char m_scratch[64 * 1024];
+        std::size_t m_scratchUsed;
+    };
+
+    void format(writer & w, const record & r)
+    {
+        static const char * const level_names[] = { " DEBUG ", " INFO  ", " WARN  ", " ERROR " };
+
+        char buffer[64];
+        auto when = m_systemStart + std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(m_scale.to_ns(r.stamp)));
+        auto seconds = std::chrono::system_clock::to_time_t(when);
+        auto micros = std::chrono::duration_cast<std::chrono::microseconds>(when.time_since_epoch()).count() % 1000000;
+        std::tm tm;
+        gmtime_r(&seconds, &tm);
+        auto length = std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm);
+        length += std::snprintf(buffer + length, sizeof(buffer) - length, ".%06lld", static_cast<long long>(micros));
+        w.text(buffer, length);
+        w.literal(level_names[r.lvl & 3], 7);
+
+        auto pFmt = r.fmt;
+        unsigned int arg = 0;
+        for (;;)
+        {
+            auto pBrace = std::strstr(pFmt, "{}");
+            if (!pBrace || arg == r.argc)
+            {
+                w.literal(pFmt, std::strlen(pFmt));
+                break;
+            }
+            w.literal(pFmt, pBrace - pFmt);
+            format_arg(w, r, arg++);
+            pFmt = pBrace + 2;
+        }
+        w.literal("\n", 1);
+    }
+
+    static void format_arg(writer & w, const record & r, unsigned int i)
+    {
+        char buffer[32];
+        int length = 0;
+        switch (r.types[i])
+        {
+        case t_int: length = std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(r.args[i].i)); break;
+        case t_uint: length = std::snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(r.args[i].u)); break;
+        case t_double: length = std::snprintf(buffer, sizeof(buffer), "%g", r.args[i].d); break;
+        case t_bool: length = std::snprintf(buffer, sizeof(buffer), "%s", r.args[i].u ? "true" : "false"); break;
+        case t_char: buffer[0] = static_cast<char>(r.args[i].u); length = 1; break;
+        case t_ptr: length = std::snprintf(buffer, sizeof(buffer), "%p", r.args[i].p); break;
+        case t_str:
+            // the string stays in the ring until the batch is written.
+            w.literal(r.text + r.args[i].u, std::strlen(r.text + r.args[i].u));
+            return;
+        }
+        w.text(buffer, static_cast<std::size_t>(length));
+    }
+
+    const int m_fd;
+    const unsigned int m_ringCapacity;
+    const level m_minLevel;
+    const std::chrono::microseconds m_flushInterval;
+    const std::uint64_t m_id;
+
+    spin_lock m_ringsLock;
+    std::vector<std::shared_ptr<ring>> m_rings;
+
+    std::atomic<std::uint64_t> m_dropped;
+    std::atomic<std::uint64_t> m_flushRequest;
+    std::atomic<std::uint64_t> m_flushed;
+    std::atomic<bool> m_stop;
+
+    // Background thread only, after construction.
+    timestamp_scale m_scale;
+    const std::chrono::system_clock::time_point m_systemStart;
+    std::thread m_thread;
+};
+
+}
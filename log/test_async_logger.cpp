@@ -0,0 +1,220 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -O2 -pthread test_async_logger.cpp
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "async_logger.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <future>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <stdexcept>
+#include <cstdlib>
+#include <fcntl.h>
+
+using std::cout;
+using std::vector;
+using std::string;
+using std::logic_error;
+using std::flush;
+using std::future;
+namespace chrono = std::chrono;
+
+using lockfree::async_logger;
+
+// A temporary file, removed on destruction.
+class temp_file
+{
+public:
+    temp_file()
+    {
+        char name[] = "/tmp/lockfree_log_XXXXXX";
+        m_fd = mkstemp(name);
+        m_name = name;
+    }
+
+    ~temp_file()
+    {
+        close(m_fd);
+        unlink(m_name.c_str());
+    }
+
+    int fd() const { return m_fd; }
+
+    vector<string> lines() const
+    {
+        std::ifstream in(m_name);
+        vector<string> result;
+        string line;
+        while (std::getline(in, line))
+        {
+            result.push_back(line);
+        }
+        return result;
+    }
+
+private:
+    int m_fd;
+    string m_name;
+};
+
+bool testcase_sanity()
+{
+    bool bResult = false;
+    try
+    {
+        temp_file file;
+        {
+            async_logger logger(file.fd(), 64, async_logger::level::info);
+            string name("queue");
+            logger.info("{} refilled {} nodes, ratio {} ok {} flag {}", name, 42u, 0.5, true, 'x');
+            logger.log(async_logger::level::debug, "filtered out {}", 1);
+            logger.error("no args");
+            logger.warning("fewer {} args than {}", -7);
+            logger.flush();
+
+            auto lines = file.lines();
+            if (lines.size() != 3) throw logic_error("expected 3 lines.");
+            if (lines[0].find(" INFO  queue refilled 42 nodes, ratio 0.5 ok true flag x") == string::npos) throw logic_error("bad format: " + lines[0]);
+            if (lines[1].find(" ERROR no args") == string::npos) throw logic_error("bad format: " + lines[1]);
+            if (lines[2].find(" WARN  fewer -7 args than {}") == string::npos) throw logic_error("bad format: " + lines[2]);
+
+            // a long string is truncated, not overflowed.
+            logger.info("{}", string(500, 'a'));
+        }
+        auto lines = file.lines();
+        if (lines.size() != 4 || lines[3].size() > 100) throw logic_error("long string not truncated.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - single threaded log, format, flush." << std::flush;
+    return bResult;
+}
+
+// Records of each thread are written in order, and none are lost, or they are counted as dropped.
+bool testcase_parallelism()
+{
+    static const int threads = 4;
+    static const int records = 5000;
+
+    temp_file file;
+    std::uint64_t dropped = 0;
+    {
+        async_logger logger(file.fd(), 8192);
+        vector<future<void>> vf;
+        for (int t = 0; t < threads; ++t)
+        {
+            vf.emplace_back(async(std::launch::async, [&logger, t]() {
+                for (int i = 0; i < records; ++i)
+                {
+                    logger.info("thread {} record {}", t, i);
+                }
+            }));
+        }
+        for (auto & task : vf)
+        {
+            task.wait();
+        }
+        logger.flush();
+        dropped = logger.dropped();
+    }
+
+    auto lines = file.lines();
+    bool failed = (lines.size() + dropped != threads * records);
+    vector<int> last(threads, -1);
+    for (auto & line : lines)
+    {
+        int t = 0;
+        int i = 0;
+        if (std::sscanf(line.c_str() + line.find("thread"), "thread %d record %d", &t, &i) != 2 || t < 0 || t >= threads || i <= last[t])
+        {
+#ifdef PRINT_TRACE
+            std::cerr << "\n out of order: " << line;
+#endif
+            failed = true;
+            break;
+        }
+        last[t] = i;
+    }
+
+#ifdef PRINT_TRACE
+    if (failed) std::cerr << "\n lines " << lines.size() << " dropped " << dropped;
+#endif
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : parallelism test - concurrent loggers, per thread order." << std::flush;
+    return !failed;
+}
+
+// A full ring drops and counts, never blocks.
+bool testcase_drop()
+{
+    temp_file file;
+    async_logger logger(file.fd(), 4, async_logger::level::debug, chrono::microseconds(1000000));
+
+    int logged = 0;
+    for (int i = 0; i < 20; ++i)
+    {
+        logged += logger.info("record {}", i) ? 1 : 0;
+    }
+    logger.flush();
+
+    bool failed = (logger.dropped() == 0) || (logged + logger.dropped() != 20) || (file.lines().size() != static_cast<size_t>(logged));
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : drop test - full ring drops and counts." << std::flush;
+    return !failed;
+}
+
+// Cost of a log call on the calling thread.
+bool testcase_hot_path()
+{
+    static const int records = 200000;
+
+    int fd = open("/dev/null", O_WRONLY);
+    double ns = 0;
+    std::uint64_t dropped = 0;
+    {
+        async_logger logger(fd, 1 << 18);
+        logger.info("warm up {}", 0);
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < records; ++i)
+        {
+            logger.info("record {} value {}", i, 3.25);
+        }
+        auto stop = chrono::steady_clock::now();
+        ns = static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(stop - start).count()) / records;
+        dropped = logger.dropped();
+    }
+    close(fd);
+
+    cout << "\n success";
+    cout << " : hot path test - " << ns << " ns per log call, " << dropped << " dropped." << std::flush;
+    return true;
+}
+
+#define RUN_TEST(testcase) { if (!testcase()) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity);
+    RUN_TEST(testcase_parallelism);
+    RUN_TEST(testcase_drop);
+    RUN_TEST(testcase_hot_path);
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
@@ -0,0 +1,172 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "../util/cache_line.h"
+#include "../backoff/backoff.h"
+
+#include <atomic>
+
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_release;
+using std::memory_order_acq_rel;
+
+// CLH queue based spinlock implementation using C++11.
+// Note: Each waiter spins on its predecessor's node, which no other waiter reads.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+The interface adheres to the C++11 BasicLockable requirements, so std::lock_guard and std::unique_lock can wrap it.
+Handoff is FIFO fair.
+clh_lock is basic_clh_lock with the default no_backoff policy from backoff.h.
+Compared to mcs_lock, unlock() never waits for a successor to link, since waiters form an implicit list.
+But the node spun on was written by the predecessor's thread, so on NUMA machines
+the spin may be on a remote cache line. Prefer mcs_lock there.
+
+Design:
+The lock holds the tail of an implicit queue of nodes. Initially the tail is a dummy unlocked node.
+lock():
+    1. set own node's locked flag and swap tail with own node.
+    2. spin on the previous tail's locked flag.
+unlock():
+    1. clear own node's locked flag. This hands off to the successor, if any.
+    2. take ownership of the predecessor's node. Nobody else references it any more.
+So nodes migrate between threads. The node left at the tail is owned by the lock and freed with it.
+
+BasicLockable has no argument to pass a node from lock() to unlock().
+So nodes come from a per-thread cache, and the lock holder stores its node and predecessor in the lock.
+*/
+
+namespace lockfree
+{
+
+template<typename backoff = no_backoff>
+class basic_clh_lock
+{
+public:
+    basic_clh_lock() : m_tail{ new node }, m_holder{ nullptr }, m_predecessor{ nullptr }
+    {
+        m_tail.load(memory_order_relaxed)->locked.store(false, memory_order_relaxed);
+    }
+
+    ~basic_clh_lock()
+    {
+        delete m_tail.load(memory_order_relaxed);
+    }
+
+    basic_clh_lock(const basic_clh_lock &) = delete;
+    basic_clh_lock & operator=(const basic_clh_lock &) = delete;
+
+    void lock()
+    {
+        auto pNode = node_cache::get();
+        pNode->locked.store(true, memory_order_relaxed);
+
+        // memory_order_acq_rel due to
+        //      release: locked flag write above must be visible to the successor spinning on it.
+        //      acquire: predecessor node read after this must 'happen after' this.
+        auto pPredecessor = m_tail.exchange(pNode, memory_order_acq_rel);
+
+        // memory_order_acquire due to all PD reads issued after this read must 'happen after' this read.
+        // PD is data structure protected by using this clh_lock.
+        backoff wait_predecessor;
+        while (pPredecessor->locked.load(memory_order_acquire))
+        {
+            wait_predecessor();
+        }
+
+        // Only the lock holder reads or writes these.
+        m_holder = pNode;
+        m_predecessor = pPredecessor;
+    }
+
+    void unlock()
+    {
+        auto pNode = m_holder;
+        auto pPredecessor = m_predecessor;
+
+        // memory_order_release due to all PD writes issued before this write must 'happen before' this write.
+        // After this write the successor may be the lock holder, so m_holder must not be touched.
+        pNode->locked.store(false, memory_order_release);
+
+        node_cache::put(pPredecessor);
+    }
+
+private:
+    struct alignas(cache_line_size) node: public cache_aligned
+    {
+        std::atomic<bool> locked;
+
+        // link in the per-thread node cache.
+        node * pCacheNext;
+    };
+
+    //
+    // Per-thread cache of free nodes.
+    // Nodes are freed when the thread exits.
+    //
+    class node_cache
+    {
+    public:
+        static node * get()
+        {
+            auto & c = instance();
+            auto pNode = c.m_pTop;
+            if (pNode)
+            {
+                c.m_pTop = pNode->pCacheNext;
+            }
+            else
+            {
+                pNode = new node;
+            }
+            return pNode;
+        }
+
+        static void put(node * pNode)
+        {
+            auto & c = instance();
+            pNode->pCacheNext = c.m_pTop;
+            c.m_pTop = pNode;
+        }
+
+        ~node_cache()
+        {
+            while (m_pTop)
+            {
+                auto pNext = m_pTop->pCacheNext;
+                delete m_pTop;
+                m_pTop = pNext;
+            }
+        }
+
+    private:
+        node_cache() : m_pTop(nullptr)
+        {
+        }
+
+        static node_cache & instance()
+        {
+            static thread_local node_cache c;
+            return c;
+        }
+
+        node * m_pTop;
+    };
+
+    std::atomic<node *> m_tail;
+    node * m_holder;
+    node * m_predecessor;
+};
+
+using clh_lock = basic_clh_lock<>;
+
+}
@@ -0,0 +1,187 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "../util/cache_line.h"
+#include "../topology/topology.h"
+#include "../backoff/backoff.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_release;
+
+// NUMA aware cohort lock implementation using C++11.
+// Note: The lock is passed between threads of the same NUMA node before it goes to another node.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+The interface adheres to the C++11 BasicLockable requirements, so std::lock_guard and std::unique_lock can wrap it.
+cohort_lock is basic_cohort_lock with the default no_backoff policy from backoff.h.
+Threads of a NUMA node form a cohort. While the lock stays within a cohort,
+the lock words and the data protected by the lock stay in the caches of that node.
+
+Design:
+There is one global ticket lock, and one local ticket lock per NUMA node.
+Each local lock sits on its own cache line.
+lock():
+    1. acquire the local lock of the current node.
+    2. if the previous local holder passed the global lock within the cohort, done.
+        Else acquire the global lock.
+unlock():
+    1. if there are local waiters, and the cohort has not used up its handoff limit,
+        pass the global lock within the cohort by leaving it acquired.
+        Else release the global lock.
+    2. release the local lock.
+The handoff limit bounds how long the other nodes can be starved.
+
+The global lock is released by whichever thread of the cohort holds the lock last,
+which need not be the thread that acquired it. Ticket locks allow that; mcs_lock does not.
+
+The node is looked up from the cpu the thread runs on at lock(). A thread that migrates
+to another node while waiting just joins the cohort of the node it started in.
+*/
+
+namespace lockfree
+{
+
+template<typename backoff = no_backoff>
+class basic_cohort_lock
+{
+public:
+    explicit basic_cohort_lock(unsigned int handoff_limit = 64, const cpu_topology & topology = cpu_topology::system()) :
+        m_topology(topology),
+        m_nodeCount(topology.node_count() ? topology.node_count() : 1),
+        m_handoffLimit(handoff_limit),
+        m_holderNode(0)
+    {
+        for (unsigned int node = 0; node < m_nodeCount; ++node)
+        {
+            m_local.emplace_back(new local_lock);
+        }
+    }
+
+    basic_cohort_lock(const basic_cohort_lock &) = delete;
+    basic_cohort_lock & operator=(const basic_cohort_lock &) = delete;
+
+    void lock()
+    {
+        auto node = m_topology.current_node();
+        node = (node < m_nodeCount) ? node : 0;
+        auto & local = *m_local[node];
+
+        local.lock();
+
+        // globalOwned is only accessed under the local lock.
+        if (!local.globalOwned)
+        {
+            m_global.lock();
+        }
+
+        // Only the lock holder reads or writes m_holderNode.
+        m_holderNode = node;
+    }
+
+    void unlock()
+    {
+        auto & local = *m_local[m_holderNode];
+
+        if (local.has_waiters() && (local.handoffs < m_handoffLimit))
+        {
+            // Keep the global lock for the next thread of the cohort.
+            local.handoffs++;
+            local.globalOwned = true;
+        }
+        else
+        {
+            local.handoffs = 0;
+            local.globalOwned = false;
+            m_global.unlock();
+        }
+
+        local.unlock();
+    }
+
+    unsigned int node_count() const
+    {
+        return m_nodeCount;
+    }
+
+private:
+    //
+    // A ticket lock that can tell if there are waiters.
+    // It can also be unlocked by a thread different from the one that locked it.
+    //
+    class ticket_lock
+    {
+    public:
+        ticket_lock() : m_next{ 0 }, m_serving{ 0 }
+        {
+        }
+
+        void lock()
+        {
+            auto ticket = m_next.fetch_add(1, memory_order_relaxed);
+
+            // memory_order_acquire due to all PD reads issued after this read must 'happen after' this read.
+            // PD is data structure protected by using this lock.
+            backoff wait_turn;
+            while (m_serving.load(memory_order_acquire) != ticket)
+            {
+                wait_turn();
+            }
+        }
+
+        void unlock()
+        {
+            // Only the lock holder writes m_serving.
+            auto serving = m_serving.load(memory_order_relaxed);
+
+            // memory_order_release due to all PD writes issued before this write must 'happen before' this write.
+            m_serving.store(serving + 1, memory_order_release);
+        }
+
+        // Call only while holding the lock.
+        bool has_waiters() const
+        {
+            return m_next.load(memory_order_relaxed) != (m_serving.load(memory_order_relaxed) + 1);
+        }
+
+    private:
+        std::atomic<unsigned int> m_next;
+        std::atomic<unsigned int> m_serving;
+    };
+
+    struct alignas(cache_line_size) local_lock : public ticket_lock, public cache_aligned
+    {
+        local_lock() : globalOwned(false), handoffs(0)
+        {
+        }
+
+        bool globalOwned;
+        unsigned int handoffs;
+    };
+
+    const cpu_topology & m_topology;
+    const unsigned int m_nodeCount;
+    // Allocated one by one, so that each gets the cache_aligned operator new.
+    std::vector<std::unique_ptr<local_lock>> m_local;
+    const unsigned int m_handoffLimit;
+
+    alignas(cache_line_size) ticket_lock m_global;
+    unsigned int m_holderNode;
+};
+
+using cohort_lock = basic_cohort_lock<>;
+
+}
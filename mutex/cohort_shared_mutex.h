@@ -0,0 +1,79 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "shared_mutex.h"
+#include "cohort_lock.h"
+
+// NUMA aware shared_mutex implementation using C++11.
+// Note: Writers are cohorted by NUMA node as in cohort_lock. Readers are as in shared_mutex.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+The interface adheres to the C++17 shared_mutex interface.
+cohort_shared_mutex is basic_cohort_shared_mutex with the default no_backoff policy from backoff.h.
+The policy is passed on to both the writer cohort_lock and the shared_mutex.
+
+Design:
+Writers first acquire a cohort_lock, and only then enter exclusive access of the shared_mutex.
+So at most one writer at a time competes with readers for the shared_mutex counter,
+and successive writers come from the same NUMA node until the cohort handoff limit.
+Readers go straight to the shared_mutex, so shared access is unchanged.
+*/
+
+namespace lockfree
+{
+
+template<typename backoff = no_backoff>
+class basic_cohort_shared_mutex
+{
+public:
+    explicit basic_cohort_shared_mutex(unsigned int handoff_limit = 64, const cpu_topology & topology = cpu_topology::system()) :
+        m_writers(handoff_limit, topology)
+    {
+    }
+
+    basic_cohort_shared_mutex(const basic_cohort_shared_mutex &) = delete;
+    basic_cohort_shared_mutex & operator=(const basic_cohort_shared_mutex &) = delete;
+
+    // to enter exclusive access.
+    void lock()
+    {
+        m_writers.lock();
+        m_sm.lock();
+    }
+
+    // to enter shared access.
+    void lock_shared()
+    {
+        m_sm.lock_shared();
+    }
+
+    // to exit exclusive access.
+    void unlock()
+    {
+        m_sm.unlock();
+        m_writers.unlock();
+    }
+
+    // to exit shared access.
+    void unlock_shared()
+    {
+        m_sm.unlock_shared();
+    }
+
+private:
+    basic_cohort_lock<backoff> m_writers;
+    basic_shared_mutex<backoff> m_sm;
+};
+
+using cohort_shared_mutex = basic_cohort_shared_mutex<>;
+
+}
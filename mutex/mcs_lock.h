@@ -0,0 +1,190 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "../util/cache_line.h"
+#include "../backoff/backoff.h"
+
+#include <atomic>
+
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_release;
+using std::memory_order_acq_rel;
+
+// MCS queue based spinlock implementation using C++11.
+// Note: Each waiter spins on its own cache line, so waiting causes no cache line bouncing.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+The interface adheres to the C++11 BasicLockable requirements, so std::lock_guard and std::unique_lock can wrap it.
+Handoff is FIFO fair.
+mcs_lock is basic_mcs_lock with the default no_backoff policy from backoff.h.
+
+Design:
+Waiters form a singly linked queue of nodes. The lock only holds the tail of the queue.
+lock():
+    1. swap tail with own node.
+    2. if there was a previous tail, link own node after it and spin on own node's locked flag.
+unlock():
+    1. if there is no successor linked, try to swap tail back to nullptr.
+        If that fails a successor is in the middle of linking, so wait for the link.
+    2. clear successor's locked flag.
+Only the successor writes to a node's locked flag, so each waiter only reads its own cache line while spinning.
+
+BasicLockable has no argument to pass a node from lock() to unlock().
+So nodes come from a per-thread cache, and the lock holder stores its node in the lock.
+A node is back in the cache as soon as unlock() returns, so a thread needs as many nodes
+as the number of mcs_locks it holds at the same time.
+*/
+
+namespace lockfree
+{
+
+template<typename backoff = no_backoff>
+class basic_mcs_lock
+{
+public:
+    basic_mcs_lock() : m_tail{ nullptr }, m_holder{ nullptr }
+    {
+    }
+
+    basic_mcs_lock(const basic_mcs_lock &) = delete;
+    basic_mcs_lock & operator=(const basic_mcs_lock &) = delete;
+
+    void lock()
+    {
+        auto pNode = node_cache::get();
+        pNode->next.store(nullptr, memory_order_relaxed);
+        pNode->locked.store(true, memory_order_relaxed);
+
+        // memory_order_acq_rel due to
+        //      release: node initialization above must be visible to the predecessor linking to it.
+        //      acquire: predecessor node fields read after this must 'happen after' this.
+        auto pPredecessor = m_tail.exchange(pNode, memory_order_acq_rel);
+        if (pPredecessor)
+        {
+            // memory_order_release due to locked flag write above must be visible before the predecessor hands off.
+            pPredecessor->next.store(pNode, memory_order_release);
+
+            // memory_order_acquire due to all PD reads issued after this read must 'happen after' this read.
+            // PD is data structure protected by using this mcs_lock.
+            backoff wait_predecessor;
+            while (pNode->locked.load(memory_order_acquire))
+            {
+                wait_predecessor();
+            }
+        }
+
+        // Only the lock holder reads or writes m_holder.
+        m_holder = pNode;
+    }
+
+    void unlock()
+    {
+        auto pNode = m_holder;
+
+        // memory_order_acquire due to following dereferencing of successor.
+        auto pSuccessor = pNode->next.load(memory_order_acquire);
+        if (!pSuccessor)
+        {
+            auto expected = pNode;
+            // memory_order_release on success due to all PD writes issued before this must 'happen before' the next lock().
+            if (m_tail.compare_exchange_strong(expected, nullptr, memory_order_release, memory_order_relaxed))
+            {
+                node_cache::put(pNode);
+                return;
+            }
+
+            // A successor has swapped the tail but is yet to link to this node.
+            backoff wait_successor;
+            while (!(pSuccessor = pNode->next.load(memory_order_acquire)))
+            {
+                wait_successor();
+            }
+        }
+
+        // memory_order_release due to all PD writes issued before this write must 'happen before' this write.
+        pSuccessor->locked.store(false, memory_order_release);
+
+        // Successor has already linked and will not touch this node again.
+        node_cache::put(pNode);
+    }
+
+private:
+    struct alignas(cache_line_size) node: public cache_aligned
+    {
+        std::atomic<node *> next;
+        std::atomic<bool> locked;
+
+        // link in the per-thread node cache.
+        node * pCacheNext;
+    };
+
+    //
+    // Per-thread cache of free nodes.
+    // Nodes are freed when the thread exits.
+    //
+    class node_cache
+    {
+    public:
+        static node * get()
+        {
+            auto & c = instance();
+            auto pNode = c.m_pTop;
+            if (pNode)
+            {
+                c.m_pTop = pNode->pCacheNext;
+            }
+            else
+            {
+                pNode = new node;
+            }
+            return pNode;
+        }
+
+        static void put(node * pNode)
+        {
+            auto & c = instance();
+            pNode->pCacheNext = c.m_pTop;
+            c.m_pTop = pNode;
+        }
+
+        ~node_cache()
+        {
+            while (m_pTop)
+            {
+                auto pNext = m_pTop->pCacheNext;
+                delete m_pTop;
+                m_pTop = pNext;
+            }
+        }
+
+    private:
+        node_cache() : m_pTop(nullptr)
+        {
+        }
+
+        static node_cache & instance()
+        {
+            static thread_local node_cache c;
+            return c;
+        }
+
+        node * m_pTop;
+    };
+
+    std::atomic<node *> m_tail;
+    node * m_holder;
+};
+
+using mcs_lock = basic_mcs_lock<>;
+
+}
@@ -10,6 +10,9 @@
 #include <atomic>
 #include <stdexcept>
 
+#include "../backoff/backoff.h"
+#include "../trace/trace_point.h"
+
 using std::cerr;
 using std::memory_order_relaxed;
 using std::memory_order_acquire;
@@ -27,6 +30,9 @@ using std::atomic;
 Notes:
 This implementation uses lock free atomic operations compare and swap, swap, load, store.
 The interface adheres to the C++17 shared_mutex interface.
+The backoff policy from backoff.h is applied in every spin and compare and swap retry loop.
+shared_mutex is basic_shared_mutex with the default no_backoff policy.
+Compare and swap retries and waits for readers are trace points of trace_point.h, off unless LOCKFREE_TRACE is defined.
 */
 
 /*
@@ -48,10 +54,11 @@ After exclusive access counter is set to 0.
 namespace lockfree
 {
 
-class shared_mutex
+template<typename backoff = no_backoff>
+class basic_shared_mutex
 {
 public:
-    shared_mutex() : m_counter{ 0 }
+    basic_shared_mutex() : m_counter{ 0 }
     {
         if (!m_counter.is_lock_free())
         {
@@ -66,9 +73,12 @@ public:
         // swap counter with -1, if not already negative.
         //
         int current_ctr = 0;
+        backoff wait_writer;
         while (!m_counter.compare_exchange_weak(current_ctr, -1, memory_order_relaxed, memory_order_relaxed))
         {
             current_ctr = (current_ctr < 0) ? 0 : current_ctr;
+            LOCKFREE_TRACE_EVENT(shared_mutex_cas_retry, current_ctr);
+            wait_writer();
         }
 
         //
@@ -80,12 +90,15 @@ public:
         //    I believe since any PD write is going to be 'dependent' on a PD read before it,
         //    the correct memory order will naturally happen.
         int ctr = 0;
+        backoff wait_readers;
         while ((ctr = m_counter.load(memory_order_acquire)) != (-current_ctr - 1))
         {
             if (ctr < (-current_ctr - 1))
             {
                 throw std::logic_error("counter has gone below expected.");
             }
+            LOCKFREE_TRACE_EVENT(shared_mutex_wait_readers, ctr);
+            wait_readers();
         }
     }
 
@@ -96,11 +109,14 @@ public:
         // increment counter, if not already negative.
         //
         int current_ctr = 0;
+        backoff wait_writer;
         // memory_order_acquire on success due to all PD reads issued after this read must 'happen after' this read.
         // PD is data structure protected by using this shared_mutex.
         while (!m_counter.compare_exchange_weak(current_ctr, current_ctr + 1, memory_order_acquire, memory_order_relaxed))
         {
             current_ctr = (current_ctr < 0) ? 0 : current_ctr;
+            LOCKFREE_TRACE_EVENT(shared_mutex_cas_retry, current_ctr);
+            wait_writer();
         }
     }
 
@@ -119,13 +135,20 @@ public:
         // decrement shared counter.
         //
         int current_ctr = m_counter.load(memory_order_relaxed);
+        backoff wait_retry;
         // Since there is no PD write issued before this write, memory_order_release is not needed here.
-        while (!m_counter.compare_exchange_weak(current_ctr, current_ctr - 1, memory_order_relaxed, memory_order_relaxed));
+        while (!m_counter.compare_exchange_weak(current_ctr, current_ctr - 1, memory_order_relaxed, memory_order_relaxed))
+        {
+            LOCKFREE_TRACE_EVENT(shared_mutex_cas_retry, current_ctr);
+            wait_retry();
+        }
     }
 
 private:
     atomic<int> m_counter;
 };
 
+using shared_mutex = basic_shared_mutex<>;
+
 
 }
@@ -10,6 +10,8 @@
 #include <atomic>
 #include <stdexcept>
 
+#include "../backoff/backoff.h"
+
 using std::cerr;
 using std::memory_order_relaxed;
 using std::memory_order_acquire;
@@ -27,6 +29,8 @@ using std::atomic;
 Notes:
 This implementation uses lock free atomic operations compare and swap, swap, load, store.
 The interface adheres to the C++17 shared_mutex interface.
+The backoff policy from backoff.h is applied in every spin and compare and swap retry loop.
+shared_mutex is basic_shared_mutex with the default no_backoff policy.
 */
 
 /*
@@ -52,10 +56,11 @@ to happen simultaneously. A remedy is provided for this situation.
 namespace lockfree
 {
 
-class shared_mutex
+template<typename backoff = no_backoff>
+class basic_shared_mutex
 {
 public:
-    shared_mutex() : m_shared_counter{ 0 }, m_exclusive_access{ false }
+    basic_shared_mutex() : m_shared_counter{ 0 }, m_exclusive_access{ false }
     {
         if (!m_shared_counter.is_lock_free())
         {
@@ -71,16 +76,19 @@ public:
         // Then claim exclusive access which prevents any new shared or exclusive access.
         //
         bool expected = false;
+        backoff wait_writer;
         // memory_order_acquire on success due to m_shared_counter read issued after this read must 'happen after' this read
-        while (!m_exclusive_access.compare_exchange_weak(expected, true, memory_order_acquire, memory_order_relaxed));
+        while (!m_exclusive_access.compare_exchange_weak(expected, true, memory_order_acquire, memory_order_relaxed))
         {
             expected = false;
+            wait_writer();
         }
 
         //
         // Wait for all current shared accesses to exit.
         //
         int ctr = -1;
+        backoff wait_readers;
         // memory_order_acquire due to all PD reads issued after this read must 'happen after' this read
         // PD is data sturcture protected by using this shared_mutex.
         // Q. How do I make sure any PD write issued after this read 'happens after' this read?
@@ -92,6 +100,7 @@ public:
             {
                 throw std::logic_error("shared access counter has gone below zero.");
             }
+            wait_readers();
         }
     }
 
@@ -102,9 +111,13 @@ public:
         // increment shared counter
         //
         int current_ctr = m_shared_counter.load(memory_order_relaxed);
+        backoff wait_retry;
         // memory_order_acquire on success due to m_exclusive_access read issued after this read must 'happen after' this read.
         // The m_exclusive_access read will also 'happen after' this write because this read-write is atomic.
-        while (!m_shared_counter.compare_exchange_weak(current_ctr, current_ctr + 1, memory_order_acquire, memory_order_relaxed));
+        while (!m_shared_counter.compare_exchange_weak(current_ctr, current_ctr + 1, memory_order_acquire, memory_order_relaxed))
+        {
+            wait_retry();
+        }
 
         // memory_order_acquire due to all PD reads issued after this read must 'happen after' this read.
         // PD is data structure protected by using this shared_mutex.
@@ -117,11 +130,18 @@ public:
             current_ctr++;
             // This m_shared_counter read 'happens after' previous m_exclusive_access read due to its memory_order_acquire.
             // However memory_order_acquire is needed here for properly ordering the following m_exclusive_access read.
-            while (!m_shared_counter.compare_exchange_weak(current_ctr, current_ctr - 1, memory_order_acquire, memory_order_relaxed));
+            while (!m_shared_counter.compare_exchange_weak(current_ctr, current_ctr - 1, memory_order_acquire, memory_order_relaxed))
+            {
+                wait_retry();
+            }
 
             // This m_exclusive_access read must happen after previous m_shared_counter read due to its memory_order_acquire.
             // However memory_order_acquire is needed here for properly ordering the following m_shared_counter read that happens due to recursive call.
-            while (m_exclusive_access.load(memory_order_acquire));
+            backoff wait_writer;
+            while (m_exclusive_access.load(memory_order_acquire))
+            {
+                wait_writer();
+            }
 
             // repeat attempt to shared lock.
             lock_shared();
@@ -146,7 +166,11 @@ public:
         // Since there is no PD write issued before this write, memory_order_release is not needed here.
         // However memory_order_acquire may be needed on success to ensure a read of m_exclusive_access issued after this read 'happens after' this read.
         // This could happen for example if this thread calls lock() after exiting this function.
-        while (!m_shared_counter.compare_exchange_weak(current_ctr, current_ctr - 1, memory_order_acquire, memory_order_relaxed));
+        backoff wait_retry;
+        while (!m_shared_counter.compare_exchange_weak(current_ctr, current_ctr - 1, memory_order_acquire, memory_order_relaxed))
+        {
+            wait_retry();
+        }
     }
 
 private:
@@ -154,5 +178,7 @@ private:
     atomic<bool> m_exclusive_access;
 };
 
+using shared_mutex = basic_shared_mutex<>;
+
 
 }
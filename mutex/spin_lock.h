@@ -0,0 +1,76 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+
+#include "../backoff/backoff.h"
+
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_release;
+
+// Test and set spinlock implementation using C++11.
+// Note: This is the lock previously embedded in lockfree::queue for its refill path.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+All waiters spin on the same atomic_flag, so the cache line bounces between all waiters.
+Handoff is unfair; whichever waiter wins the test_and_set gets the lock.
+This is the best choice when contention is rare and hold time is very short.
+Under contention prefer mcs_lock or clh_lock, where each waiter spins on its own node.
+
+The interface adheres to the C++11 Lockable requirements, so std::lock_guard and std::unique_lock can wrap it.
+spin_lock is basic_spin_lock with the default no_backoff policy from backoff.h.
+*/
+
+namespace lockfree
+{
+
+template<typename backoff = no_backoff>
+class basic_spin_lock
+{
+public:
+    basic_spin_lock()
+    {
+    }
+
+    basic_spin_lock(const basic_spin_lock &) = delete;
+    basic_spin_lock & operator=(const basic_spin_lock &) = delete;
+
+    void lock()
+    {
+        backoff wait_holder;
+        // memory_order_acquire due to all PD reads issued after this must 'happen after' this.
+        // PD is data structure protected by using this spin_lock.
+        while (m_flag.test_and_set(memory_order_acquire))
+        {
+            wait_holder();
+        }
+    }
+
+    bool try_lock()
+    {
+        return !m_flag.test_and_set(memory_order_acquire);
+    }
+
+    void unlock()
+    {
+        // memory_order_release due to all PD writes issued before this must 'happen before' this.
+        m_flag.clear(memory_order_release);
+    }
+
+private:
+    std::atomic_flag m_flag = ATOMIC_FLAG_INIT;
+};
+
+using spin_lock = basic_spin_lock<>;
+
+}
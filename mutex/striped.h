@@ -0,0 +1,218 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "shared_mutex.h"
+#include "../util/cache_line.h"
+
+#include <cstddef>
+#include <functional>
+#include <utility>
+
+// Striped lock adapter that makes a single thread use only container multi-thread safe.
+// Note: This scales out the single shared_mutex approach shown in test_shared_mutex.cpp.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+The container is sharded into N stripes by the hash of the key.
+Each stripe is a separate container protected by its own shared_mutex.
+Each stripe is padded to a cache line, so that the lock word of one stripe
+does not share a cache line with the lock word of another stripe.
+
+Access is through a lambda that receives the stripe container for the key.
+    read(key, fn)  : fn(const Container &) is called under shared access of the stripe.
+    write(key, fn) : fn(Container &) is called under exclusive access of the stripe.
+The lambda must only access the element of that key, since the other keys
+in the same stripe container are incidental to the hashing.
+
+Whole container operations lock all stripes, always in increasing stripe order.
+The fixed order makes sure two whole container operations cannot deadlock.
+    read_all(fn)   : fn(const Container &) is called for each stripe under shared access of all stripes.
+    write_all(fn)  : fn(Container &) is called for each stripe under exclusive access of all stripes.
+*/
+
+namespace lockfree
+{
+
+template<
+    typename Container,
+    unsigned int N = 16,
+    typename Hash = std::hash<typename Container::key_type>,
+    typename shared_mutex_type = lockfree::shared_mutex
+>
+class striped
+{
+public:
+    using key_type = typename Container::key_type;
+    using size_type = typename Container::size_type;
+
+    static_assert(N > 0, "striped needs at least one stripe.");
+
+    striped(const Hash & hash = Hash()) : m_hash(hash)
+    {
+    }
+
+    striped(const striped &) = delete;
+    striped & operator=(const striped &) = delete;
+
+    template<typename Fn>
+    auto read(const key_type & key, Fn fn) -> decltype(fn(std::declval<const Container &>()))
+    {
+        auto & s = m_stripes[index(key)];
+        shared_guard sg(s.sm);
+        return fn(static_cast<const Container &>(s.container));
+    }
+
+    template<typename Fn>
+    auto write(const key_type & key, Fn fn) -> decltype(fn(std::declval<Container &>()))
+    {
+        auto & s = m_stripes[index(key)];
+        exclusive_guard eg(s.sm);
+        return fn(s.container);
+    }
+
+    template<typename Fn>
+    void read_all(Fn fn)
+    {
+        all_shared_guard asg(m_stripes);
+        for (auto & s : m_stripes)
+        {
+            fn(static_cast<const Container &>(s.container));
+        }
+    }
+
+    template<typename Fn>
+    void write_all(Fn fn)
+    {
+        all_exclusive_guard aeg(m_stripes);
+        for (auto & s : m_stripes)
+        {
+            fn(s.container);
+        }
+    }
+
+    // Consistent snapshot of the total size since all stripes are locked together.
+    size_type size()
+    {
+        size_type total = 0;
+        read_all([&total](const Container & c) { total += c.size(); });
+        return total;
+    }
+
+    void clear()
+    {
+        write_all([](Container & c) { c.clear(); });
+    }
+
+    static unsigned int stripe_count()
+    {
+        return N;
+    }
+
+private:
+    struct alignas(cache_line_size) stripe
+    {
+        shared_mutex_type sm;
+        Container container;
+    };
+
+    unsigned int index(const key_type & key) const
+    {
+        // std::hash is identity for integers on common implementations.
+        // Mix the bits, so that keys with a common stride don't all land in the same stripe.
+        auto h = static_cast<unsigned long long>(m_hash(key));
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return static_cast<unsigned int>(h % N);
+    }
+
+    //
+    // RAII helpers.
+    // std::shared_lock is only available from C++14, so these are used instead.
+    //
+    class shared_guard
+    {
+    public:
+        shared_guard(shared_mutex_type & sm) : m_sm(sm)
+        {
+            m_sm.lock_shared();
+        }
+        ~shared_guard()
+        {
+            m_sm.unlock_shared();
+        }
+    private:
+        shared_mutex_type & m_sm;
+    };
+
+    class exclusive_guard
+    {
+    public:
+        exclusive_guard(shared_mutex_type & sm) : m_sm(sm)
+        {
+            m_sm.lock();
+        }
+        ~exclusive_guard()
+        {
+            m_sm.unlock();
+        }
+    private:
+        shared_mutex_type & m_sm;
+    };
+
+    // Locks in increasing stripe order, unlocks in reverse order.
+    class all_shared_guard
+    {
+    public:
+        all_shared_guard(stripe (&stripes)[N]) : m_stripes(stripes)
+        {
+            for (unsigned int i = 0; i < N; ++i)
+            {
+                m_stripes[i].sm.lock_shared();
+            }
+        }
+        ~all_shared_guard()
+        {
+            for (unsigned int i = N; i > 0; --i)
+            {
+                m_stripes[i - 1].sm.unlock_shared();
+            }
+        }
+    private:
+        stripe (&m_stripes)[N];
+    };
+
+    class all_exclusive_guard
+    {
+    public:
+        all_exclusive_guard(stripe (&stripes)[N]) : m_stripes(stripes)
+        {
+            for (unsigned int i = 0; i < N; ++i)
+            {
+                m_stripes[i].sm.lock();
+            }
+        }
+        ~all_exclusive_guard()
+        {
+            for (unsigned int i = N; i > 0; --i)
+            {
+                m_stripes[i - 1].sm.unlock();
+            }
+        }
+    private:
+        stripe (&m_stripes)[N];
+    };
+
+    stripe m_stripes[N];
+    Hash m_hash;
+};
+
+}
@@ -0,0 +1,160 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread test_cohort_lock.cpp
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "cohort_lock.h"
+#include "cohort_shared_mutex.h"
+
+#include <mutex>
+#include <iostream>
+#include <future>
+#include <vector>
+#include <stdexcept>
+
+using std::cout;
+using std::vector;
+using std::logic_error;
+using std::flush;
+using std::future;
+using std::lock_guard;
+
+bool testcase_sanity()
+{
+    bool bResult = false;
+    try
+    {
+        lockfree::cohort_lock cl;
+        if (cl.node_count() != lockfree::cpu_topology::system().node_count())
+            throw logic_error("one local lock per node expected.");
+
+        cl.lock();
+        cl.unlock();
+        {
+            lock_guard<lockfree::cohort_lock> lg(cl);
+        }
+
+        lockfree::cohort_shared_mutex csm;
+        csm.lock_shared();
+        csm.lock_shared();
+        csm.unlock_shared();
+        csm.unlock_shared();
+        csm.lock();
+        csm.unlock();
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - single threaded locking." << std::flush;
+    return bResult;
+}
+
+// Readers run only for a lock type that has shared access.
+void read_loop(lockfree::cohort_lock &, std::atomic<int> &, int)
+{
+}
+
+void read_loop(lockfree::cohort_shared_mutex & l, std::atomic<int> & writers, int count)
+{
+    for (int c = 0; c < count; ++c)
+    {
+        l.lock_shared();
+        bool overlap = (writers.load() != 0);
+        l.unlock_shared();
+        if (overlap) throw logic_error("reader inside writer critical section.");
+    }
+}
+
+template<typename lock_type>
+bool testcase_mutual_exclusion(const char * name, unsigned int handoff_limit)
+{
+    lock_type l(handoff_limit);
+
+    static const int threads = 4;
+    static const int increments = 2000;
+
+    // Not atomic on purpose. Any overlap of critical sections is likely to lose an update.
+    volatile long long counter = 0;
+    std::atomic<int> writers{ 0 };
+
+    bool failed = false;
+
+    {
+        vector<future<void>> vf;
+
+        for (int t = 0; t < threads; ++t)
+        {
+            vf.emplace_back(async(std::launch::async, [&l, &counter, &writers]() {
+                for (int c = 0; c < increments; ++c)
+                {
+                    lock_guard<lock_type> lg(l);
+                    if (writers.fetch_add(1) != 0) throw logic_error("two writers inside critical section.");
+                    counter = counter + 1;
+                    writers.fetch_sub(1);
+                }
+            }));
+            vf.emplace_back(async(std::launch::async, [&l, &writers]() { read_loop(l, writers, increments); }));
+        }
+
+        try
+        {
+            for (auto & task : vf)
+            {
+                task.get();
+            }
+        }
+        catch (std::exception & e)
+        {
+            failed = true;
+#ifdef PRINT_TRACE
+            std::cerr << "\n" << e.what() << std::flush;
+#endif
+        }
+    }
+
+    if (counter != static_cast<long long>(threads) * increments)
+    {
+        failed = true;
+#ifdef PRINT_TRACE
+        std::cerr << "\n lost updates: " << counter << std::flush;
+#endif
+    }
+
+    if (failed)
+    {
+        cout << "\n FAIL";
+    }
+    else
+    {
+        cout << "\n success";
+    }
+    cout << " : parallelism test - mutual exclusion - " << name << " handoff limit " << handoff_limit << std::flush;
+
+    return (!failed);
+}
+
+#define RUN_TEST(testcase) { if (!testcase) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity());
+
+    // handoff limit 0 never passes within the cohort, so it also tests the global lock path.
+    RUN_TEST(testcase_mutual_exclusion<lockfree::cohort_lock>("cohort_lock", 0));
+    RUN_TEST(testcase_mutual_exclusion<lockfree::cohort_lock>("cohort_lock", 64));
+    RUN_TEST(testcase_mutual_exclusion<lockfree::cohort_shared_mutex>("cohort_shared_mutex", 0));
+    RUN_TEST(testcase_mutual_exclusion<lockfree::cohort_shared_mutex>("cohort_shared_mutex", 64));
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
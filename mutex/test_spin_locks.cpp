@@ -0,0 +1,147 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread test_spin_locks.cpp
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "spin_lock.h"
+#include "mcs_lock.h"
+#include "clh_lock.h"
+
+#include <mutex>
+#include <iostream>
+#include <future>
+#include <vector>
+#include <stdexcept>
+
+using std::cout;
+using std::vector;
+using std::logic_error;
+using std::flush;
+using std::future;
+using std::lock_guard;
+
+template<typename lock_type>
+bool testcase_sanity(const char * name)
+{
+    bool bResult = false;
+    try
+    {
+        lock_type l1;
+        lock_type l2;
+
+        l1.lock();
+        l1.unlock();
+
+        // nested locking of different locks needs more than one node per thread.
+        l1.lock();
+        l2.lock();
+        l2.unlock();
+        l1.unlock();
+
+        {
+            lock_guard<lock_type> lg(l2);
+        }
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - single threaded locking - " << name << std::flush;
+    return bResult;
+}
+
+template<typename lock_type>
+bool testcase_mutual_exclusion(const char * name)
+{
+    lock_type l;
+
+    static const int threads = 4;
+    static const int increments = 2000;
+
+    // Not atomic on purpose. Any overlap of critical sections is likely to lose an update.
+    volatile long long counter = 0;
+    volatile int inside = 0;
+
+    bool failed = false;
+
+    {
+        vector<future<void>> vf;
+
+        for (int t = 0; t < threads; ++t)
+        {
+            vf.emplace_back(async(std::launch::async, [&l, &counter, &inside]() {
+                for (int c = 0; c < increments; ++c)
+                {
+                    lock_guard<lock_type> lg(l);
+                    if (inside++ != 0) throw logic_error("two threads inside critical section.");
+                    counter = counter + 1;
+                    inside--;
+                }
+            }));
+        }
+
+        try
+        {
+            for (auto & task : vf)
+            {
+                task.get();
+            }
+        }
+        catch (std::exception & e)
+        {
+            failed = true;
+#ifdef PRINT_TRACE
+            std::cerr << "\n" << e.what() << std::flush;
+#endif
+        }
+    }
+
+    if (counter != static_cast<long long>(threads) * increments)
+    {
+        failed = true;
+#ifdef PRINT_TRACE
+        std::cerr << "\n lost updates: " << counter << std::flush;
+#endif
+    }
+
+    if (failed)
+    {
+        cout << "\n FAIL";
+    }
+    else
+    {
+        cout << "\n success";
+    }
+    cout << " : parallelism test - mutual exclusion - " << name << std::flush;
+
+    return (!failed);
+}
+
+#define RUN_TEST(testcase) { if (!testcase) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity<lockfree::spin_lock>("spin_lock"));
+    RUN_TEST(testcase_sanity<lockfree::mcs_lock>("mcs_lock"));
+    RUN_TEST(testcase_sanity<lockfree::clh_lock>("clh_lock"));
+
+    RUN_TEST(testcase_mutual_exclusion<lockfree::spin_lock>("spin_lock"));
+    RUN_TEST(testcase_mutual_exclusion<lockfree::mcs_lock>("mcs_lock"));
+    RUN_TEST(testcase_mutual_exclusion<lockfree::clh_lock>("clh_lock"));
+
+    RUN_TEST(testcase_mutual_exclusion<lockfree::basic_spin_lock<lockfree::exponential_backoff<>>>("spin_lock exponential_backoff"));
+    RUN_TEST(testcase_mutual_exclusion<lockfree::basic_mcs_lock<lockfree::yield_backoff<>>>("mcs_lock yield_backoff"));
+    RUN_TEST(testcase_mutual_exclusion<lockfree::basic_clh_lock<lockfree::yield_backoff<>>>("clh_lock yield_backoff"));
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
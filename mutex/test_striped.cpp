@@ -0,0 +1,161 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread test_striped.cpp
+//
+// This test shows how to scale out a single thread use only map
+// into a multi-thread safe map with one lock per stripe
+// using the striped adapter from this repo.
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "striped.h"
+
+#include <iostream>
+#include <future>
+#include <vector>
+#include <map>
+#include <string>
+#include <stdexcept>
+
+using std::cout;
+using std::map;
+using std::vector;
+using std::string;
+using std::logic_error;
+using std::flush;
+using std::future;
+
+using striped_map = lockfree::striped<map<int, int>, 8>;
+
+bool testcase_sanity()
+{
+    bool bResult = false;
+    try
+    {
+        striped_map sm;
+
+        for (int k = 0; k < 100; ++k)
+        {
+            sm.write(k, [k](map<int, int> & m) { m[k] = k * k; });
+        }
+
+        for (int k = 0; k < 100; ++k)
+        {
+            auto v = sm.read(k, [k](const map<int, int> & m) {
+                auto it = m.find(k);
+                return (it == m.end()) ? -1 : it->second;
+            });
+            if (v != k * k) throw logic_error("unexpected value read back.");
+        }
+
+        if (sm.size() != 100) throw logic_error("unexpected size.");
+
+        // keys must be spread over more than one stripe.
+        unsigned int nonempty = 0;
+        sm.read_all([&nonempty](const map<int, int> & m) { if (!m.empty()) nonempty++; });
+        if (nonempty < 2) throw logic_error("keys not sharded across stripes.");
+
+        sm.clear();
+        if (sm.size() != 0) throw logic_error("clear did not empty all stripes.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - single threaded read write and whole container operations." << std::flush;
+    return bResult;
+}
+
+bool testcase_parallelism()
+{
+    striped_map sm;
+
+    static const int threads = 8;
+    static const int increments = 2000;
+    static const int keys = 64;
+
+    bool failed = false;
+
+    {
+        vector<future<void>> vf;
+
+        for (int t = 0; t < threads; ++t)
+        {
+            vf.emplace_back(async(std::launch::async, [&sm, t]() {
+                for (int c = 0; c < increments; ++c)
+                {
+                    int k = (c + t) % keys;
+                    sm.write(k, [k](map<int, int> & m) { m[k]++; });
+                    sm.read(k, [k](const map<int, int> & m) {
+                        if (m.find(k) == m.end()) throw logic_error("written key not found.");
+                        return 0;
+                    });
+                }
+            }));
+        }
+
+        // whole container operations in parallel with the per key operations.
+        vf.emplace_back(async(std::launch::async, [&sm]() {
+            for (int c = 0; c < 100; ++c)
+            {
+                if (sm.size() > keys) throw logic_error("more keys than inserted.");
+            }
+        }));
+
+        try
+        {
+            for (auto & task : vf)
+            {
+                task.get();
+            }
+        }
+        catch (std::exception & e)
+        {
+            failed = true;
+#ifdef PRINT_TRACE
+            std::cerr << "\n" << e.what() << std::flush;
+#endif
+        }
+    }
+
+    int total = 0;
+    sm.read_all([&total](const map<int, int> & m) { for (auto & kv : m) total += kv.second; });
+    if (total != threads * increments)
+    {
+        failed = true;
+#ifdef PRINT_TRACE
+        std::cerr << "\n lost updates: " << total << " != " << threads * increments << std::flush;
+#endif
+    }
+
+    if (failed)
+    {
+        cout << "\n FAIL";
+    }
+    else
+    {
+        cout << "\n success";
+    }
+    cout << " : parallelism test - striped multi thread safe map." << std::flush;
+
+    return (!failed);
+}
+
+#define RUN_TEST(testcase) { if (!testcase()) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity);
+    RUN_TEST(testcase_parallelism);
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
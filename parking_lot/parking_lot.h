@@ -0,0 +1,454 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "../util/cache_line.h"
+#include "../mutex/spin_lock.h"
+#include "../backoff/backoff.h"
+#include "../backoff/calibration.h"
+#include "../trace/trace_point.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>
+#include <cerrno>
+#else
+#include <mutex>
+#include <condition_variable>
+#endif
+
+// Global parking lot shared by all blocking primitives.
+// Note: Similar to the parking lot of WebKit and of the Rust parking_lot crate.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+A thread parks on an address, and sleeps until another thread unparks that address.
+The address is any address, usually of the atomic the thread is waiting on.
+So a lock only needs a couple of bits of state, eg. locked and parked,
+instead of embedding its own futex word or mutex and condition variable.
+
+Design:
+A fixed table of buckets, each on its own cache line. An address hashes to a bucket.
+Each bucket has a short spin_lock and a FIFO queue of the threads parked on addresses in that bucket.
+Each thread has one parker, its own futex word, which is only ever slept on by that thread.
+Since a thread is parked on at most one address at a time, a thread needs only one parker.
+
+park(addr, validate):
+    Under the bucket lock, calls validate(). If it returns false, returns false without parking.
+    Else enqueues the thread, releases the bucket lock and sleeps until unparked.
+    Since unpark also takes the bucket lock, validate() sees the atomic either before an unparker
+    changes it under the bucket lock, or after. So a wake-up cannot be lost in between.
+unpark_one(addr, callback):
+    Under the bucket lock, dequeues the first thread parked on addr, and calls
+    callback(result) where result says whether a thread was unparked and whether more remain.
+    The callback lets a lock clear its parked bit atomically with respect to new parkers.
+    The thread is woken after the bucket lock is released.
+unpark_all(addr):
+    Dequeues and wakes all threads parked on addr.
+
+park_until() also returns false on timeout. A thread that times out removes itself
+from the bucket. If an unparker had dequeued it already, it waits for that wake-up instead,
+and reports being unparked, since the unparker has already counted it as unparked.
+
+spin_then_park(addr, done) is the wait loop shared by the blocking primitives:
+    spin for the calibrated spins_before_park while done() is false, then park on addr
+    for as long as done() stays false. The waker must change the state, then unpark addr.
+    It returns on the first call of done() that returns true, whether from the loop or as the
+    park validator, so done() may have a side effect on success, eg. take a permit.
+
+Parks and unparks are trace points of trace_point.h, off unless LOCKFREE_TRACE is defined.
+
+On Linux a parker sleeps on a private futex. Elsewhere it falls back to a mutex and condition variable.
+*/
+
+namespace lockfree
+{
+
+class parking_lot
+{
+public:
+    struct unpark_result
+    {
+        bool unparked;
+        bool have_more;
+    };
+
+    static const unsigned int bucket_count = 1024;
+
+    template<typename Validate>
+    static bool park(const void * addr, Validate validate)
+    {
+        return park_impl(addr, validate, nullptr);
+    }
+
+    template<typename Validate, typename Clock, typename Duration>
+    static bool park_until(const void * addr, Validate validate, const std::chrono::time_point<Clock, Duration> & deadline)
+    {
+        auto steady_deadline = std::chrono::steady_clock::now() + (deadline - Clock::now());
+        return park_impl(addr, validate, &steady_deadline);
+    }
+
+    template<typename Callback>
+    static unpark_result unpark_one(const void * addr, Callback callback)
+    {
+        auto & b = bucket_of(addr);
+        unpark_result result = { false, false };
+        parker * pWoken = nullptr;
+
+        b.lock.lock();
+        parker ** ppLink = &b.pHead;
+        parker * pPrevious = nullptr;
+        while (*ppLink)
+        {
+            auto p = *ppLink;
+            if (p->addr == addr)
+            {
+                if (!pWoken)
+                {
+                    pWoken = p;
+                    *ppLink = p->pNext;
+                    if (b.pTail == p)
+                    {
+                        b.pTail = pPrevious;
+                    }
+                    continue;
+                }
+                result.have_more = true;
+                break;
+            }
+            pPrevious = p;
+            ppLink = &p->pNext;
+        }
+        result.unparked = (pWoken != nullptr);
+        callback(result);
+        b.lock.unlock();
+
+        if (pWoken)
+        {
+            LOCKFREE_TRACE_EVENT(unpark, 1);
+            pWoken->unpark();
+        }
+        return result;
+    }
+
+    static unpark_result unpark_one(const void * addr)
+    {
+        return unpark_one(addr, [](const unpark_result &) {});
+    }
+
+    // Returns the count of threads unparked.
+    static unsigned int unpark_all(const void * addr)
+    {
+        auto & b = bucket_of(addr);
+        parker * pWokenHead = nullptr;
+        unsigned int count = 0;
+
+        b.lock.lock();
+        parker ** ppLink = &b.pHead;
+        parker * pPrevious = nullptr;
+        while (*ppLink)
+        {
+            auto p = *ppLink;
+            if (p->addr == addr)
+            {
+                *ppLink = p->pNext;
+                if (b.pTail == p)
+                {
+                    b.pTail = pPrevious;
+                }
+                p->pNext = pWokenHead;
+                pWokenHead = p;
+                count++;
+                continue;
+            }
+            pPrevious = p;
+            ppLink = &p->pNext;
+        }
+        b.lock.unlock();
+
+        if (count)
+        {
+            LOCKFREE_TRACE_EVENT(unpark, count);
+        }
+        while (pWokenHead)
+        {
+            // pNext must be read before unpark(), after which the parker may be reused.
+            auto p = pWokenHead;
+            pWokenHead = p->pNext;
+            p->unpark();
+        }
+        return count;
+    }
+
+    // Spins for the calibrated spins_before_park until done(). Returns false if still not done.
+    template<typename Done>
+    static bool spin(Done & done)
+    {
+        for (unsigned int spins = spin_calibration::budget().spins_before_park; spins; --spins)
+        {
+            if (done())
+            {
+                return true;
+            }
+            cpu_relax();
+        }
+        return false;
+    }
+
+    // Returns as soon as a call to done() returns true, so done() may claim what it checks,
+    // eg. take a semaphore permit. It is never called again after it returned true.
+    template<typename Done>
+    static void spin_then_park(const void * addr, Done done)
+    {
+        if (spin(done))
+        {
+            return;
+        }
+        bool bDone = false;
+        while (!done())
+        {
+            // done() is also the park validator, so it may return true under the bucket lock.
+            park(addr, [&done, &bDone]() { bDone = done(); return !bDone; });
+            if (bDone)
+            {
+                return;
+            }
+        }
+    }
+
+    // Returns false on timeout.
+    template<typename Done, typename Clock, typename Duration>
+    static bool spin_then_park_until(const void * addr, Done done, const std::chrono::time_point<Clock, Duration> & deadline)
+    {
+        if (spin(done))
+        {
+            return true;
+        }
+        bool bDone = false;
+        while (!done())
+        {
+            if (Clock::now() >= deadline)
+            {
+                return false;
+            }
+            park_until(addr, [&done, &bDone]() { bDone = done(); return !bDone; }, deadline);
+            if (bDone)
+            {
+                return true;
+            }
+        }
+        return true;
+    }
+
+    //
+    // Convenience wait and notify for an atomic, in the manner of C++20 atomic::wait and notify.
+    // Note: notify takes the bucket lock, so a primitive should track whether there are waiters
+    //  and call notify only when there may be.
+    //
+    template<typename T>
+    static void wait(const std::atomic<T> & a, T old)
+    {
+        while (a.load(std::memory_order_acquire) == old)
+        {
+            park(&a, [&a, old]() { return a.load(std::memory_order_relaxed) == old; });
+        }
+    }
+
+    template<typename T>
+    static void notify_one(const std::atomic<T> & a)
+    {
+        unpark_one(&a);
+    }
+
+    template<typename T>
+    static void notify_all(const std::atomic<T> & a)
+    {
+        unpark_all(&a);
+    }
+
+private:
+    //
+    // Per-thread sleep and wake-up.
+    // unpark() may come before sleep() starts; the word makes sure the wake-up is not lost.
+    //
+    class parker
+    {
+    public:
+        parker() : addr(nullptr), pNext(nullptr), m_word{ 0 }
+        {
+        }
+
+        void prepare()
+        {
+            m_word.store(0, std::memory_order_relaxed);
+        }
+
+        // Returns false on timeout.
+        bool sleep(const std::chrono::steady_clock::time_point * pDeadline)
+        {
+#ifdef __linux__
+            while (m_word.load(std::memory_order_acquire) == 0)
+            {
+                timespec ts;
+                timespec * pTs = nullptr;
+                if (pDeadline)
+                {
+                    auto left = *pDeadline - std::chrono::steady_clock::now();
+                    if (left <= std::chrono::steady_clock::duration::zero())
+                    {
+                        return m_word.load(std::memory_order_acquire) != 0;
+                    }
+                    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(left).count();
+                    ts.tv_sec = static_cast<time_t>(ns / 1000000000);
+                    ts.tv_nsec = static_cast<long>(ns % 1000000000);
+                    pTs = &ts;
+                }
+                syscall(SYS_futex, reinterpret_cast<int *>(&m_word), FUTEX_WAIT_PRIVATE, 0, pTs, nullptr, 0);
+            }
+            return true;
+#else
+            std::unique_lock<std::mutex> lk(m_mutex);
+            auto woken = [this]() { return m_word.load(std::memory_order_acquire) != 0; };
+            if (pDeadline)
+            {
+                return m_cv.wait_until(lk, *pDeadline, woken);
+            }
+            m_cv.wait(lk, woken);
+            return true;
+#endif
+        }
+
+        void unpark()
+        {
+#ifdef __linux__
+            // The parker can be reused as soon as the word is set, so the futex wake may hit
+            // a reused word. That is only a spurious wake-up, which sleep() loops on.
+            m_word.store(1, std::memory_order_release);
+            syscall(SYS_futex, reinterpret_cast<int *>(&m_word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#else
+            std::lock_guard<std::mutex> lk(m_mutex);
+            m_word.store(1, std::memory_order_release);
+            m_cv.notify_one();
+#endif
+        }
+
+        // Only accessed under the bucket lock.
+        const void * addr;
+        parker * pNext;
+
+    private:
+        std::atomic<int> m_word;
+#ifndef __linux__
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+#endif
+    };
+
+    struct alignas(cache_line_size) bucket
+    {
+        bucket() : pHead(nullptr), pTail(nullptr)
+        {
+        }
+
+        basic_spin_lock<yield_backoff<>> lock;
+        parker * pHead;
+        parker * pTail;
+    };
+
+    static parker & this_thread_parker()
+    {
+        static thread_local parker p;
+        return p;
+    }
+
+    static bucket & bucket_of(const void * addr)
+    {
+        static bucket buckets[bucket_count];
+
+        // fibonacci hashing of the address, ignoring the low bits that are mostly zero.
+        auto h = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(addr) >> 2) * 0x9e3779b97f4a7c15ULL;
+        return buckets[(h >> 32) % bucket_count];
+    }
+
+    template<typename Validate>
+    static bool park_impl(const void * addr, Validate & validate, const std::chrono::steady_clock::time_point * pDeadline)
+    {
+        auto & b = bucket_of(addr);
+        auto & me = this_thread_parker();
+
+        b.lock.lock();
+        if (!validate())
+        {
+            b.lock.unlock();
+            return false;
+        }
+        me.prepare();
+        me.addr = addr;
+        me.pNext = nullptr;
+        if (b.pTail)
+        {
+            b.pTail->pNext = &me;
+        }
+        else
+        {
+            b.pHead = &me;
+        }
+        b.pTail = &me;
+        b.lock.unlock();
+
+        LOCKFREE_TRACE_EVENT(park_begin, reinterpret_cast<std::uintptr_t>(addr));
+        auto woken = me.sleep(pDeadline);
+        LOCKFREE_TRACE_EVENT(park_end, woken);
+        if (woken)
+        {
+            return true;
+        }
+
+        //
+        // Timed out. Remove self from the bucket, unless an unparker got there first.
+        //
+        bool dequeued = false;
+        b.lock.lock();
+        parker ** ppLink = &b.pHead;
+        parker * pPrevious = nullptr;
+        while (*ppLink)
+        {
+            if (*ppLink == &me)
+            {
+                *ppLink = me.pNext;
+                if (b.pTail == &me)
+                {
+                    b.pTail = pPrevious;
+                }
+                dequeued = true;
+                break;
+            }
+            pPrevious = *ppLink;
+            ppLink = &(*ppLink)->pNext;
+        }
+        b.lock.unlock();
+
+        if (!dequeued)
+        {
+            // An unpark is in flight. Wait for it so the parker is not reused while it lands.
+            me.sleep(nullptr);
+            return true;
+        }
+        return false;
+    }
+};
+
+}
@@ -0,0 +1,140 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "parking_lot.h"
+#include "../backoff/calibration.h"
+
+#include <atomic>
+#include <cstdint>
+
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_release;
+
+// One byte mutex that spins, then parks on the global parking lot.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+The interface adheres to the C++11 Lockable requirements, so std::lock_guard and std::unique_lock can wrap it.
+The whole state is one byte, so the mutex can sit next to the data it protects
+without growing it, eg. in a node or beside a pointer.
+
+Design:
+state bit locked_bit : mutex is held.
+state bit parked_bit : there may be threads parked on this mutex.
+lock():
+    fast path: compare and swap 0 to locked_bit.
+    slow path: spin for the calibrated spins_before_park while no thread is parked,
+        trying to take the lock whenever it is free.
+        Then set parked_bit and park, as long as the state is still locked_bit | parked_bit.
+unlock():
+    fast path: compare and swap locked_bit to 0. Fails only if parked_bit is set.
+    slow path: unpark one thread. Under the bucket lock, set state to parked_bit
+        if more threads remain parked, else 0.
+A woken thread competes for the lock like any other; barging keeps throughput high.
+*/
+
+namespace lockfree
+{
+
+class parking_mutex
+{
+public:
+    constexpr parking_mutex() : m_state{ 0 }
+    {
+    }
+
+    parking_mutex(const parking_mutex &) = delete;
+    parking_mutex & operator=(const parking_mutex &) = delete;
+
+    void lock()
+    {
+        std::uint8_t expected = 0;
+        // memory_order_acquire on success due to all PD reads issued after this must 'happen after' this.
+        // PD is data structure protected by using this mutex.
+        if (!m_state.compare_exchange_weak(expected, locked_bit, memory_order_acquire, memory_order_relaxed))
+        {
+            lock_slow();
+        }
+    }
+
+    bool try_lock()
+    {
+        auto state = m_state.load(memory_order_relaxed);
+        return !(state & locked_bit) &&
+            m_state.compare_exchange_strong(state, state | locked_bit, memory_order_acquire, memory_order_relaxed);
+    }
+
+    void unlock()
+    {
+        std::uint8_t expected = locked_bit;
+        // memory_order_release due to all PD writes issued before this must 'happen before' this.
+        if (!m_state.compare_exchange_strong(expected, 0, memory_order_release, memory_order_relaxed))
+        {
+            unlock_slow();
+        }
+    }
+
+private:
+    static const std::uint8_t locked_bit = 1;
+    static const std::uint8_t parked_bit = 2;
+
+    void lock_slow()
+    {
+        unsigned int spins = spin_calibration::budget().spins_before_park;
+
+        for (;;)
+        {
+            auto state = m_state.load(memory_order_relaxed);
+
+            if (!(state & locked_bit))
+            {
+                if (m_state.compare_exchange_weak(state, state | locked_bit, memory_order_acquire, memory_order_relaxed))
+                {
+                    return;
+                }
+                continue;
+            }
+
+            // Spin only while nobody is parked. Once someone is parked, spinning just delays parking.
+            if (!(state & parked_bit) && spins)
+            {
+                spins--;
+                cpu_relax();
+                continue;
+            }
+
+            if (!(state & parked_bit))
+            {
+                if (!m_state.compare_exchange_weak(state, state | parked_bit, memory_order_relaxed, memory_order_relaxed))
+                {
+                    continue;
+                }
+            }
+
+            parking_lot::park(this, [this]() {
+                return m_state.load(memory_order_relaxed) == (locked_bit | parked_bit);
+            });
+        }
+    }
+
+    void unlock_slow()
+    {
+        parking_lot::unpark_one(this, [this](const parking_lot::unpark_result & result) {
+            // memory_order_release due to all PD writes issued before this must 'happen before' this.
+            m_state.store(result.have_more ? parked_bit : 0, memory_order_release);
+        });
+    }
+
+    std::atomic<std::uint8_t> m_state;
+};
+
+}
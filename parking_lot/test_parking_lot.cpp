@@ -0,0 +1,189 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread test_parking_lot.cpp
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "parking_lot.h"
+#include "parking_mutex.h"
+
+#include <mutex>
+#include <iostream>
+#include <future>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+
+using std::cout;
+using std::vector;
+using std::logic_error;
+using std::flush;
+using std::future;
+using std::atomic;
+namespace chrono = std::chrono;
+
+using lockfree::parking_lot;
+using lockfree::parking_mutex;
+
+bool testcase_sanity()
+{
+    bool bResult = false;
+    try
+    {
+        int dummy = 0;
+
+        // validation failing must return without parking.
+        if (parking_lot::park(&dummy, []() { return false; })) throw logic_error("parked despite failed validation.");
+
+        // unpark with nobody parked.
+        auto r = parking_lot::unpark_one(&dummy);
+        if (r.unparked || r.have_more) throw logic_error("unparked a thread that was not parked.");
+        if (parking_lot::unpark_all(&dummy) != 0) throw logic_error("unparked threads that were not parked.");
+
+        // timed park with nobody to unpark must time out.
+        auto start = chrono::steady_clock::now();
+        if (parking_lot::park_until(&dummy, []() { return true; }, start + chrono::milliseconds(20)))
+            throw logic_error("timed park did not time out.");
+        if (chrono::steady_clock::now() - start < chrono::milliseconds(20)) throw logic_error("timed park returned early.");
+
+        if (sizeof(parking_mutex) != 1) throw logic_error("parking_mutex is not one byte.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - validation, empty unpark, timeout." << std::flush;
+    return bResult;
+}
+
+bool testcase_unpark()
+{
+    bool bResult = false;
+    try
+    {
+        static const int threads = 4;
+        atomic<int> flag{ 0 };
+        atomic<int> woken{ 0 };
+
+        vector<std::thread> vt;
+        for (int t = 0; t < threads; ++t)
+        {
+            vt.emplace_back([&flag, &woken]() {
+                parking_lot::wait(flag, 0);
+                woken++;
+            });
+        }
+
+        // let the threads park. They are correct even if they don't get to park.
+        std::this_thread::sleep_for(chrono::milliseconds(50));
+        if (woken.load() != 0) throw logic_error("thread woke before flag changed.");
+
+        flag.store(1);
+        parking_lot::notify_all(flag);
+
+        for (auto & t : vt)
+        {
+            t.join();
+        }
+        if (woken.load() != threads) throw logic_error("not all threads woken.");
+
+        // unpark_one reports remaining waiters.
+        atomic<int> gate{ 0 };
+        std::thread a([&gate]() { parking_lot::park(&gate, [&gate]() { return gate.load() == 0; }); });
+        std::thread b([&gate]() { parking_lot::park(&gate, [&gate]() { return gate.load() == 0; }); });
+        std::this_thread::sleep_for(chrono::milliseconds(50));
+        gate.store(1);
+        auto r1 = parking_lot::unpark_one(&gate);
+        auto r2 = parking_lot::unpark_one(&gate);
+        a.join();
+        b.join();
+        if (!r1.unparked || !r1.have_more || !r2.unparked || r2.have_more) throw logic_error("unexpected unpark_one result.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : unpark test - notify all, unpark one." << std::flush;
+    return bResult;
+}
+
+bool testcase_parking_mutex()
+{
+    parking_mutex m;
+
+    static const int threads = 8;
+    static const int increments = 5000;
+
+    volatile long long counter = 0;
+    atomic<int> inside{ 0 };
+
+    bool failed = false;
+    {
+        vector<future<void>> vf;
+        for (int t = 0; t < threads; ++t)
+        {
+            vf.emplace_back(async(std::launch::async, [&m, &counter, &inside]() {
+                for (int c = 0; c < increments; ++c)
+                {
+                    std::lock_guard<parking_mutex> lg(m);
+                    if (inside.fetch_add(1) != 0) throw logic_error("two threads inside critical section.");
+                    counter = counter + 1;
+                    // hold the lock long enough now and then that waiters park.
+                    if (c % 500 == 0) std::this_thread::sleep_for(chrono::microseconds(200));
+                    inside.fetch_sub(1);
+                }
+            }));
+        }
+        try
+        {
+            for (auto & task : vf)
+            {
+                task.get();
+            }
+        }
+        catch (std::exception & e)
+        {
+            failed = true;
+#ifdef PRINT_TRACE
+            std::cerr << "\n" << e.what() << std::flush;
+#endif
+        }
+    }
+
+    if (counter != static_cast<long long>(threads) * increments)
+    {
+        failed = true;
+    }
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : parallelism test - parking_mutex mutual exclusion." << std::flush;
+    return !failed;
+}
+
+#define RUN_TEST(testcase) { if (!testcase()) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity);
+    RUN_TEST(testcase_unpark);
+    RUN_TEST(testcase_parking_mutex);
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
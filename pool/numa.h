@@ -0,0 +1,224 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "../topology/topology.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// NUMA node local memory for object pools, and the containers that draw from them.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+A block of a pool is wherever its slab is. With operator new that is wherever the thread that
+grew the pool first touched it, so consumers on another socket may pay remote latency on every pop.
+
+numa_slab_allocator:
+    A slab allocator policy, as in slab_allocator.h, that maps slabs on a given node.
+    The slab is bound to the node with mbind MPOL_PREFERRED, so allocation falls back to other nodes
+    when the node is out of memory, and faulted in at once, so that it lands there.
+    If mbind fails, eg. on a kernel without NUMA support or for a node id of a simulated topology
+    that the machine does not have, the slab is faulted in by the allocating thread,
+    and is local to that thread by first touch.
+    The default node is local_node, ie. first touch by the thread that grows the pool.
+numa_pools:
+    One pool per node of a cpu_topology, each with a numa_slab_allocator of its node.
+    of_node(n) is the pool of node n, and local() the pool of the node of the calling thread.
+    A queue or stack drawing from of_node(n) has its nodes on node n, eg. the node of its consumers.
+make_on_node<T>(node, args...):
+    Constructs a T in memory of its own on the given node, eg. a queue, so that its control words,
+    the list heads, are on the node too. Returns a numa_ptr<T>, a unique_ptr that destroys it.
+    A queue can also be given a numa_slab_allocator of the node for its own pool:
+        auto q = make_on_node<queue<int, spin_lock, no_backoff, numa_slab_allocator>>(1, 1024, numa_slab_allocator(1));
+On other than linux memory is not placed, and all this falls back to operator new.
+*/
+
+namespace lockfree
+{
+
+class numa_slab_allocator
+{
+public:
+    static const int local_node = -1;
+
+    explicit numa_slab_allocator(int node = local_node) : m_node(node)
+    {
+    }
+
+    int node() const
+    {
+        return m_node;
+    }
+
+    void * allocate(std::size_t & size)
+    {
+#ifdef __linux__
+        size = mapped_size(size);
+        auto p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+
+        if (m_node != local_node)
+        {
+            // On failure first touch below places the slab.
+            bind(p, size, static_cast<unsigned int>(m_node));
+        }
+
+        // A write per page, since a read maps the shared zero page instead.
+        auto pPage = static_cast<volatile char *>(p);
+        for (std::size_t offset = 0; offset < size; offset += page_size())
+        {
+            pPage[offset] = 0;
+        }
+        return p;
+#else
+        return ::operator new(size);
+#endif
+    }
+
+    void deallocate(void * p, std::size_t size)
+    {
+#ifdef __linux__
+        munmap(p, size);
+#else
+        ::operator delete(p);
+#endif
+    }
+
+    // size rounded up to what allocate() maps.
+    static std::size_t mapped_size(std::size_t size)
+    {
+#ifdef __linux__
+        return round_up(size, page_size());
+#else
+        return size;
+#endif
+    }
+
+    // Returns false if the memory could not be bound to the node.
+    static bool bind(void * p, std::size_t size, unsigned int node)
+    {
+#ifdef __linux__
+        if (node >= sizeof(unsigned long) * 8)
+        {
+            return false;
+        }
+        unsigned long mask = 1UL << node;
+        return syscall(SYS_mbind, p, size, MPOL_PREFERRED, &mask, sizeof(mask) * 8, 0) == 0;
+#else
+        return false;
+#endif
+    }
+
+private:
+#ifdef __linux__
+    static std::size_t page_size()
+    {
+        static const std::size_t size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        return size;
+    }
+#endif
+
+    static std::size_t round_up(std::size_t n, std::size_t multiple)
+    {
+        return (n + multiple - 1) / multiple * multiple;
+    }
+
+    int m_node;
+};
+
+// pool_type is a basic_object_pool, or a queue or stack node_pool, with numa_slab_allocator as its slab allocator.
+template<typename pool_type>
+class numa_pools
+{
+public:
+    explicit numa_pools(
+        const cpu_topology & topology = cpu_topology::system(),
+        unsigned int initial_capacity = 0,
+        unsigned int slab_size = pool_type::default_slab_size,
+        unsigned int cache_size = pool_type::default_cache_size) :
+        m_topology(topology)
+    {
+        for (unsigned int node = 0; node < topology.node_count(); ++node)
+        {
+            m_pools.emplace_back(new pool_type(initial_capacity, slab_size, cache_size, numa_slab_allocator(static_cast<int>(node))));
+        }
+    }
+
+    numa_pools(const numa_pools &) = delete;
+    numa_pools & operator=(const numa_pools &) = delete;
+
+    unsigned int node_count() const
+    {
+        return static_cast<unsigned int>(m_pools.size());
+    }
+
+    pool_type & of_node(unsigned int node)
+    {
+        return *m_pools.at(node);
+    }
+
+    // Pool of the node the calling thread runs on right now.
+    pool_type & local()
+    {
+        return of_node(m_topology.current_node());
+    }
+
+private:
+    const cpu_topology & m_topology;
+    std::vector<std::unique_ptr<pool_type>> m_pools;
+};
+
+template<typename T>
+struct numa_delete
+{
+    void operator()(T * p) const
+    {
+        p->~T();
+        numa_slab_allocator().deallocate(p, numa_slab_allocator::mapped_size(sizeof(T)));
+    }
+};
+
+template<typename T>
+using numa_ptr = std::unique_ptr<T, numa_delete<T>>;
+
+template<typename T, typename... Args>
+numa_ptr<T> make_on_node(int node, Args &&... args)
+{
+    numa_slab_allocator allocator(node);
+    std::size_t size = sizeof(T);
+    // page aligned.
+    auto p = allocator.allocate(size);
+    try
+    {
+        return numa_ptr<T>(new (p) T(std::forward<Args>(args)...));
+    }
+    catch (...)
+    {
+        allocator.deallocate(p, size);
+        throw;
+    }
+}
+
+}
@@ -0,0 +1,548 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "../util/cache_line.h"
+#include "../mutex/spin_lock.h"
+#include "../backoff/backoff.h"
+#include "../stack/percpu_stack.h"
+#include "slab_allocator.h"
+
+#include <iostream>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using std::cerr;
+using std::memory_order_relaxed;
+using std::memory_order_consume;
+using std::memory_order_acquire;
+using std::memory_order_release;
+
+// Lock free typed object pool with per-thread caches, in C++11.
+// Note: This is the free list of queue.h and stack.h, made public and grown by slabs.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread -march=native
+//      arch option is needed because older architectures don't support 16 byte atomic.
+
+/*
+Notes:
+acquire(args...) returns a T constructed in a pooled block, and release(p) destroys it
+and recycles the block. allocate() and deallocate(p) do the same without construction.
+Blocks never go back to the memory allocator until the pool is destroyed,
+so a pool must outlive the objects acquired from it.
+object_pool<T>::shared() is a process wide pool per type, that is never destroyed.
+It is what pool_allocator.h draws from.
+object_pool is basic_object_pool with the default no_backoff policy from backoff.h.
+
+Design:
+Memory comes in slabs of slab_size blocks. A block is big enough for a T, or for two links while free.
+Free blocks are kept in batches of cache_size blocks, linked through the first link of each block.
+Global list:
+    The pool holds a lock free list of whole batches, linked through the second link of the head block.
+    As in queue.h, the list head is a node pointer and a sequence number swapped with a 16 byte
+    compare and swap, so that a head popped and pushed back in between does not fool a pop.
+Per-thread cache:
+    Each thread has a cache of up to two batches: the active batch it allocates from and frees to,
+    and one full batch. allocate() takes from the active batch. When it is empty, the full batch
+    becomes active, else a batch is popped from the global list.
+    deallocate() adds to the active batch. When it is full, it becomes the full batch,
+    and a full batch already there is pushed to the global list.
+    So allocate() and deallocate() touch the global list at most once per cache_size calls,
+    and a thread that frees what another thread allocates passes blocks on a batch at a time.
+    The two batches keep a thread that allocates and frees around a batch boundary off the global list.
+Growth:
+    A thread that finds the global list empty takes the slab lock, checks the list again,
+    and else adds a slab, cut into batches pushed to the global list.
+    The initial capacity, rounded up to whole slabs, is allocated as a single slab,
+    so that a large preallocated pool is one contiguous range.
+Slab memory:
+    Slabs come from the slab_allocator policy parameter, one of slab_allocator.h.
+    The default heap_slab_allocator uses operator new. huge_page_slab_allocator maps huge pages,
+    and can pre-fault and mlock them, for fewer TLB misses and no page faults after construction.
+    numa_slab_allocator of numa.h maps them on a chosen NUMA node. A stateful policy is passed to the constructor.
+
+A cache_size of 0 turns the per-thread caches off. Every block is then a batch of its own,
+and each allocate() and deallocate() is one compare and swap on the global list.
+That suits many small pools, each used by a few threads, eg. one per queue.
+Per-cpu free lists:
+    Opt in with per_cpu_free_lists at construction. Where restartable sequences are available, see rseq.h,
+    a pool with a cache_size of 0 then frees blocks to a percpu_stack of percpu_stack.h instead,
+    and allocates from it first.
+    Recycling a block then commits with a plain store on the list of the current cpu,
+    with no 16 byte compare and swap. The global list is only touched for blocks of new slabs,
+    and a cpu list flushes to the shared stack of the percpu_stack past max_per_cpu blocks.
+    Blocks on the list of one cpu are not seen by threads on others, so a pool may grow by
+    up to max_per_cpu blocks per cpu more than with the global list alone.
+    The lists take a cache line per cpu of each such pool. So they are off by default, and suit a few
+    busy pools, eg. one shared by many queues, rather than many small ones whose memory should track their backlog.
+    Elsewhere the pool falls back to the global list as above.
+
+A thread finds its cache of a pool in a small thread_local table, looked up by pool id.
+Pools are told apart by id, not address, so a new pool at the address of an old one is not confused with it.
+A cache is returned to its pool when the thread exits, with its blocks, and reused by the next new thread.
+Caches are shared_ptr owned, by the pool and the thread, so either may go first.
+*/
+
+namespace lockfree
+{
+
+template<typename T, typename backoff = no_backoff, typename slab_allocator = heap_slab_allocator>
+class basic_object_pool
+{
+public:
+    static const unsigned int default_slab_size = 256;
+    static const unsigned int default_cache_size = 32;
+
+    explicit basic_object_pool(
+        unsigned int initial_capacity = 0,
+        unsigned int slab_size = default_slab_size,
+        unsigned int cache_size = default_cache_size,
+        const slab_allocator & allocator = slab_allocator(),
+        bool per_cpu_free_lists = false) :
+        m_id(next_id()),
+        m_cacheSize(cache_size),
+        m_slabSize(round_up(slab_size ? slab_size : 1, cache_size ? cache_size : 1)),
+        m_pFreeBlocks((per_cpu_free_lists && cache_size == 0 && rseq_ops::available()) ? new free_list : nullptr),
+        m_slabAllocator(allocator),
+        m_capacity{ 0 }
+    {
+        std::lock_guard<spin_lock> lk(m_slabLock);
+        if (initial_capacity)
+        {
+            add_slab(round_up(initial_capacity, m_slabSize));
+        }
+    }
+
+    basic_object_pool(const basic_object_pool &) = delete;
+    basic_object_pool & operator=(const basic_object_pool &) = delete;
+
+    // All objects must have been released.
+    ~basic_object_pool()
+    {
+        for (auto & s : m_slabs)
+        {
+            m_slabAllocator.deallocate(s.raw, s.size);
+        }
+    }
+
+    template<typename... Args>
+    T * acquire(Args &&... args)
+    {
+        auto p = allocate();
+        try
+        {
+            return new (p) T(std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            deallocate(p);
+            throw;
+        }
+    }
+
+    void release(T * p)
+    {
+        p->~T();
+        deallocate(p);
+    }
+
+    // Uninitialized storage for one T.
+    void * allocate()
+    {
+        if (!m_cacheSize)
+        {
+            if (m_pFreeBlocks)
+            {
+                if (auto pFree = m_pFreeBlocks->pop())
+                {
+                    return pFree;
+                }
+            }
+            return pop_batch();
+        }
+
+        auto & c = this_thread_cache();
+        if (!c.pActive)
+        {
+            if (c.pFull)
+            {
+                c.pActive = c.pFull;
+                c.pFull = nullptr;
+            }
+            else
+            {
+                c.pActive = pop_batch();
+            }
+            c.activeCount = m_cacheSize;
+        }
+
+        auto pBlock = c.pActive;
+        c.pActive = pBlock->link.pNext;
+        c.activeCount--;
+        return pBlock;
+    }
+
+    void deallocate(void * p)
+    {
+        auto pBlock = static_cast<block *>(p);
+        if (!m_cacheSize)
+        {
+            if (m_pFreeBlocks)
+            {
+                m_pFreeBlocks->push(&pBlock->freeLink);
+                return;
+            }
+            pBlock->link.pNext = nullptr;
+            m_batches.push(pBlock);
+            return;
+        }
+
+        auto & c = this_thread_cache();
+        if (c.activeCount == m_cacheSize)
+        {
+            if (c.pFull)
+            {
+                m_batches.push(c.pFull);
+            }
+            c.pFull = c.pActive;
+            c.pActive = nullptr;
+            c.activeCount = 0;
+        }
+
+        pBlock->link.pNext = c.pActive;
+        c.pActive = pBlock;
+        c.activeCount++;
+    }
+
+    // Blocks carved from slabs so far, whether in use or free.
+    std::size_t capacity() const
+    {
+        return m_capacity.load(memory_order_relaxed);
+    }
+
+    unsigned int cache_size() const
+    {
+        return m_cacheSize;
+    }
+
+    // The pool's copy of its slab allocator, eg. to check huge_page_slab_allocator::locked().
+    const slab_allocator & get_slab_allocator() const
+    {
+        return m_slabAllocator;
+    }
+
+    // Whether freed blocks go to per-cpu lists.
+    bool per_cpu() const
+    {
+        return m_pFreeBlocks != nullptr;
+    }
+
+    // Process wide pool of this type. Never destroyed, so that it outlives static objects that use it.
+    static basic_object_pool & shared()
+    {
+        static basic_object_pool * pPool = new basic_object_pool;
+        return *pPool;
+    }
+
+private:
+    union block
+    {
+        struct links
+        {
+            // next block of the same batch.
+            block * pNext;
+            // next batch of the global list. Only used in the head block of a batch.
+            block * pNextBatch;
+        } link;
+        // hooks of m_pFreeBlocks.
+        struct free_hooks
+        {
+            free_hooks * pPrevious;
+            std::uintptr_t depth;
+        } freeLink;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    };
+
+    //
+    // Lock free list of batches.
+    //
+    class batch_list
+    {
+    public:
+        batch_list() : m_top{ nullptr }
+        {
+            if (!m_top.is_lock_free())
+            {
+                cerr << "\nFalling back to lock based implementation of lockfree::object_pool.";
+            }
+        }
+
+        void push(block * pBatch)
+        {
+            // memory_order_relaxed due to no following dereferencing of top.
+            auto top = m_top.load(memory_order_relaxed);
+
+            head newtop;
+            newtop.pBlock = pBatch;
+
+            backoff wait_retry;
+            for (;;)
+            {
+                pBatch->link.pNextBatch = top.pBlock;
+                newtop.seqNum = top.seqNum + 1;
+
+                // memory_order_release on success due to the batch links need to be visible to the popping thread.
+                // memory_order_relaxed on failure due to no following dereferencing of top.
+                if (m_top.compare_exchange_weak(top, newtop, memory_order_release, memory_order_relaxed))
+                {
+                    break;
+                }
+                wait_retry();
+            }
+        }
+
+        block * pop()
+        {
+            // memory_order_consume due to following dependent load operation top.pBlock->link.pNextBatch.
+            auto top = m_top.load(memory_order_consume);
+
+            head newtop;
+
+            backoff wait_retry;
+            while (top.pBlock)
+            {
+                newtop.pBlock = top.pBlock->link.pNextBatch;
+                newtop.seqNum = top.seqNum;
+
+                // memory_order_consume on failure due to following dependent load operation top.pBlock->link.pNextBatch.
+                // memory_order_relaxed on success due to top actually read by the previous atomic operation, not the current one.
+                //      Note: However success cannot specify weaker ordering than failure until C++17.
+                if (m_top.compare_exchange_weak(top, newtop, memory_order_relaxed, memory_order_consume))
+                {
+                    break;
+                }
+                wait_retry();
+            }
+
+            return top.pBlock;
+        }
+
+    private:
+        struct head
+        {
+            block * pBlock;
+            // Pointer sized, so that the struct has no padding bytes.
+            // compare_exchange compares padding bytes too, which are not preserved on copy.
+            std::uintptr_t seqNum;
+
+            head(block * pB) : pBlock(pB), seqNum(0)
+            {
+            }
+
+            // for default initialization.
+            head()
+            {
+            }
+        };
+
+        std::atomic<head> m_top;
+    };
+
+    //
+    // Per-thread cache of one pool. Only its owner thread touches the batches.
+    //
+    struct alignas(cache_line_size) cache : public cache_aligned
+    {
+        cache() : pActive(nullptr), pFull(nullptr), activeCount(0), m_owned{ true }
+        {
+        }
+
+        bool try_claim()
+        {
+            bool expected = false;
+            // memory_order_acquire due to the batches left by the previous owner must be visible.
+            return m_owned.compare_exchange_strong(expected, true, memory_order_acquire, memory_order_relaxed);
+        }
+
+        void release()
+        {
+            // memory_order_release due to the batches must be visible to the next owner.
+            m_owned.store(false, memory_order_release);
+        }
+
+        block * pActive;
+        block * pFull;
+        unsigned int activeCount;
+
+    private:
+        std::atomic<bool> m_owned;
+    };
+
+    //
+    // The caches of this thread, one per pool of this type it uses.
+    // Returned to their pools when the thread exits.
+    //
+    struct thread_caches
+    {
+        static const unsigned int max_pools = 8;
+
+        thread_caches() : count(0), next(0)
+        {
+        }
+
+        ~thread_caches()
+        {
+            for (unsigned int i = 0; i < count; ++i)
+            {
+                entries[i].pCache->release();
+            }
+        }
+
+        struct entry
+        {
+            std::uint64_t poolId;
+            std::shared_ptr<cache> pCache;
+        };
+
+        entry entries[max_pools];
+        unsigned int count;
+        unsigned int next;
+    };
+
+    static std::uint64_t next_id()
+    {
+        static std::atomic<std::uint64_t> id{ 0 };
+        return id.fetch_add(1, memory_order_relaxed) + 1;
+    }
+
+    static unsigned int round_up(unsigned int n, unsigned int multiple)
+    {
+        return (n + multiple - 1) / multiple * multiple;
+    }
+
+    cache & this_thread_cache()
+    {
+        static thread_local thread_caches caches;
+
+        for (unsigned int i = 0; i < caches.count; ++i)
+        {
+            if (caches.entries[i].poolId == m_id)
+            {
+                return *caches.entries[i].pCache;
+            }
+        }
+
+        unsigned int slot = caches.count;
+        if (slot == thread_caches::max_pools)
+        {
+            slot = caches.next;
+            caches.next = (caches.next + 1) % thread_caches::max_pools;
+            caches.entries[slot].pCache->release();
+        }
+        else
+        {
+            caches.count++;
+        }
+        caches.entries[slot].poolId = m_id;
+        caches.entries[slot].pCache = acquire_cache();
+        return *caches.entries[slot].pCache;
+    }
+
+    // Once per thread. Reuses a cache released by an exited thread if there is one.
+    std::shared_ptr<cache> acquire_cache()
+    {
+        std::lock_guard<spin_lock> lk(m_cachesLock);
+        for (auto & pCache : m_caches)
+        {
+            if (pCache->try_claim())
+            {
+                return pCache;
+            }
+        }
+        m_caches.emplace_back(new cache);
+        return m_caches.back();
+    }
+
+    block * pop_batch()
+    {
+        for (;;)
+        {
+            if (auto pBatch = m_batches.pop())
+            {
+                return pBatch;
+            }
+
+            std::lock_guard<spin_lock> lk(m_slabLock);
+            // Another thread may have added a slab while this one waited for the lock.
+            if (auto pBatch = m_batches.pop())
+            {
+                return pBatch;
+            }
+            add_slab(m_slabSize);
+        }
+    }
+
+    // Call holding m_slabLock. blockCount is a multiple of m_slabSize.
+    void add_slab(unsigned int blockCount)
+    {
+        // operator new aligns only to alignof(std::max_align_t) until C++17, so align manually.
+        slab s;
+        s.size = blockCount * sizeof(block) + alignof(block);
+        s.raw = m_slabAllocator.allocate(s.size);
+        m_slabs.push_back(s);
+        auto addr = reinterpret_cast<std::uintptr_t>(s.raw);
+        auto blocks = reinterpret_cast<block *>((addr + alignof(block) - 1) & ~(static_cast<std::uintptr_t>(alignof(block)) - 1));
+
+        auto batchSize = m_cacheSize ? m_cacheSize : 1;
+        for (unsigned int first = 0; first < blockCount; first += batchSize)
+        {
+            for (unsigned int i = first; i < first + batchSize; ++i)
+            {
+                blocks[i].link.pNext = (i + 1 < first + batchSize) ? &blocks[i + 1] : nullptr;
+            }
+            m_batches.push(&blocks[first]);
+        }
+        m_capacity.fetch_add(blockCount, memory_order_relaxed);
+    }
+
+    const std::uint64_t m_id;
+    const unsigned int m_cacheSize;
+    const unsigned int m_slabSize;
+
+    batch_list m_batches;
+    // Only made with a cache_size of 0, per_cpu_free_lists, and restartable sequences available,
+    // so that other pools pay neither its lists nor its shared stack.
+    using free_list = percpu_stack<typename block::free_hooks, backoff>;
+    std::unique_ptr<free_list> m_pFreeBlocks;
+
+    slab_allocator m_slabAllocator;
+
+    struct slab
+    {
+        void * raw;
+        std::size_t size;
+    };
+
+    spin_lock m_slabLock;
+    std::vector<slab> m_slabs;
+    std::atomic<std::size_t> m_capacity;
+
+    spin_lock m_cachesLock;
+    std::vector<std::shared_ptr<cache>> m_caches;
+};
+
+template<typename T>
+using object_pool = basic_object_pool<T>;
+
+}
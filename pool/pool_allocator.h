@@ -0,0 +1,91 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "object_pool.h"
+
+#include <cstddef>
+#include <new>
+
+// STL compatible allocator that draws single objects from the shared object_pool of their type.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread -march=native
+
+/*
+Notes:
+Node based containers allocate one node at a time, eg. std::list, std::map, std::set, std::unordered_map.
+With pool_allocator those nodes come from object_pool<node>::shared(), and go back to it,
+instead of going through malloc and free.
+    std::list<msg, lockfree::pool_allocator<msg>> l;
+    std::map<int, msg, std::less<int>, lockfree::pool_allocator<std::pair<const int, msg>>> m;
+A container rebinds the allocator to its node type, so the pool is that of the node type.
+
+Allocations of more than one object, eg. the bucket array of std::unordered_map or the storage of std::vector,
+go to operator new, since a pool block holds a single object.
+
+The allocator is stateless. All pool_allocators compare equal, so containers can swap and splice
+freely, and a node allocated in one thread can be freed in another.
+*/
+
+namespace lockfree
+{
+
+template<typename T>
+class pool_allocator
+{
+public:
+    using value_type = T;
+
+    template<typename U>
+    struct rebind
+    {
+        using other = pool_allocator<U>;
+    };
+
+    pool_allocator() noexcept
+    {
+    }
+
+    template<typename U>
+    pool_allocator(const pool_allocator<U> &) noexcept
+    {
+    }
+
+    T * allocate(std::size_t n)
+    {
+        if (n == 1)
+        {
+            return static_cast<T *>(object_pool<T>::shared().allocate());
+        }
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T * p, std::size_t n)
+    {
+        if (n == 1)
+        {
+            object_pool<T>::shared().deallocate(p);
+            return;
+        }
+        ::operator delete(p);
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const pool_allocator<T> &, const pool_allocator<U> &) noexcept
+{
+    return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const pool_allocator<T> &, const pool_allocator<U> &) noexcept
+{
+    return false;
+}
+
+}
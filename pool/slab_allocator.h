@@ -0,0 +1,201 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Slab allocator policies of object_pool.h.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+basic_object_pool takes a slab allocator policy template parameter, which gets the memory
+its blocks are carved from. A slab is only returned when the pool is destroyed.
+A slab allocator policy is a default constructible, copyable class with
+    void * allocate(std::size_t & size)
+    void deallocate(void * p, std::size_t size)
+allocate() may round size up to what it got, and deallocate() is called with that size.
+A policy with state, eg. a NUMA node, is passed to the constructor of the pool, which keeps a copy.
+
+Policies:
+    heap_slab_allocator         : operator new. The default.
+    huge_page_slab_allocator    : anonymous mmap, backed by huge pages where possible,
+                                  so that a large pool takes few TLB entries.
+                                  prefault touches every page at allocation, so that no page fault
+                                  lands on the first push after startup.
+                                  lock_memory also mlocks the slab, so that it is never paged out.
+    numa_slab_allocator         : in numa.h. Anonymous mmap bound to a chosen NUMA node.
+
+huge_page_slab_allocator:
+A slab of at least a huge page is first mapped with MAP_HUGETLB, from the reserved huge page pool
+(/proc/sys/vm/nr_hugepages). If none are reserved, it falls back to normal pages, advised with
+MADV_HUGEPAGE, so that transparent huge pages back it where the kernel allows.
+The kernel backs only huge page aligned ranges with transparent huge pages, and mmap aligns only
+to a page. So the fallback maps a huge page more than it needs, and unmaps the unaligned head and
+the tail, leaving a huge page aligned slab of whole huge pages.
+A smaller slab gains nothing from huge pages, and is only advised.
+mlock fails beyond RLIMIT_MEMLOCK, in which case the slab is used unlocked. locked() tells whether
+every slab so far was locked, and lock_failures() how many were not. The pool keeps a copy of its
+allocator, see basic_object_pool::get_slab_allocator().
+On other than linux it falls back to operator new.
+A pool preallocates its initial capacity as one slab, so a large initial_capacity is one mapping.
+*/
+
+namespace lockfree
+{
+
+struct heap_slab_allocator
+{
+    void * allocate(std::size_t & size)
+    {
+        return ::operator new(size);
+    }
+
+    void deallocate(void * p, std::size_t)
+    {
+        ::operator delete(p);
+    }
+};
+
+template<bool prefault = false, bool lock_memory = false>
+struct huge_page_slab_allocator
+{
+    // The default huge page size of x86-64 and of arm64 with 4K pages.
+    static const std::size_t huge_page_size = 2 * 1024 * 1024;
+
+    void * allocate(std::size_t & size)
+    {
+#ifdef __linux__
+        void * p = MAP_FAILED;
+        if (size >= huge_page_size)
+        {
+            auto hugeSize = round_up(size, huge_page_size);
+            p = mmap(nullptr, hugeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED)
+            {
+                size = hugeSize;
+            }
+        }
+
+        if (p == MAP_FAILED)
+        {
+            p = map_aligned(size);
+            // Advice only. Fails harmlessly where transparent huge pages are off.
+            madvise(p, size, MADV_HUGEPAGE);
+        }
+
+        if (prefault)
+        {
+            // A write per page, since a read maps the shared zero page instead.
+            auto pPage = static_cast<volatile char *>(p);
+            for (std::size_t offset = 0; offset < size; offset += page_size())
+            {
+                pPage[offset] = 0;
+            }
+        }
+
+        if (lock_memory && mlock(p, size) != 0)
+        {
+            m_lockFailures++;
+        }
+        return p;
+#else
+        return ::operator new(size);
+#endif
+    }
+
+    void deallocate(void * p, std::size_t size)
+    {
+#ifdef __linux__
+        // munmap also unlocks.
+        munmap(p, size);
+#else
+        ::operator delete(p);
+#endif
+    }
+
+    // True if lock_memory and every slab allocated so far is locked in memory.
+    bool locked() const
+    {
+#ifdef __linux__
+        return lock_memory && !m_lockFailures;
+#else
+        return false;
+#endif
+    }
+
+    // Slabs that could not be locked, eg. beyond RLIMIT_MEMLOCK.
+    std::size_t lock_failures() const
+    {
+        return m_lockFailures;
+    }
+
+private:
+#ifdef __linux__
+    // Normal pages. A slab of at least a huge page starts on a huge page boundary and is
+    // whole huge pages, so that transparent huge pages can back all of it.
+    static void * map_aligned(std::size_t & size)
+    {
+        if (size < huge_page_size)
+        {
+            size = round_up(size, page_size());
+            auto p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED)
+            {
+                throw std::bad_alloc();
+            }
+            return p;
+        }
+
+        size = round_up(size, huge_page_size);
+        auto mappedSize = size + huge_page_size;
+        auto p = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+
+        auto addr = reinterpret_cast<std::uintptr_t>(p);
+        auto aligned = round_up(addr, huge_page_size);
+        auto head = aligned - addr;
+        auto tail = mappedSize - head - size;
+        if (head)
+        {
+            munmap(p, head);
+        }
+        if (tail)
+        {
+            munmap(reinterpret_cast<char *>(aligned) + size, tail);
+        }
+        return reinterpret_cast<void *>(aligned);
+    }
+
+    static std::size_t page_size()
+    {
+        static const std::size_t size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        return size;
+    }
+#endif
+
+    static std::size_t round_up(std::size_t n, std::size_t multiple)
+    {
+        return (n + multiple - 1) / multiple * multiple;
+    }
+
+    std::size_t m_lockFailures = 0;
+};
+
+}
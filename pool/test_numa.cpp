@@ -0,0 +1,173 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread -march=native test_numa.cpp -latomic
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "numa.h"
+#include "object_pool.h"
+#include "../queue/queue.h"
+#include "../topology/simulated_sysfs.h"
+
+#include <iostream>
+#include <future>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <stdexcept>
+
+using std::cout;
+using std::vector;
+using std::string;
+using std::logic_error;
+using std::flush;
+using std::future;
+namespace chrono = std::chrono;
+
+using lockfree::cpu_topology;
+using lockfree::simulated_sysfs;
+using lockfree::numa_slab_allocator;
+using lockfree::numa_pools;
+using lockfree::make_on_node;
+
+using numa_queue = lockfree::queue<int, lockfree::spin_lock, lockfree::no_backoff, numa_slab_allocator>;
+
+bool testcase_sanity()
+{
+    bool bResult = false;
+    try
+    {
+        // A node the machine does not have falls back to first touch.
+        numa_slab_allocator allocator(5);
+        std::size_t size = 100;
+        auto p = static_cast<char *>(allocator.allocate(size));
+        if (size < 100 || size != numa_slab_allocator::mapped_size(100)) throw logic_error("unexpected mapped size.");
+        p[0] = 1;
+        p[size - 1] = 1;
+        allocator.deallocate(p, size);
+
+        simulated_sysfs sysfs({ "0-1", "2-3" });
+        cpu_topology t(sysfs.root());
+
+        numa_pools<lockfree::basic_object_pool<int, lockfree::no_backoff, numa_slab_allocator>> pools(t, 64, 64, 8);
+        if (pools.node_count() != 2) throw logic_error("not a pool per node.");
+        if (&pools.local() != &pools.of_node(t.current_node())) throw logic_error("local pool not that of the current node.");
+        for (unsigned int node = 0; node < pools.node_count(); ++node)
+        {
+            auto & pool = pools.of_node(node);
+            if (pool.capacity() != 64) throw logic_error("initial capacity not preallocated.");
+            auto pItem = pool.acquire(static_cast<int>(node));
+            if (*pItem != static_cast<int>(node)) throw logic_error("object not constructed.");
+            pool.release(pItem);
+        }
+
+        // control words and nodes of a queue on node 1.
+        auto q = make_on_node<numa_queue>(1, 1024, numa_slab_allocator(1));
+        if (reinterpret_cast<std::uintptr_t>(q.get()) % 4096 != 0) throw logic_error("queue not in memory of its own.");
+        for (int i = 0; i < 2000; ++i)
+        {
+            q->push(i);
+        }
+        int item = -1;
+        for (int i = 0; i < 2000; ++i)
+        {
+            if (!q->pop(item) || item != i) throw logic_error("not first in first out.");
+        }
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - node slab allocator, per node pools, queue placed on a node." << std::flush;
+    return bResult;
+}
+
+// Producers on node 0 push to a queue of consumers on node 1, of a simulated two node topology.
+// Reports the cost per item with the queue and its nodes on the consumer node, and with the heap.
+// On a single node box both are local, so this shows the overhead of placement, not its gain.
+template<typename queue_type>
+double ns_per_item(queue_type & q)
+{
+    static const int producers = 2;
+    static const int per_producer = 200000;
+
+    std::atomic<int> consumed{ 0 };
+    auto start = chrono::steady_clock::now();
+    vector<future<void>> vf;
+    for (int p = 0; p < producers; ++p)
+    {
+        vf.emplace_back(async(std::launch::async, [&q]() {
+            for (int i = 0; i < per_producer; ++i)
+            {
+                q.push(i);
+            }
+        }));
+    }
+    vf.emplace_back(async(std::launch::async, [&q, &consumed]() {
+        int item;
+        while (consumed.load(std::memory_order_relaxed) < producers * per_producer)
+        {
+            if (q.pop(item))
+            {
+                consumed.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }));
+    for (auto & task : vf)
+    {
+        task.wait();
+    }
+    auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    return static_cast<double>(ns) / (producers * per_producer);
+}
+
+bool testcase_simulated_placement()
+{
+    simulated_sysfs sysfs({ "0", "1" });
+    cpu_topology t(sysfs.root());
+
+    const unsigned int consumer_node = 1;
+    numa_pools<numa_queue::node_pool> pools(t, 4096);
+    numa_queue placed(pools.of_node(consumer_node));
+    auto on_node = make_on_node<numa_queue>(consumer_node, 4096, numa_slab_allocator(consumer_node));
+    lockfree::queue<int> heap(4096);
+
+    auto heap_ns = ns_per_item(heap);
+    auto pool_ns = ns_per_item(placed);
+    auto on_node_ns = ns_per_item(*on_node);
+
+    // Whether this machine binds memory to its node 0, or only places by first touch.
+    numa_slab_allocator probe;
+    std::size_t size = 1;
+    auto p = probe.allocate(size);
+    bool binds = numa_slab_allocator::bind(p, size, 0);
+    probe.deallocate(p, size);
+
+    cout << "\n success";
+    cout << " : simulated placement test - " << t.node_count() << " nodes, mbind " << (binds ? "available" : "not available")
+        << ", ns per item: heap " << heap_ns << ", consumer node pool " << pool_ns << ", queue on consumer node " << on_node_ns << "." << std::flush;
+    return true;
+}
+
+#define RUN_TEST(...) { if (!(__VA_ARGS__)) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity());
+    RUN_TEST(testcase_simulated_placement());
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
@@ -0,0 +1,299 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread -march=native test_object_pool.cpp -latomic
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "object_pool.h"
+#include "../queue/queue.h"
+
+#include <iostream>
+#include <future>
+#include <vector>
+#include <set>
+#include <chrono>
+#include <string>
+#include <stdexcept>
+
+using std::cout;
+using std::vector;
+using std::string;
+using std::logic_error;
+using std::flush;
+using std::future;
+
+using lockfree::object_pool;
+using lockfree::huge_page_slab_allocator;
+namespace chrono = std::chrono;
+
+struct msg
+{
+    static std::atomic<int> live;
+
+    msg(int i, const string & t) : id(i), text(t)
+    {
+        live++;
+    }
+
+    ~msg()
+    {
+        live--;
+    }
+
+    int id;
+    string text;
+};
+
+std::atomic<int> msg::live{ 0 };
+
+bool testcase_sanity()
+{
+    bool bResult = false;
+    try
+    {
+        object_pool<msg> pool(0, 64, 8);
+        if (pool.capacity() != 0) throw logic_error("capacity not zero initially.");
+
+        auto p = pool.acquire(7, "seven");
+        if (p->id != 7 || p->text != "seven") throw logic_error("object not constructed with the arguments.");
+        if (msg::live != 1) throw logic_error("unexpected live count after acquire.");
+        if (pool.capacity() != 64) throw logic_error("pool did not grow by one slab.");
+
+        pool.release(p);
+        if (msg::live != 0) throw logic_error("object not destroyed on release.");
+
+        // the cache of this thread hands back the block just released.
+        auto q = pool.acquire(8, "eight");
+        if (q != p) throw logic_error("released block not reused.");
+        pool.release(q);
+
+        vector<msg *> objects;
+        for (int i = 0; i < 200; ++i)
+        {
+            objects.push_back(pool.acquire(i, "x"));
+        }
+        if (std::set<msg *>(objects.begin(), objects.end()).size() != objects.size()) throw logic_error("block handed out twice.");
+        if (pool.capacity() != 256) throw logic_error("pool did not grow slab by slab.");
+        for (auto pObject : objects)
+        {
+            pool.release(pObject);
+        }
+        if (msg::live != 0) throw logic_error("objects not destroyed on release.");
+
+        // no per-thread cache.
+        object_pool<msg> uncached(10, 4, 0);
+        if (uncached.capacity() != 12) throw logic_error("initial capacity not preallocated in whole slabs.");
+        if (uncached.per_cpu()) throw logic_error("per cpu free lists in use though not opted in.");
+        vector<msg *> few;
+        for (int i = 0; i < 12; ++i)
+        {
+            few.push_back(uncached.acquire(i, "y"));
+        }
+        if (uncached.capacity() != 12) throw logic_error("preallocated blocks not used first.");
+        for (auto pObject : few)
+        {
+            uncached.release(pObject);
+        }
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - acquire, release, slab growth and reuse." << std::flush;
+    return bResult;
+}
+
+// Producers acquire, consumers release. Blocks flow back to producers through the global list.
+bool testcase_producer_consumer(unsigned int cache_size, bool per_cpu_free_lists = false)
+{
+    static const int producers = 3;
+    static const int consumers = 3;
+    static const int per_producer = 100000;
+
+    object_pool<msg> pool(0, 256, cache_size, lockfree::heap_slab_allocator(), per_cpu_free_lists);
+    lockfree::queue<msg *> q;
+    std::atomic<int> consumed{ 0 };
+    std::atomic<bool> corrupt{ false };
+
+    vector<future<void>> vf;
+    for (int t = 0; t < producers; ++t)
+    {
+        vf.emplace_back(async(std::launch::async, [&pool, &q, t]() {
+            for (int i = 0; i < per_producer; ++i)
+            {
+                q.push(pool.acquire(t * per_producer + i, "m"));
+            }
+        }));
+    }
+    for (int t = 0; t < consumers; ++t)
+    {
+        vf.emplace_back(async(std::launch::async, [&pool, &q, &consumed, &corrupt]() {
+            msg * p;
+            while (consumed.load() < producers * per_producer)
+            {
+                if (q.pop(p))
+                {
+                    if (p->text != "m") corrupt.store(true);
+                    pool.release(p);
+                    consumed++;
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }));
+    }
+    for (auto & task : vf)
+    {
+        task.wait();
+    }
+
+    // Memory tracks the backlog, not the total count of objects.
+    bool failed = corrupt.load() || (msg::live != 0) || (pool.capacity() >= static_cast<std::size_t>(producers) * per_producer);
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : producer consumer test - cache size " << cache_size << (pool.per_cpu() ? " with per cpu free lists" : "") << ", capacity " << pool.capacity()
+        << " for " << producers * per_producer << " objects." << std::flush;
+    return !failed;
+}
+
+// A new thread reuses the cache, and the blocks in it, of a thread that exited.
+bool testcase_thread_exit()
+{
+    object_pool<msg> pool(0, 16, 16);
+
+    auto churn = [&pool]() {
+        vector<msg *> objects;
+        for (int i = 0; i < 16; ++i)
+        {
+            objects.push_back(pool.acquire(i, "z"));
+        }
+        for (auto pObject : objects)
+        {
+            pool.release(pObject);
+        }
+    };
+
+    std::thread(churn).join();
+    auto capacity = pool.capacity();
+    for (int i = 0; i < 10; ++i)
+    {
+        std::thread(churn).join();
+    }
+
+    bool failed = (pool.capacity() != capacity);
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : thread exit test - caches of exited threads are reused." << std::flush;
+    return !failed;
+}
+
+// Reports the cost of the first pushes into a queue preallocated for them. Not a pass or fail criterion.
+template<typename queue_type>
+double first_push_ns_per_item(int items)
+{
+    queue_type q(items);
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < items; ++i)
+    {
+        q.push(i);
+    }
+    auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    return static_cast<double>(ns) / items;
+}
+
+// Slabs mapped with huge pages where possible, else normal pages, pre-faulted and locked.
+bool testcase_huge_pages()
+{
+    static const int items = 1 << 18;
+
+    bool bResult = false;
+    try
+    {
+        lockfree::basic_object_pool<msg, lockfree::no_backoff, huge_page_slab_allocator<true, true>> pool(100000, 256, 32);
+        if (pool.capacity() != 100096) throw logic_error("initial capacity not preallocated in whole slabs.");
+
+        vector<msg *> objects;
+        for (int i = 0; i < 100000; ++i)
+        {
+            objects.push_back(pool.acquire(i, "h"));
+        }
+        if (pool.capacity() != 100096) throw logic_error("preallocated blocks not used first.");
+        if (std::set<msg *>(objects.begin(), objects.end()).size() != objects.size()) throw logic_error("block handed out twice.");
+        for (auto pObject : objects)
+        {
+            pool.release(pObject);
+        }
+        if (msg::live != 0) throw logic_error("objects not destroyed on release.");
+        auto & allocator = pool.get_slab_allocator();
+        bool locked = allocator.locked();
+        if (locked == (allocator.lock_failures() != 0)) throw logic_error("lock state inconsistent.");
+
+        // A slab of a few huge pages starts on a huge page boundary, so that all of it can be backed by huge pages.
+        huge_page_slab_allocator<> unlocked;
+        const auto huge_page_size = huge_page_slab_allocator<>::huge_page_size;
+        std::size_t size = 3 * huge_page_size + 100;
+        auto p = static_cast<char *>(unlocked.allocate(size));
+        if (reinterpret_cast<std::uintptr_t>(p) % huge_page_size != 0) throw logic_error("slab not huge page aligned.");
+        if (size != 4 * huge_page_size) throw logic_error("slab not whole huge pages.");
+        p[0] = 1;
+        p[size - 1] = 1;
+        unlocked.deallocate(p, size);
+        if (unlocked.locked()) throw logic_error("slab reported locked without lock_memory.");
+
+        // grows past the initial slab.
+        lockfree::queue<int, lockfree::spin_lock, lockfree::no_backoff, huge_page_slab_allocator<true>> q(16);
+        for (int i = 0; i < 1000; ++i)
+        {
+            q.push(i);
+        }
+        int item = -1;
+        for (int i = 0; i < 1000; ++i)
+        {
+            if (!q.pop(item) || item != i) throw logic_error("not first in first out.");
+        }
+
+        auto heap_ns = first_push_ns_per_item<lockfree::queue<int>>(items);
+        auto huge_ns = first_push_ns_per_item<lockfree::queue<int, lockfree::spin_lock, lockfree::no_backoff, huge_page_slab_allocator<true>>>(items);
+
+        cout << "\n success";
+        bResult = true;
+        cout << " : huge pages test - pre-faulted slabs, huge page aligned, " << (locked ? "locked" : "not locked")
+            << ", first push ns per item: heap " << heap_ns << ", huge pages " << huge_ns << ".";
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+        cout << " : huge pages test - pre-faulted slabs.";
+    }
+
+    cout << std::flush;
+    return bResult;
+}
+
+#define RUN_TEST(...) { if (!(__VA_ARGS__)) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity());
+    RUN_TEST(testcase_producer_consumer(32));
+    RUN_TEST(testcase_producer_consumer(0));
+    RUN_TEST(testcase_producer_consumer(0, true));
+    RUN_TEST(testcase_thread_exit());
+    RUN_TEST(testcase_huge_pages());
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
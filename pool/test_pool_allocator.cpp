@@ -0,0 +1,141 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread -march=native test_pool_allocator.cpp -latomic
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "pool_allocator.h"
+
+#include <iostream>
+#include <future>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <stdexcept>
+
+using std::cout;
+using std::list;
+using std::map;
+using std::unordered_map;
+using std::vector;
+using std::string;
+using std::logic_error;
+using std::flush;
+using std::future;
+
+using lockfree::pool_allocator;
+
+using pooled_list = list<string, pool_allocator<string>>;
+using pooled_map = map<int, string, std::less<int>, pool_allocator<std::pair<const int, string>>>;
+using pooled_unordered_map = unordered_map<int, int, std::hash<int>, std::equal_to<int>, pool_allocator<std::pair<const int, int>>>;
+
+bool testcase_sanity()
+{
+    bool bResult = false;
+    try
+    {
+        pooled_list l;
+        for (int i = 0; i < 1000; ++i)
+        {
+            l.push_back(std::to_string(i));
+        }
+        l.remove_if([](const string & s) { return s.size() == 2; });
+        if (l.size() != 910) throw logic_error("unexpected list size.");
+        if (l.front() != "0" || l.back() != "999") throw logic_error("unexpected list contents.");
+
+        pooled_map m;
+        for (int i = 0; i < 1000; ++i)
+        {
+            m[i] = std::to_string(i * i);
+        }
+        for (int i = 0; i < 1000; i += 2)
+        {
+            m.erase(i);
+        }
+        if (m.size() != 500 || m[31] != "961") throw logic_error("unexpected map contents.");
+
+        pooled_unordered_map um;
+        for (int i = 0; i < 1000; ++i)
+        {
+            um[i] = -i;
+        }
+        if (um.size() != 1000 || um[999] != -999) throw logic_error("unexpected unordered_map contents.");
+
+        // Allocators of different types compare equal, so splice across lists is allowed.
+        pooled_list other;
+        other.splice(other.end(), l);
+        if (!l.empty() || other.size() != 910) throw logic_error("splice failed.");
+        if (pool_allocator<int>() != pool_allocator<string>()) throw logic_error("allocators not equal.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - list, map and unordered_map with pooled nodes." << std::flush;
+    return bResult;
+}
+
+// Nodes allocated in one thread are freed in another.
+bool testcase_cross_thread()
+{
+    static const int threads = 4;
+    static const int items = 20000;
+
+    vector<pooled_map> maps(threads);
+    vector<future<void>> fill;
+    for (int t = 0; t < threads; ++t)
+    {
+        fill.emplace_back(async(std::launch::async, [&maps, t]() {
+            for (int i = 0; i < items; ++i)
+            {
+                maps[t][i] = "v";
+            }
+        }));
+    }
+    for (auto & task : fill)
+    {
+        task.wait();
+    }
+
+    bool failed = false;
+    vector<future<bool>> drain;
+    for (int t = 0; t < threads; ++t)
+    {
+        // each map is cleared by a thread other than the one that filled it.
+        drain.emplace_back(async(std::launch::async, [&maps, t]() {
+            auto & m = maps[(t + 1) % threads];
+            bool ok = (m.size() == static_cast<std::size_t>(items));
+            m.clear();
+            return ok;
+        }));
+    }
+    for (auto & task : drain)
+    {
+        failed = !task.get() || failed;
+    }
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : cross thread test - map nodes freed by other threads." << std::flush;
+    return !failed;
+}
+
+#define RUN_TEST(testcase) { if (!testcase()) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity);
+    RUN_TEST(testcase_cross_thread);
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
@@ -0,0 +1,325 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <stdexcept>
+#include <cstddef>
+#include <cstdint>
+
+#include "../mutex/spin_lock.h"
+#include "../backoff/backoff.h"
+#include "../trace/trace_point.h"
+
+using std::cerr;
+using std::memory_order_relaxed;
+using std::memory_order_consume;
+using std::memory_order_acquire;
+using std::memory_order_release;
+
+// Intrusive lock free queue implementation in C++11.
+// Note: The queued objects are linked through a hook they embed, so no node storage exists.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread -march=native
+//      arch option is needed because older architectures don't support 16 byte atomic.
+
+/*
+Notes:
+T must have a public member
+    T * pPrevious;
+which the queue owns while the object is queued. An object can be in one intrusive queue at a time.
+push(p) links the object itself, and pop() returns it, or nullptr if the queue is empty.
+push(pFirst, pLast) pushes a chain of objects, linked from pLast through pPrevious down to pFirst,
+with a single compare and swap, as if pushed one by one from pFirst to pLast.
+pop(max_count, count) pops a run of up to max_count objects, as if popped one by one,
+with a single compare and swap on the pop list, or from a refill. It returns the first object,
+and the run is linked from it through pPrevious.
+So there is no allocation, and no node to miss in cache besides the object.
+queue.h is this queue over nodes drawn from an object_pool, that hold a copy of the item.
+
+Design:
+As in queue.h. Producers push onto a push list. Consumers pop from a pop list.
+When the pop list is empty, a consumer takes the refill lock, moves the whole push list,
+reverses it into FIFO order, keeps the first object, or the first run, and refills the pop list with the rest.
+The pop list head is an object pointer and a sequence number swapped with a 16 byte compare and swap.
+The sequence number is incremented on refill, so an object popped and queued again
+cannot fool a pop that read it before, since it can only be back at the top after a refill.
+The refill path is serialized by a lock chosen through the refill_lock_type policy parameter.
+The backoff policy from backoff.h is applied in every compare and swap retry loop.
+Compare and swap retries and refills are trace points of trace_point.h, off unless LOCKFREE_TRACE is defined.
+
+Type-stable memory:
+A pop reads the pPrevious hook of the object at the top of the pop list.
+Another consumer may pop that object in between, and the application may then reuse it,
+so the read may see any value; the sequence number makes the compare and swap fail then.
+But the memory must still be readable. So an object popped from the queue must not be
+returned to the operating system while other threads may still pop from the queue.
+Objects from an object_pool, which keeps its slabs until it is destroyed, or from
+any other type-stable storage meet this. Objects deleted with delete may not.
+pop(max_count, count) also follows the pPrevious hooks of the run before its compare and swap,
+so the hook of a popped object must hold nullptr or another such object, whatever the application
+does with the object after. The blocks of an object_pool, free or not, meet this too.
+Then the run is what the hooks said if the compare and swap succeeds, since the pop list only changes
+by pops at its top, and by refills, which bump the sequence number.
+*/
+namespace lockfree
+{
+
+template<typename T, typename refill_lock_type = spin_lock, typename backoff = no_backoff>
+class intrusive_queue
+{
+public:
+    intrusive_queue()
+    {
+    }
+
+    intrusive_queue(const intrusive_queue &) = delete;
+    intrusive_queue & operator=(const intrusive_queue &) = delete;
+
+    void push(T * pObject)
+    {
+        m_pushList.push(pObject, pObject);
+    }
+
+    // pLast must lead to pFirst through pPrevious. The pPrevious of pFirst is overwritten.
+    void push(T * pFirst, T * pLast)
+    {
+        m_pushList.push(pFirst, pLast);
+    }
+
+    // Returns nullptr if empty.
+    T * pop()
+    {
+        std::size_t count;
+        return pop(1, count);
+    }
+
+    // Pops up to max_count objects. Returns the first object, nullptr if empty, and the count popped in count.
+    // The run is linked from the returned object through pPrevious. The pPrevious of its last object is left as is,
+    // so walk count objects, not up to nullptr.
+    T * pop(std::size_t max_count, std::size_t & count)
+    {
+        T * pObject = nullptr;
+        if (!(pObject = m_popList.pop(max_count, count)) && max_count)
+        {
+            // Acquire refillLock.
+            // Note:  This is not a system call lock. This is a 'lock-free' spinlock.
+            //             Using spinlock avoids any system call latency because expected spin is shorter than system call latency.
+            m_refillLock.lock();
+
+            // A refill might have happened by the time refillLock was acquired.
+            // So try pop again.
+            if (!(pObject = m_popList.pop(max_count, count)))
+            {
+                if (pObject = m_pushList.move())
+                {
+                    // reverse list.
+                    pObject = reverseList(pObject);
+
+                    // keep the first run.
+                    auto pLast = pObject;
+                    count = 1;
+                    while (count < max_count && pLast->pPrevious)
+                    {
+                        pLast = pLast->pPrevious;
+                        ++count;
+                    }
+
+                    auto refillList = pLast->pPrevious;
+                    if (refillList)
+                    {
+                        m_popList.refill(refillList);
+                        LOCKFREE_TRACE_EVENT(queue_refill, 0);
+                    }
+                }
+            }
+
+            // Release refillLock.
+            // refill_lock_type uses acquire/ release memory order to ensure proper sequencing with popList access.
+            m_refillLock.unlock();
+        }
+
+        return pObject;
+    }
+
+private:
+    // Reverses a node list.
+    // argument pNode must not be nullptr.
+    T * reverseList(T *pNode)
+    {
+        T * next = nullptr;
+        auto current = pNode;
+
+        do
+        {
+            auto previous = current->pPrevious;
+            current->pPrevious = next;
+
+            next = current;
+            current = previous;
+        } while (current);
+
+        return next;
+    }
+
+    //
+    // A list of nodes you can push to.
+    //
+    class node_push_list
+    {
+    public:
+        node_push_list() : m_top{nullptr}
+        {
+        }
+
+        void push(T * pFirst, T * pLast)
+        {
+            auto newtop = pLast;
+
+            // memory_order_relaxed due to no following dereferencing of top.
+            auto top = m_top.load(memory_order_relaxed);
+
+            backoff wait_retry;
+            for (;;)
+            {
+                pFirst->pPrevious = top;
+
+                // memory_order_release on success due to node need to be pop ready for another thread.
+                // memory_order_relaxed on failure due to no following dereferencing of top.
+                if (m_top.compare_exchange_weak(top, newtop, memory_order_release, memory_order_relaxed))
+                {
+                    break;
+                }
+                LOCKFREE_TRACE_EVENT(queue_cas_retry, 0);
+                wait_retry();
+            }
+        }
+
+        T * move()
+        {
+            // memory_order_consume due to this operation being equivalent to pop all.
+            return m_top.exchange(nullptr, memory_order_consume);
+        }
+
+    private:
+        std::atomic<T *> m_top;
+    };
+
+    //
+    // A list of nodes you can pop from.
+    //
+    class node_pop_list
+    {
+    public:
+        node_pop_list() : m_top{ nullptr }
+        {
+            if (!m_top.is_lock_free())
+            {
+                cerr << "\nFalling back to lock based implementation of lockfree::queue.";
+            }
+        }
+
+        // Make sure at the time refill() is called list is empty.
+        // Make sure only one thread calls refill() at a time.
+        void refill(T * pNode)
+        {
+            // memory_order_relaxed due to no following dereferencing of top.
+            auto top = m_top.load(memory_order_relaxed);
+
+            if (top.pNode)
+            {
+                throw std::logic_error("refill() called when list not empty.");
+            }
+
+            head newtop;
+            newtop.pNode = pNode;
+            newtop.seqNum = top.seqNum + 1;
+
+            // memory_order_release on success due to node need to be pop ready for another thread.
+            // memory_order_relaxed on failure due to no following dereferencing of top.
+            if (!m_top.compare_exchange_strong(top, newtop, memory_order_release, memory_order_relaxed))
+            {
+                throw std::logic_error("refill() called by more than one thread at a time.");
+            }
+        }
+
+        // Pops up to max_count objects, see intrusive_queue::pop(max_count, count).
+        T * pop(std::size_t max_count, std::size_t & count)
+        {
+            count = 0;
+            if (!max_count)
+            {
+                return nullptr;
+            }
+
+            // memory_order_consume due to following dependent load operation top.pNode->pPrevious.
+            auto top = m_top.load(memory_order_consume);
+
+            head newtop;
+
+            backoff wait_retry;
+            while (top.pNode)
+            {
+                auto pLast = top.pNode;
+                count = 1;
+                while (count < max_count && pLast->pPrevious)
+                {
+                    pLast = pLast->pPrevious;
+                    ++count;
+                }
+                newtop.pNode = pLast->pPrevious;
+                newtop.seqNum = top.seqNum;
+
+                // memory_order_consume on failure due to following dependent load operation top.pNode->pPrevious.
+                //      Note: Dependent load allows faster memory_order_consume to be used instead of memory_order_release.
+                // memory_order_relaxed on success due to top actually read by the previous atomic operation, not the current one.
+                //      Note: However success cannot specify weaker ordering than failure until C++17.
+                if (m_top.compare_exchange_weak(top, newtop, memory_order_relaxed, memory_order_consume))
+                {
+                    break;
+                }
+                LOCKFREE_TRACE_EVENT(queue_cas_retry, 0);
+                wait_retry();
+            }
+
+            if (!top.pNode)
+            {
+                count = 0;
+            }
+            return top.pNode;
+        }
+
+    private:
+        struct head
+        {
+            T * pNode;
+            // Pointer sized, so that the struct has no padding bytes.
+            // compare_exchange compares padding bytes too, which are not preserved on copy.
+            std::uintptr_t seqNum;
+
+            head(T * p) : pNode(p), seqNum(0)
+            {
+            }
+
+            // for default initialization.
+            head()
+            {
+            }
+        };
+
+        std::atomic<head> m_top;
+    };
+
+    node_push_list m_pushList;
+    node_pop_list m_popList;
+
+    refill_lock_type m_refillLock;
+};
+
+}
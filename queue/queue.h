@@ -6,15 +6,15 @@
 
 #pragma once
 
-#include <iostream>
-#include <atomic>
-#include <stdexcept>
+#include <cstddef>
+#include <memory>
+#include <new>
 
-using std::cerr;
-using std::memory_order_relaxed;
-using std::memory_order_consume;
-using std::memory_order_acquire;
-using std::memory_order_release;
+#include "intrusive_queue.h"
+#include "../mutex/spin_lock.h"
+#include "../pool/object_pool.h"
+#include "../util/item_ops.h"
+#include "../backoff/backoff.h"
 
 // Lock free queue implementation in C++11.
 // Queue can grow in size unbounded.
@@ -25,30 +25,69 @@ using std::memory_order_release;
 
 /*
 Notes:
-This implementation uses its own free list to avoid any locking by the memory allocator you happen to use.
+This implementation draws nodes from an object_pool to avoid any locking by the memory allocator you happen to use.
+    Popped nodes go back to the pool, so memory tracks the backlog.
+    By default a queue has a pool of its own. Queues of the same type can instead share a node_pool
+    passed at construction, eg. thousands of mailboxes, so that memory tracks their total backlog,
+    rather than the sum of their peaks and initial capacities. A shared pool has per-thread caches,
+    so a thread that both pops and pushes reuses its own nodes, warm in its cache.
+    The slab_allocator policy parameter of the pool, from slab_allocator.h, can back the nodes with huge pages,
+    pre-faulted at construction, eg. for a queue with a large initial_capacity.
+    Opt in with per_cpu_free_lists, and where restartable sequences are available the own pool recycles
+    nodes through per-cpu free lists, see percpu_stack.h, with no 16 byte compare and swap.
+    They take a cache line per cpu, so they are off by default, eg. for many small mailboxes.
+The nodes are linked by an intrusive_queue from intrusive_queue.h, which has the lock free lists.
 This implementation adds a sequence number to the atomic list head when the list is used for popping.
     The sequence number is incremented on push. This makes the list changed check stronger.
+The refill path is serialized by a lock chosen through the refill_lock_type policy parameter.
+    Default is spin_lock. Use mcs_lock or clh_lock from the mutex folder when many consumers
+    contend on refill, so that each waiter spins on its own cache line.
+The backoff policy from backoff.h is applied in every compare and swap retry loop.
+    The refill lock has its own backoff policy parameter.
+Compare and swap retries and refills are trace points of trace_point.h, off unless LOCKFREE_TRACE is defined.
 
 Other notes:
 1. Cannot use a preallocated array as storage for queue elements because
     say for push,
     copy element and then atomic push will not work because copy can race,
     atomic push and then copy element will not work because pop can happen while copy.
-2. Since the nodes don't get deleted at pop, but goes to a free list, we must call
+2. Since the nodes don't get deleted at pop, but go back to the pool, we must call
     the element destructor manually. This is important if the queue is used to store
     smart pointers since the queue must not hold references to elements after pop.
 3. Since the nodes don't always get allocated at push, we must do in-place copy
     construction manually. We cannot use assignment because assignment needs a
     previously constructed object.
+4. For a trivially copyable T, item_ops from item_ops.h copies the bytes instead, and there is
+    no destructor to call. push(items, count) links the nodes of all the items first and pushes
+    them with a single compare and swap. pop(items, max_count) pops a run of up to max_count nodes
+    with a single compare and swap, see intrusive_queue.h, then moves the items out one by one.
 */
 namespace lockfree
 {
 
-template<typename T>
+template<typename T, typename refill_lock_type = spin_lock, typename backoff = no_backoff, typename slab_allocator = heap_slab_allocator>
 class queue
 {
+    struct node
+    {
+        node * pPrevious;
+        T item;
+    };
+
 public:
-    queue(unsigned int initial_capacity = 64): m_freeList(initial_capacity)
+    // Pool of nodes that queues of the same type can share.
+    using node_pool = basic_object_pool<node, backoff, slab_allocator>;
+
+    // Draws nodes from a pool of its own, without per-thread caches, preallocated with initial_capacity nodes.
+    // The pool gets its slabs from allocator. per_cpu_free_lists, off by default, is that of basic_object_pool.
+    queue(unsigned int initial_capacity = 64, const slab_allocator & allocator = slab_allocator(), bool per_cpu_free_lists = false):
+        m_pOwnPool(new node_pool(initial_capacity, own_pool_slab_size, 0, allocator, per_cpu_free_lists)),
+        m_pool(*m_pOwnPool)
+    {
+    }
+
+    // Draws nodes from the given pool, which must outlive the queue.
+    explicit queue(node_pool & pool): m_pool(pool)
     {
     }
 
@@ -61,54 +100,26 @@ public:
     // Makes a copy of T internally. This allows proper object lifetime management. T can also be a smart pointer.
     void push(const T & item)
     {
-        auto pNode = m_freeList.pop();
+        auto pNode = static_cast<node *>(m_pool.allocate());
 
         // in-place copy construction
-        new (&(pNode->item)) T(item);
+        ops::construct(&(pNode->item), item);
 
-        m_pushList.push(pNode);
+        m_nodes.push(pNode);
     }
 
-    // Copies T on return. This allows queue to manage of its own internal storage.
+    // Moves T to the client on return. This allows queue to manage of its own internal storage.
     bool pop(T &item)
     {
-        node * pNode = nullptr;
-        if (!(pNode = m_popList.pop()))
-        {
-            // Acquire refillLock. 
-            // Note:  This is not a system call lock. This is a 'lock-free' compare and swap operation.
-            //             Using spinlock avoids any system call latency because expected spin is shorter than system call latency.
-            while (m_refillLock.test_and_set(memory_order_acquire));
-
-            // A refill might have happened by the time refillLock was acquired.
-            // So try pop again.
-            if (!(pNode = m_popList.pop()))
-            {
-                if (pNode = m_pushList.move())
-                {
-                    // reverse list.
-                    pNode = reverseList(pNode);
-
-                    auto refillList = pNode->pPrevious;
-                    if (refillList)
-                    {
-                        m_popList.refill(refillList);
-                    }
-                }
-            }
-
-            // Release refillLock.
-            // Using acquire/ release memory order for refillLock to ensure proper sequencing with popList access.
-            m_refillLock.clear(memory_order_release);
-        }
-        
+        auto pNode = m_nodes.pop();
         if (pNode)
         {
-            // copy to client.
-            item = pNode->item;
+            // move to client, and destruct internal copy without freeing memory.
+            ops::move_out(item, &(pNode->item));
 
-            // destruct internal copy without freeing memory.
-            pNode->item.~T();
+            // A popper that read this node before it was popped only fails its compare and swap on it,
+            // since the node cannot be back at the top of the pop list without a refill, which bumps seqNum.
+            m_pool.deallocate(pNode);
 
             return true;
         }
@@ -118,264 +129,79 @@ public:
         }
     }
 
-private:
-    struct node
-    {
-        node * pPrevious;
-        T item;
-    };
-
-    // Reverses a node list.
-    // argument pNode must not be nullptr.
-    node * reverseList(node *pNode)
-    {
-        node * next = nullptr;
-        auto current = pNode;
-
-        do
-        {
-            auto previous = current->pPrevious;
-            current->pPrevious = next;
-
-            next = current;
-            current = previous;
-        } while (current);
-
-        return next;
-    }
-
-    //
-    // A list of nodes you can push to.
-    //
-    class node_push_list
-    {
-    public:
-        node_push_list() : m_top{nullptr}
-        {
-        }
-
-        void push(node * pNode)
-        {
-            auto newtop = pNode;
-
-            // memory_order_relaxed due to no following dereferencing of top.
-            auto top = m_top.load(memory_order_relaxed);
-
-            do
-            {
-                newtop->pPrevious = top;
-            } while (!m_top.compare_exchange_weak(top, newtop, memory_order_release, memory_order_relaxed));
-            // memory_order_release on success due to node need to be pop ready for another thread.
-            // memory_order_relaxed on failure due to no following dereferencing of top.
-        }
-
-        node * move()
-        {
-            // memory_order_consume due to this operation being equivalent to pop all.
-            return m_top.exchange(nullptr, memory_order_consume);
-        }
-
-    private:
-        std::atomic<node *> m_top;
-    };
-
-    //
-    // A list of nodes you can pop from.
-    //
-    class node_pop_list
+    // Pushes count items in order, with a single compare and swap.
+    // If a copy constructor throws, the items before the failing one are pushed.
+    void push(const T * items, std::size_t count)
     {
-    public:
-        node_pop_list() : m_top{ nullptr }
-        {
-        }
-
-        // Make sure at the time refill() is called list is empty.
-        // Make sure only one thread calls refill() at a time.
-        void refill(node * pNode)
+        node * pFirst = nullptr;
+        node * pLast = nullptr;
+        try
         {
-            // memory_order_relaxed due to no following dereferencing of top.
-            auto top = m_top.load(memory_order_relaxed);
-
-            if (top.pNode)
+            for (std::size_t i = 0; i < count; ++i)
             {
-                throw std::logic_error("refill() called when list not empty.");
-            }
-
-            head newtop;
-            newtop.pNode = pNode;
-            newtop.seqNum = top.seqNum + 1;
-
-            // memory_order_release on success due to node need to be pop ready for another thread.
-            // memory_order_relaxed on failure due to no following dereferencing of top.
-            if (!m_top.compare_exchange_strong(top, newtop, memory_order_release, memory_order_relaxed))
-            {
-                throw std::logic_error("refill() called by more than one thread at a time.");
-            }
-        }
-
-        node * pop()
-        {
-            // memory_order_consume due to following dependent load operation top.pNode->pPrevious.
-            auto top = m_top.load(memory_order_consume);
-
-            head newtop;
-
-            do
-            {
-                if (top.pNode)
+                auto pNode = static_cast<node *>(m_pool.allocate());
+                try
                 {
-                    newtop.pNode = top.pNode->pPrevious;
-                    newtop.seqNum = top.seqNum;
+                    ops::construct(&(pNode->item), items[i]);
                 }
-            } while (top.pNode && (!m_top.compare_exchange_weak(top, newtop, memory_order_relaxed, memory_order_consume)));
-            // memory_order_consume on failure due to following dependent load operation top.pNode->pPrevious.
-            //      Note: Dependent load allows faster memory_order_consume to be used instead of memory_order_release.
-            // memory_order_relaxed on success due to top actually read by the previous atomic operation, not the current one.
-            //      Note: However success cannot specify weaker ordering than failure until C++17.
-
-            return top.pNode;
-        }
-
-    private:
-        struct head
-        {
-            node * pNode;
-            unsigned int seqNum;
-
-            head(node * node) : pNode(node), seqNum(0)
-            {
-            }
-
-            // for default initialization.
-            head()
-            {
-            }
-        };
-
-        std::atomic<head> m_top;
-    };
-
-    //
-    // A list of nodes you can both push to and pop from.
-    //
-    class node_list
-    {
-    public:
-        node_list() : m_top{ nullptr }
-        {
-            if (!m_top.is_lock_free())
-            {
-                cerr << "\nFalling back to lock based implementation of lockfree::queue.";
-            }
-        }
-
-        void push(node * pNode)
-        {
-            // memory_order_relaxed due to no following dereferencing of top.
-            auto top = m_top.load(memory_order_relaxed);
-
-            head newtop;
-            newtop.pNode = pNode;
-
-            do
-            {
-                pNode->pPrevious = top.pNode;
-                newtop.seqNum = top.seqNum + 1;
-            } while (!m_top.compare_exchange_weak(top, newtop, memory_order_release, memory_order_relaxed));
-            // memory_order_release on success due to node need to be pop ready for another thread.
-            // memory_order_relaxed on failure due to no following dereferencing of top.
-        }
-
-        node * pop()
-        {
-            // memory_order_consume due to following dependent load operation top.pNode->pPrevious.
-            auto top = m_top.load(memory_order_consume);
-
-            head newtop;
-
-            do
-            {
-                if (top.pNode)
+                catch (...)
                 {
-                    newtop.pNode = top.pNode->pPrevious;
-                    newtop.seqNum = top.seqNum;
+                    m_pool.deallocate(pNode);
+                    throw;
                 }
-            } while (top.pNode && (!m_top.compare_exchange_weak(top, newtop, memory_order_relaxed, memory_order_consume)));
-            // memory_order_consume on failure due to following dependent load operation top.pNode->pPrevious.
-            //      Note: Dependent load allows faster memory_order_consume to be used instead of memory_order_release.
-            // memory_order_relaxed on success due to top actually read by the previous atomic operation, not the current one.
-            //      Note: However success cannot specify weaker ordering than failure until C++17.
-
-            return top.pNode;
-        }
-
-    private:
-        struct head
-        {
-            node * pNode;
-            unsigned int seqNum;
-
-            head(node * node) : pNode(node), seqNum(0)
-            {
-            }
 
-            // for default initialization.
-            head()
-            {
+                if (pLast)
+                {
+                    pNode->pPrevious = pLast;
+                }
+                else
+                {
+                    pFirst = pNode;
+                }
+                pLast = pNode;
             }
-        };
-
-        std::atomic<head> m_top;
-    };
-
-    //
-    // A list of free nodes available to be used during push.
-    // Popped nodes are recycled to this list to be used again for push, 
-    // thus avoiding the memory allocator until a capacity increase.
-    //
-    // Note: This wrapper class on node_list makes sure pop() always returns a free node
-    //  by doing memory allocation if node_list goes empty.
-    class free_list: public node_list
-    {
-    public:
-        free_list(unsigned int initial_capacity)
+        }
+        catch (...)
         {
-            for (unsigned int i = 0; i < initial_capacity; ++i)
+            if (pLast)
             {
-                // There is no need to call constructor here. So just use malloc.
-                node_list::push(static_cast<node *>(malloc(sizeof(node))));
+                m_nodes.push(pFirst, pLast);
             }
+            throw;
         }
 
-        ~free_list()
+        if (pLast)
         {
-            node * pNode = nullptr;
-
-            while (pNode = node_list::pop())
-            {
-                free(pNode);
-            }
+            m_nodes.push(pFirst, pLast);
         }
+    }
 
-        node * pop()
+    // Pops up to max_count items into items. Returns the number popped, 0 if the queue is empty.
+    std::size_t pop(T * items, std::size_t max_count)
+    {
+        std::size_t count;
+        auto pNode = m_nodes.pop(max_count, count);
+        for (std::size_t i = 0; i < count; ++i)
         {
-            node * ret = nullptr;
+            // read before the pool reuses the link.
+            auto pNext = pNode->pPrevious;
 
-            while (!(ret = node_list::pop()))
-            {
-                // There is no need to call constructor here. So just use malloc.
-                node_list::push(static_cast<node *>(malloc(sizeof(node))));
-            }
+            ops::move_out(items[i], &(pNode->item));
+            m_pool.deallocate(pNode);
 
-            return ret;
+            pNode = pNext;
         }
-    };
+        return count;
+    }
+
+private:
+    using ops = item_ops<T>;
 
-    free_list m_freeList;
-    node_push_list m_pushList;
-    node_pop_list m_popList;
+    static const unsigned int own_pool_slab_size = 16;
 
-    std::atomic_flag m_refillLock = ATOMIC_FLAG_INIT;
+    std::unique_ptr<node_pool> m_pOwnPool;
+    node_pool & m_pool;
+    intrusive_queue<node, refill_lock_type, backoff> m_nodes;
 };
 
 }
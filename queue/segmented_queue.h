@@ -0,0 +1,682 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../stack/intrusive_stack.h"
+#include "../mutex/spin_lock.h"
+#include "../backoff/backoff.h"
+#include "../util/cache_line.h"
+#include "../util/item_ops.h"
+
+using std::cerr;
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_release;
+using std::memory_order_acq_rel;
+
+// Unrolled lock free queue implementation in C++11.
+// Note: Items are stored in segments of many items, so small items cost no node of their own.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread -march=native
+//      arch option is needed because older architectures don't support 16 byte atomic.
+
+/*
+Notes:
+queue.h allocates a node per item, a pointer next to the item, so for queue<int> or queue<void *>
+every item is a separate allocation and a cache miss. segmented_queue stores the items of
+a segment next to each other in an array, by default a cache line of them, at least 8.
+A new segment is linked only when one fills, so allocations and pointer hops drop by the
+segment size. Used segments are recycled, so memory tracks the backlog.
+The interface is that of queue.h: push(item) and pop(item), which returns false if the queue is empty.
+The backoff policy from backoff.h is applied in the consumer compare and swap retry loop.
+
+Design:
+A segment has an array of items, a state per item, an enqueue index and a dequeue index.
+push():
+    1. claim a slot of the tail segment with fetch_add on its enqueue index.
+    2. compare and swap the slot state from empty to writing, copy the item in, store ready.
+    3. if the index is past the end, the segment is full. Link a new segment after it if there is none yet,
+        swing the tail to it, and retry.
+pop():
+    1. if the dequeue index of the head segment is not below its enqueue index, the queue is empty.
+    2. claim the slot with a compare and swap that increments the dequeue index.
+        A compare and swap rather than fetch_add, so that consumers never claim slots
+        that no producer has, and an empty queue costs no slots.
+    3. wait for the slot to be ready and move the item out. A producer that claimed the slot
+        is usually only a few instructions from storing it. If it does not in a short spin,
+        eg. it was preempted, compare and swap the slot state from empty to poisoned and retry.
+        The producer then finds its slot poisoned, and retries with a new slot.
+    4. if the dequeue index is at the end, and a next segment is linked, swing the head to it.
+The slot states make sure that each slot is either taken by its consumer or poisoned, never both,
+and that no producer writes to a slot after its consumer is done with it.
+
+Segment reuse:
+A segment is recycled once all its slots are done, by their consumers, and the head has moved past it.
+A thread may still hold a pointer to a recycled segment, read from the head or tail earlier,
+so segments are type-stable; they are freed only with the queue.
+Every recycle increments the generation of the segment, which is part of its enqueue index,
+dequeue index, slot states and next link, and of the head and tail, that are a segment pointer
+and its generation swapped with a 16 byte compare and swap.
+A thread that holds a stale segment finds the generation changed, and retries:
+    a consumer, since its compare and swap of the dequeue index fails.
+    a producer, from the generation fetch_add returns. If that claimed a slot of the new generation,
+    it poisons that slot, so that the consumer of the slot does not wait for it.
+So no operation takes effect on a segment in a generation other than the one it read from the head or tail.
+
+Bulk transfer:
+push(items, count) claims as many slots as fit, up to a segment, with a single fetch_add,
+and pop(items, max_count) claims the run of slots pushed so far with a single compare and swap.
+The claimed slots are next to each other, so for a trivially copyable T, item_ops from item_ops.h
+copies them in and out with a single memcpy, and there is no destructor to call.
+If a consumer gave up on one of the slots a producer claimed, the producer poisons the slots after it too,
+and pushes the rest of the items again, so that its items stay in order.
+Small items are already stored inline in the slots. They are not packed into the slot state word,
+since the state word holds the generation of the slot.
+*/
+namespace lockfree
+{
+
+template<typename T>
+struct default_segment_size
+{
+    static const unsigned int value = (cache_line_size / sizeof(T) > 8) ? static_cast<unsigned int>(cache_line_size / sizeof(T)) : 8;
+};
+
+template<typename T, unsigned int segment_size = default_segment_size<T>::value, typename backoff = no_backoff>
+class segmented_queue
+{
+public:
+    static_assert(segment_size > 0, "segmented_queue needs at least one item per segment.");
+
+    segmented_queue()
+    {
+        auto pSegment = new_segment();
+        link first;
+        first.pSegment = pSegment;
+        first.gen = 0;
+        m_head.store(first, memory_order_relaxed);
+        m_tail.store(first, memory_order_relaxed);
+
+        if (!m_head.is_lock_free())
+        {
+            cerr << "\nFalling back to lock based implementation of lockfree::segmented_queue.";
+        }
+    }
+
+    segmented_queue(const segmented_queue &) = delete;
+    segmented_queue & operator=(const segmented_queue &) = delete;
+
+    ~segmented_queue()
+    {
+        T tempObj;
+        while (pop(tempObj));
+
+        for (auto pSegment : m_segments)
+        {
+            delete pSegment;
+        }
+    }
+
+    void push(const T & item)
+    {
+        emplace(item);
+    }
+
+    void push(T && item)
+    {
+        emplace(std::move(item));
+    }
+
+    // Pushes count items in order.
+    // If a copy constructor throws, the items before the failing one are pushed.
+    void push(const T * items, std::size_t count)
+    {
+        while (count > 0)
+        {
+            // memory_order_acquire due to the segment reset by its recycler must be visible.
+            auto tail = m_tail.load(memory_order_acquire);
+            auto pSegment = tail.pSegment;
+
+            // No more than a segment at a time, so that the index never runs into the generation bits.
+            auto claim = static_cast<unsigned int>(count < segment_size ? count : segment_size);
+
+            // memory_order_acquire due to the slot states reset by the recycler must be visible.
+            auto enq = pSegment->enq.fetch_add(claim, memory_order_acquire);
+            auto index = index_of(enq);
+            auto end = (index < segment_size - claim) ? index + claim : segment_size;
+
+            if (gen_of(enq) != tail.gen)
+            {
+                // The segment was recycled since the tail was read. Give up the slots of the new generation.
+                poison(*pSegment, gen_of(enq), index, end);
+                continue;
+            }
+
+            if (index < segment_size)
+            {
+                auto written = begin_write(*pSegment, tail.gen, index, end);
+                std::size_t constructed = 0;
+                try
+                {
+                    ops::construct_n(pSegment->item(index), items, written, constructed);
+                }
+                catch (...)
+                {
+                    end_write(*pSegment, tail.gen, index, index + static_cast<unsigned int>(constructed), ready);
+                    end_write(*pSegment, tail.gen, index + static_cast<unsigned int>(constructed), index + written, poisoned);
+                    throw;
+                }
+                end_write(*pSegment, tail.gen, index, index + written, ready);
+
+                items += written;
+                count -= written;
+                if (end < segment_size || count == 0)
+                {
+                    continue;
+                }
+            }
+
+            extend(tail);
+        }
+    }
+
+    bool pop(T & item)
+    {
+        backoff wait_retry;
+        for (;;)
+        {
+            // memory_order_acquire due to the segment reset by its recycler must be visible.
+            auto head = m_head.load(memory_order_acquire);
+            auto pSegment = head.pSegment;
+
+            auto deq = pSegment->deq.load(memory_order_acquire);
+            if (gen_of(deq) != head.gen)
+            {
+                // head moved on since it was read.
+                continue;
+            }
+
+            auto index = index_of(deq);
+            if (index == segment_size)
+            {
+                if (!advance_head(head))
+                {
+                    return false;
+                }
+                continue;
+            }
+
+            auto enq = pSegment->enq.load(memory_order_acquire);
+            if (gen_of(enq) != head.gen)
+            {
+                continue;
+            }
+            if (index >= index_of(enq))
+            {
+                return false;
+            }
+
+            // memory_order_relaxed due to the slot state, not the index, publishes the item.
+            if (!pSegment->deq.compare_exchange_weak(deq, deq + 1, memory_order_relaxed, memory_order_relaxed))
+            {
+                wait_retry();
+                continue;
+            }
+
+            bool taken = take(*pSegment, index, head.gen, item);
+            finish(pSegment);
+            if (taken)
+            {
+                return true;
+            }
+        }
+    }
+
+    // Pops up to max_count items into items. Returns the number popped, 0 if the queue is empty.
+    std::size_t pop(T * items, std::size_t max_count)
+    {
+        std::size_t count = 0;
+        backoff wait_retry;
+        while (count < max_count)
+        {
+            // memory_order_acquire due to the segment reset by its recycler must be visible.
+            auto head = m_head.load(memory_order_acquire);
+            auto pSegment = head.pSegment;
+
+            auto deq = pSegment->deq.load(memory_order_acquire);
+            if (gen_of(deq) != head.gen)
+            {
+                continue;
+            }
+
+            auto index = index_of(deq);
+            if (index == segment_size)
+            {
+                if (!advance_head(head))
+                {
+                    break;
+                }
+                continue;
+            }
+
+            auto enq = pSegment->enq.load(memory_order_acquire);
+            if (gen_of(enq) != head.gen)
+            {
+                continue;
+            }
+            auto pushed = (index_of(enq) < segment_size) ? index_of(enq) : segment_size;
+            if (index >= pushed)
+            {
+                break;
+            }
+            auto claim = pushed - index;
+            if (claim > max_count - count)
+            {
+                claim = static_cast<unsigned int>(max_count - count);
+            }
+
+            // memory_order_relaxed due to the slot states, not the index, publish the items.
+            if (!pSegment->deq.compare_exchange_weak(deq, deq + claim, memory_order_relaxed, memory_order_relaxed))
+            {
+                wait_retry();
+                continue;
+            }
+
+            count += take_n(*pSegment, index, claim, head.gen, items + count);
+            finish(pSegment, claim);
+        }
+        return count;
+    }
+
+private:
+    using ops = item_ops<T>;
+
+    static const std::uint64_t empty = 0;
+    static const std::uint64_t writing = 1;
+    static const std::uint64_t ready = 2;
+    static const std::uint64_t poisoned = 3;
+
+    // Spins a consumer waits on a claimed slot before it poisons the slot.
+    static const unsigned int max_wait_spins = 1024;
+
+    struct segment;
+
+    // Head, tail and next link. A segment pointer and the generation of the segment.
+    struct link
+    {
+        segment * pSegment;
+        // Pointer sized, so that the struct has no padding bytes.
+        // compare_exchange compares padding bytes too, which are not preserved on copy.
+        std::uintptr_t gen;
+    };
+
+    struct alignas(cache_line_size) segment : public cache_aligned
+    {
+        segment() : pPrevious(nullptr), generation{ 0 }, finished{ 0 }, enq{ 0 }, deq{ 0 }
+        {
+            link none;
+            none.pSegment = nullptr;
+            none.gen = 0;
+            next.store(none, memory_order_relaxed);
+            for (auto & s : state)
+            {
+                s.store(tag(0, empty), memory_order_relaxed);
+            }
+        }
+
+        T * item(unsigned int index)
+        {
+            return reinterpret_cast<T *>(&items[index]);
+        }
+
+        // link in the free list of segments.
+        segment * pPrevious;
+
+        std::atomic<std::uintptr_t> generation;
+        std::atomic<link> next;
+        // Slots done by their consumers, plus one once the head moved past.
+        std::atomic<unsigned int> finished;
+
+        // generation in the high 32 bits, index in the low 32 bits.
+        alignas(cache_line_size) std::atomic<std::uint64_t> enq;
+        alignas(cache_line_size) std::atomic<std::uint64_t> deq;
+
+        // generation shifted left by 2, or one of empty, writing, ready, poisoned.
+        alignas(cache_line_size) std::atomic<std::uint64_t> state[segment_size];
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type items[segment_size];
+    };
+
+    static std::uint64_t tag(std::uint64_t gen, std::uint64_t s)
+    {
+        return (gen << 2) | s;
+    }
+
+    static std::uint64_t gen_of(std::uint64_t index_word)
+    {
+        return index_word >> 32;
+    }
+
+    static unsigned int index_of(std::uint64_t index_word)
+    {
+        return static_cast<unsigned int>(index_word);
+    }
+
+    template<typename U>
+    void emplace(U && item)
+    {
+        for (;;)
+        {
+            // memory_order_acquire due to the segment reset by its recycler must be visible.
+            auto tail = m_tail.load(memory_order_acquire);
+            auto pSegment = tail.pSegment;
+
+            // memory_order_acquire due to the slot states reset by the recycler must be visible.
+            auto enq = pSegment->enq.fetch_add(1, memory_order_acquire);
+            auto index = index_of(enq);
+
+            if (gen_of(enq) != tail.gen)
+            {
+                // The segment was recycled since the tail was read. Give up the slot of the new generation.
+                if (index < segment_size)
+                {
+                    auto expected = tag(gen_of(enq), empty);
+                    pSegment->state[index].compare_exchange_strong(expected, tag(gen_of(enq), poisoned), memory_order_relaxed, memory_order_relaxed);
+                }
+                continue;
+            }
+
+            if (index < segment_size)
+            {
+                auto & state = pSegment->state[index];
+                auto expected = tag(tail.gen, empty);
+                // memory_order_relaxed due to the item is published by the ready store below.
+                if (!state.compare_exchange_strong(expected, tag(tail.gen, writing), memory_order_relaxed, memory_order_relaxed))
+                {
+                    // The consumer of the slot gave up waiting.
+                    continue;
+                }
+
+                try
+                {
+                    // in-place copy construction
+                    ops::construct(pSegment->item(index), std::forward<U>(item));
+                }
+                catch (...)
+                {
+                    state.store(tag(tail.gen, poisoned), memory_order_release);
+                    throw;
+                }
+
+                // memory_order_release due to the item written must be visible to the consumer.
+                state.store(tag(tail.gen, ready), memory_order_release);
+                return;
+            }
+
+            extend(tail);
+        }
+    }
+
+    // Links a segment after the full tail segment if there is none yet, and swings the tail to it.
+    void extend(const link & tail)
+    {
+        auto pSegment = tail.pSegment;
+
+        // memory_order_acquire due to the linked segment must be visible before it is used.
+        auto next = pSegment->next.load(memory_order_acquire);
+        if (next.gen != tail.gen)
+        {
+            return;
+        }
+
+        if (!next.pSegment)
+        {
+            link expected = next;
+            link linked;
+            linked.pSegment = get_segment();
+            linked.gen = tail.gen;
+
+            // memory_order_release on success due to the new segment must be visible to the threads that follow the link.
+            // memory_order_acquire on failure due to the segment linked by another thread is followed below.
+            if (pSegment->next.compare_exchange_strong(expected, linked, memory_order_release, memory_order_acquire))
+            {
+                next = linked;
+            }
+            else
+            {
+                put_segment(linked.pSegment);
+                next = expected;
+                if (next.gen != tail.gen || !next.pSegment)
+                {
+                    return;
+                }
+            }
+        }
+
+        swing(m_tail, tail, next.pSegment);
+    }
+
+    // Returns false if there is no segment after the exhausted head segment.
+    bool advance_head(const link & head)
+    {
+        auto pSegment = head.pSegment;
+
+        auto next = pSegment->next.load(memory_order_acquire);
+        if (next.gen != head.gen)
+        {
+            // head moved on since it was read.
+            return true;
+        }
+        if (!next.pSegment)
+        {
+            return false;
+        }
+
+        // The tail must never lag behind the head, since the segment is recycled once the head moves past it.
+        auto tail = m_tail.load(memory_order_acquire);
+        if (tail.pSegment == head.pSegment && tail.gen == head.gen)
+        {
+            swing(m_tail, tail, next.pSegment);
+        }
+
+        if (swing(m_head, head, next.pSegment))
+        {
+            finish(pSegment);
+        }
+        return true;
+    }
+
+    static bool swing(std::atomic<link> & end, link expected, segment * pNext)
+    {
+        link desired;
+        desired.pSegment = pNext;
+        // A linked segment is not recycled before the head moves past it, so its generation is stable here.
+        // If the head did move past, the compare and swap fails anyway.
+        desired.gen = pNext->generation.load(memory_order_relaxed);
+        // memory_order_release due to the segment must be visible to the threads that read it from head or tail.
+        return end.compare_exchange_strong(expected, desired, memory_order_release, memory_order_relaxed);
+    }
+
+    // Marks the claimed slots [index, end) writing, up to the first one its consumer gave up on,
+    // and poisons the slots after that one. Returns the number of slots marked writing.
+    unsigned int begin_write(segment & s, std::uint64_t gen, unsigned int index, unsigned int end)
+    {
+        auto i = index;
+        for (; i < end; ++i)
+        {
+            auto expected = tag(gen, empty);
+            // memory_order_relaxed due to the items are published by end_write.
+            if (!s.state[i].compare_exchange_strong(expected, tag(gen, writing), memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        poison(s, gen, i, end);
+        return i - index;
+    }
+
+    static void end_write(segment & s, std::uint64_t gen, unsigned int index, unsigned int end, std::uint64_t value)
+    {
+        for (auto i = index; i < end; ++i)
+        {
+            // memory_order_release due to the item written must be visible to the consumer.
+            s.state[i].store(tag(gen, value), memory_order_release);
+        }
+    }
+
+    // Gives up the claimed slots [index, end) whose consumers have not given up on them yet.
+    static void poison(segment & s, std::uint64_t gen, unsigned int index, unsigned int end)
+    {
+        for (auto i = index; i < end; ++i)
+        {
+            auto expected = tag(gen, empty);
+            s.state[i].compare_exchange_strong(expected, tag(gen, poisoned), memory_order_relaxed, memory_order_relaxed);
+        }
+    }
+
+    bool take(segment & s, unsigned int index, std::uint64_t gen, T & item)
+    {
+        if (!wait_ready(s, index, gen))
+        {
+            return false;
+        }
+        ops::move_out(item, s.item(index));
+        return true;
+    }
+
+    // Takes the items of the claimed slots [index, index + count), but those poisoned. Returns the number taken.
+    std::size_t take_n(segment & s, unsigned int index, unsigned int count, std::uint64_t gen, T * items)
+    {
+        unsigned int readyCount = 0;
+        for (auto i = index; i < index + count; ++i)
+        {
+            if (wait_ready(s, i, gen))
+            {
+                ++readyCount;
+            }
+        }
+
+        if (readyCount == count)
+        {
+            ops::move_out_n(items, s.item(index), count);
+            return count;
+        }
+
+        std::size_t taken = 0;
+        for (auto i = index; i < index + count; ++i)
+        {
+            // memory_order_relaxed due to the state was read with acquire in wait_ready, and does not change until the slot is finished.
+            if (s.state[i].load(memory_order_relaxed) == tag(gen, ready))
+            {
+                ops::move_out(items[taken++], s.item(i));
+            }
+        }
+        return taken;
+    }
+
+    // Returns true once the claimed slot is ready, false if it is poisoned.
+    bool wait_ready(segment & s, unsigned int index, std::uint64_t gen)
+    {
+        auto & state = s.state[index];
+        unsigned int spins = 0;
+        for (;;)
+        {
+            // memory_order_acquire due to the item written by the producer must be visible.
+            auto current = state.load(memory_order_acquire);
+            if (current == tag(gen, ready))
+            {
+                return true;
+            }
+            if (current == tag(gen, poisoned))
+            {
+                return false;
+            }
+            if (current == tag(gen, empty) && ++spins > max_wait_spins)
+            {
+                if (state.compare_exchange_strong(current, tag(gen, poisoned), memory_order_relaxed, memory_order_relaxed))
+                {
+                    return false;
+                }
+                continue;
+            }
+            cpu_relax();
+        }
+    }
+
+    // Called by the consumer of each slot, for count slots at a time, and once by the thread that moved the head past the segment.
+    void finish(segment * pSegment, unsigned int count = 1)
+    {
+        // memory_order_acq_rel due to the last one to finish must see all the others done with the segment.
+        if (pSegment->finished.fetch_add(count, memory_order_acq_rel) + count == segment_size + 1)
+        {
+            recycle(pSegment);
+        }
+    }
+
+    void recycle(segment * pSegment)
+    {
+        auto gen = pSegment->generation.load(memory_order_relaxed) + 1;
+        for (auto & s : pSegment->state)
+        {
+            s.store(tag(gen, empty), memory_order_relaxed);
+        }
+        link none;
+        none.pSegment = nullptr;
+        none.gen = gen;
+        pSegment->next.store(none, memory_order_relaxed);
+        pSegment->finished.store(0, memory_order_relaxed);
+        pSegment->generation.store(gen, memory_order_relaxed);
+        pSegment->deq.store(gen << 32, memory_order_release);
+        // memory_order_release due to the reset above must be visible to a producer whose fetch_add reads the new generation.
+        pSegment->enq.store(gen << 32, memory_order_release);
+
+        put_segment(pSegment);
+    }
+
+    segment * get_segment()
+    {
+        if (auto pSegment = m_free.pop())
+        {
+            return pSegment;
+        }
+        return new_segment();
+    }
+
+    void put_segment(segment * pSegment)
+    {
+        m_free.push(pSegment);
+    }
+
+    segment * new_segment()
+    {
+        auto pSegment = new segment;
+        std::lock_guard<spin_lock> lk(m_segmentsLock);
+        m_segments.push_back(pSegment);
+        return pSegment;
+    }
+
+    alignas(cache_line_size) std::atomic<link> m_head;
+    alignas(cache_line_size) std::atomic<link> m_tail;
+
+    alignas(cache_line_size) intrusive_stack<segment, backoff> m_free;
+
+    spin_lock m_segmentsLock;
+    std::vector<segment *> m_segments;
+};
+
+}
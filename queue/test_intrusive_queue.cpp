@@ -0,0 +1,202 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread -march=native test_intrusive_queue.cpp -latomic
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "intrusive_queue.h"
+#include "../pool/object_pool.h"
+
+#include <iostream>
+#include <future>
+#include <vector>
+#include <stdexcept>
+
+using std::cout;
+using std::vector;
+using std::logic_error;
+using std::flush;
+using std::future;
+
+struct msg
+{
+    msg(int p, int s) : pPrevious(nullptr), producer(p), seq(s)
+    {
+    }
+
+    msg * pPrevious;
+    int producer;
+    int seq;
+};
+
+bool testcase_sanity()
+{
+    bool bResult = false;
+    try
+    {
+        lockfree::intrusive_queue<msg> q;
+        if (q.pop()) throw logic_error("pop from empty queue returned an object.");
+
+        vector<msg> objects;
+        for (int i = 0; i < 10; ++i)
+        {
+            objects.emplace_back(0, i);
+        }
+        for (auto & m : objects)
+        {
+            q.push(&m);
+        }
+        for (int i = 0; i < 5; ++i)
+        {
+            if (q.pop() != &objects[i]) throw logic_error("not first in first out.");
+        }
+        // push again objects already popped.
+        for (int i = 0; i < 5; ++i)
+        {
+            q.push(&objects[i]);
+        }
+        for (int i = 5; i < 15; ++i)
+        {
+            if (q.pop() != &objects[i % 10]) throw logic_error("not first in first out after push of popped objects.");
+        }
+        if (q.pop()) throw logic_error("queue not empty.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - push pop sequence of the objects themselves." << std::flush;
+    return bResult;
+}
+
+// Runs pop in order, across a refill, and up to what is queued.
+bool testcase_run()
+{
+    bool bResult = false;
+    try
+    {
+        lockfree::intrusive_queue<msg> q;
+        std::size_t count = 1;
+        if (q.pop(4, count) || count != 0) throw logic_error("run pop from empty queue returned objects.");
+
+        vector<msg> objects;
+        for (int i = 0; i < 10; ++i)
+        {
+            objects.emplace_back(0, i);
+        }
+        for (auto & m : objects)
+        {
+            q.push(&m);
+        }
+        // from the refill, then from the pop list, then the rest.
+        int next = 0;
+        for (std::size_t max_count : { 4, 3, 100 })
+        {
+            auto pMsg = q.pop(max_count, count);
+            if (count != (max_count < 100 ? max_count : 3)) throw logic_error("unexpected run length.");
+            for (std::size_t i = 0; i < count; ++i, pMsg = pMsg->pPrevious)
+            {
+                if (pMsg != &objects[next++]) throw logic_error("run not first in first out.");
+            }
+        }
+        if (q.pop(0, count) || count != 0) throw logic_error("run of zero popped objects.");
+        if (q.pop()) throw logic_error("queue not empty.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : run test - runs pop in order, from a refill and from the pop list." << std::flush;
+    return bResult;
+}
+
+// Objects recycle through an object_pool, so the same addresses are queued over and over.
+// Consumers pop runs of up to max_run objects.
+bool testcase_parallelism(std::size_t max_run)
+{
+    static const int producers = 3;
+    static const int consumers = 3;
+    static const int per_producer = 100000;
+
+    lockfree::object_pool<msg> pool(0, 256, 16);
+    lockfree::intrusive_queue<msg> q;
+    std::atomic<int> consumed{ 0 };
+    std::atomic<bool> failed{ false };
+
+    vector<future<void>> vf;
+    for (int p = 0; p < producers; ++p)
+    {
+        vf.emplace_back(async(std::launch::async, [&pool, &q, p]() {
+            for (int i = 0; i < per_producer; ++i)
+            {
+                q.push(pool.acquire(p, i));
+            }
+        }));
+    }
+    for (int c = 0; c < consumers; ++c)
+    {
+        vf.emplace_back(async(std::launch::async, [&pool, &q, &consumed, &failed, max_run]() {
+            // the objects of a producer reach each consumer in the order they were pushed.
+            vector<int> last(producers, -1);
+            while (consumed.load() < producers * per_producer)
+            {
+                std::size_t count;
+                if (auto pMsg = q.pop(max_run, count))
+                {
+                    for (std::size_t i = 0; i < count; ++i)
+                    {
+                        auto pNext = pMsg->pPrevious;
+                        if (pMsg->seq <= last[pMsg->producer]) failed.store(true);
+                        last[pMsg->producer] = pMsg->seq;
+                        pool.release(pMsg);
+                        pMsg = pNext;
+                    }
+                    consumed += static_cast<int>(count);
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }));
+    }
+    for (auto & task : vf)
+    {
+        task.wait();
+    }
+
+    bool bFailed = failed.load() || (q.pop() != nullptr) || (consumed.load() != producers * per_producer);
+
+    cout << (bFailed ? "\n FAIL" : "\n success");
+    cout << " : parallelism test - " << producers << " producers, " << consumers << " consumers popping runs of up to " << max_run
+        << ", objects recycled through a pool." << std::flush;
+    return !bFailed;
+}
+
+#define RUN_TEST(...) { if (!(__VA_ARGS__)) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity());
+    RUN_TEST(testcase_run());
+    RUN_TEST(testcase_parallelism(1));
+    RUN_TEST(testcase_parallelism(5));
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
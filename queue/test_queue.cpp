@@ -1,24 +1,28 @@
 //
 // use the following command line to build using gcc
-// g++ -std=c++11 -pthread -march=native test_queue.cpp
+// g++ -std=c++11 -pthread -march=native test_queue.cpp -latomic
 //
 
 #include "queue.h"
+#include "../mutex/mcs_lock.h"
+#include "../mutex/clh_lock.h"
 
 #include <iostream>
 #include <future>
 #include <vector>
 #include <set>
 #include <random>
+#include <memory>
 
 using namespace std;
 using namespace lockfree;
 
 //#define PRINT_OUTPUT
 
-void testcase_parallelism()
+template<typename queue_type>
+void testcase_parallelism(const char * name)
 {
-    queue<int> qlf;
+    queue_type qlf;
     queue<int> result;
 
     const int parallelism = 999;
@@ -80,7 +84,7 @@ void testcase_parallelism()
     {
         cout << "\n success";
     }
-    cout << " test parallelism: push pop in parallel";
+    cout << " test parallelism: push pop in parallel - " << name;
 }
 
 void testcase_queueSemantic_pushpop()
@@ -166,12 +170,118 @@ void testcase_queueSemantic_partialpoppush()
 #endif
 }
 
+// Many mailboxes draw nodes from one pool. Memory tracks the total backlog.
+void testcase_sharedPool()
+{
+    const int mailboxes = 1000;
+    const int rounds = 20;
+
+    queue<int>::node_pool pool;
+    vector<unique_ptr<queue<int>>> boxes;
+    for (int b = 0; b < mailboxes; ++b)
+    {
+        boxes.emplace_back(new queue<int>(pool));
+    }
+
+    bool ok = true;
+    vector<future<void>> vf;
+    for (int t = 0; t < 4; ++t)
+    {
+        // each thread owns a quarter of the mailboxes, and fills then drains them, round after round.
+        vf.emplace_back(async(std::launch::async, [&boxes, &ok, t, mailboxes, rounds]() {
+            for (int r = 0; r < rounds; ++r)
+            {
+                for (int b = t; b < mailboxes; b += 4)
+                {
+                    boxes[b]->push(r);
+                    boxes[b]->push(r + 1);
+                }
+                for (int b = t; b < mailboxes; b += 4)
+                {
+                    int first = -1, second = -1, extra = 0;
+                    boxes[b]->pop(first);
+                    boxes[b]->pop(second);
+                    if (first != r || second != r + 1 || boxes[b]->pop(extra)) ok = false;
+                }
+            }
+        }));
+    }
+    for (auto & task : vf)
+    {
+        task.wait();
+    }
+
+    // The peak backlog is 2 per mailbox. Private pools would hold at least 64 per mailbox.
+    auto capacity = pool.capacity();
+    if (!ok || capacity > 4 * mailboxes)
+    {
+        cout << "\n FAIL";
+    }
+    else
+    {
+        cout << "\n success";
+    }
+    cout << " test sharedPool: " << mailboxes << " queues sharing one node pool of capacity " << capacity;
+}
+
+// Bulk push and pop, for a trivially copyable item and for one that is not.
+void testcase_bulk()
+{
+    queue<int> q;
+    int in[100];
+    for (int i = 0; i < 100; ++i)
+    {
+        in[i] = i;
+    }
+    q.push(in, 60);
+    q.push(in + 60, 40);
+
+    int out[100] = {};
+    auto count = q.pop(out, 30);
+    count += q.pop(out + count, 100);
+    int extra = 0;
+    bool ok = (count == 100) && !q.pop(extra) && (q.pop(out, 10) == 0);
+    for (int i = 0; ok && i < 100; ++i)
+    {
+        ok = (out[i] == i);
+    }
+
+    auto shared = make_shared<int>(1);
+    {
+        queue<shared_ptr<int>> sq;
+        vector<shared_ptr<int>> items(10, shared);
+        sq.push(items.data(), items.size());
+        items.clear();
+        ok = ok && (shared.use_count() == 11);
+        vector<shared_ptr<int>> popped(4);
+        ok = ok && (sq.pop(popped.data(), popped.size()) == 4);
+        popped.clear();
+        ok = ok && (shared.use_count() == 7);
+    }
+    ok = ok && (shared.use_count() == 1);
+
+    if (!ok)
+    {
+        cout << "\n FAIL";
+    }
+    else
+    {
+        cout << "\n success";
+    }
+    cout << " test bulk: push and pop of many items in order, and item lifetime";
+}
+
 int main(int argc, char ** argv)
 {
     testcase_queueSemantic_pushpop();
     testcase_queueSemantic_partialpoppush();
+    testcase_sharedPool();
+    testcase_bulk();
 
-    testcase_parallelism();
+    testcase_parallelism<queue<int>>("spin_lock refill");
+    testcase_parallelism<queue<int, mcs_lock>>("mcs_lock refill");
+    testcase_parallelism<queue<int, clh_lock>>("clh_lock refill");
+    testcase_parallelism<queue<int, basic_mcs_lock<yield_backoff<>>, exponential_backoff<>>>("mcs_lock yield_backoff refill, exponential_backoff");
 
     cout << "\ndone" << flush;
     getchar();
@@ -0,0 +1,395 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread -march=native test_segmented_queue.cpp -latomic
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "segmented_queue.h"
+#include "queue.h"
+#include "../stack/stack.h"
+
+#include <iostream>
+#include <future>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <stdexcept>
+#include <type_traits>
+
+using std::cout;
+using std::vector;
+using std::logic_error;
+using std::flush;
+using std::future;
+namespace chrono = std::chrono;
+
+using lockfree::segmented_queue;
+
+bool testcase_sanity()
+{
+    bool bResult = false;
+    try
+    {
+        segmented_queue<int, 4> q;
+        int item = 0;
+        if (q.pop(item)) throw logic_error("pop from empty queue succeeded.");
+
+        // spans several segments, and recycles them.
+        for (int round = 0; round < 3; ++round)
+        {
+            for (int i = 0; i < 10; ++i)
+            {
+                q.push(i);
+            }
+            for (int i = 0; i < 10; ++i)
+            {
+                if (!q.pop(item) || item != i) throw logic_error("not first in first out.");
+            }
+            if (q.pop(item)) throw logic_error("queue not empty.");
+        }
+
+        // items are destroyed when popped, and with the queue.
+        auto shared = std::make_shared<int>(1);
+        {
+            segmented_queue<std::shared_ptr<int>> sq;
+            for (int i = 0; i < 20; ++i)
+            {
+                sq.push(shared);
+            }
+            std::shared_ptr<int> p;
+            sq.pop(p);
+            p.reset();
+            if (shared.use_count() != 20) throw logic_error("popped item not destroyed.");
+        }
+        if (shared.use_count() != 1) throw logic_error("items not destroyed with the queue.");
+
+        if (lockfree::default_segment_size<int>::value != 16) throw logic_error("unexpected default segment size.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - push pop sequence across segments, and item lifetime." << std::flush;
+    return bResult;
+}
+
+bool testcase_bulk()
+{
+    bool bResult = false;
+    try
+    {
+        segmented_queue<int, 4> q;
+        int in[30];
+        for (int i = 0; i < 30; ++i)
+        {
+            in[i] = i;
+        }
+
+        // spans several segments, from a partly filled one.
+        q.push(in[0]);
+        q.push(in + 1, 29);
+        int out[30] = {};
+        int item = -1;
+        if (!q.pop(item) || item != 0) throw logic_error("single pop after bulk push failed.");
+        auto count = q.pop(out, 5);
+        count += q.pop(out + count, 30);
+        if (count != 29) throw logic_error("bulk pop did not pop all the items.");
+        for (int i = 0; i < 29; ++i)
+        {
+            if (out[i] != i + 1) throw logic_error("not first in first out.");
+        }
+        if (q.pop(out, 30) != 0 || q.pop(item)) throw logic_error("queue not empty.");
+
+        auto shared = std::make_shared<int>(1);
+        {
+            segmented_queue<std::shared_ptr<int>, 4> sq;
+            vector<std::shared_ptr<int>> items(10, shared);
+            sq.push(items.data(), items.size());
+            items.clear();
+            if (shared.use_count() != 11) throw logic_error("items not copied in.");
+            vector<std::shared_ptr<int>> popped(6);
+            if (sq.pop(popped.data(), popped.size()) != 6) throw logic_error("bulk pop of shared_ptr failed.");
+            popped.clear();
+            if (shared.use_count() != 5) throw logic_error("popped items not destroyed.");
+        }
+        if (shared.use_count() != 1) throw logic_error("items not destroyed with the queue.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : bulk test - bulk push pop sequence across segments, and item lifetime." << std::flush;
+    return bResult;
+}
+
+// Small segments, so that segments are linked and recycled all the time.
+template<unsigned int segment_size>
+bool testcase_parallelism(bool bulk = false)
+{
+    static const int batch = 16;
+    static const int producers = 3;
+    static const int consumers = 3;
+    static const int per_producer = 100000;
+
+    segmented_queue<std::uint64_t, segment_size> q;
+    std::atomic<int> consumed{ 0 };
+    std::atomic<bool> failed{ false };
+    vector<std::atomic<int>> seen(producers * per_producer);
+
+    vector<future<void>> vf;
+    for (int p = 0; p < producers; ++p)
+    {
+        vf.emplace_back(async(std::launch::async, [&q, p, bulk]() {
+            std::uint64_t items[batch];
+            for (int i = 0; i < per_producer; )
+            {
+                auto n = bulk ? (i % batch) + 1 : 1;
+                n = (n < per_producer - i) ? n : per_producer - i;
+                for (int b = 0; b < n; ++b)
+                {
+                    items[b] = (static_cast<std::uint64_t>(p) << 32) | static_cast<std::uint64_t>(i + b);
+                }
+                if (n == 1)
+                {
+                    q.push(items[0]);
+                }
+                else
+                {
+                    q.push(items, n);
+                }
+                i += n;
+            }
+        }));
+    }
+    for (int c = 0; c < consumers; ++c)
+    {
+        vf.emplace_back(async(std::launch::async, [&q, &consumed, &failed, &seen, bulk]() {
+            // the items of a producer reach each consumer in the order they were pushed.
+            vector<long long> last(producers, -1);
+            std::uint64_t items[batch];
+            while (consumed.load() < producers * per_producer)
+            {
+                auto n = bulk ? q.pop(items, batch) : (q.pop(items[0]) ? 1 : 0);
+                for (std::size_t b = 0; b < n; ++b)
+                {
+                    auto p = static_cast<int>(items[b] >> 32);
+                    auto i = static_cast<int>(items[b] & 0xffffffff);
+                    if (p >= producers || i >= per_producer || i <= last[p]) failed.store(true);
+                    else if (seen[p * per_producer + i]++ != 0) failed.store(true);
+                    last[p] = i;
+                    consumed++;
+                }
+                if (n == 0)
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }));
+    }
+    for (auto & task : vf)
+    {
+        task.wait();
+    }
+
+    std::uint64_t extra;
+    bool bFailed = failed.load() || q.pop(extra);
+
+    cout << (bFailed ? "\n FAIL" : "\n success");
+    cout << " : parallelism test - segment size " << segment_size << (bulk ? ", bulk" : "") << ", " << producers << " producers, "
+        << consumers << " consumers, each item popped once in order." << std::flush;
+    return !bFailed;
+}
+
+// Reports the cost of a push and pop pair against queue.h. Not a pass or fail criterion.
+template<typename queue_type>
+double ns_per_item(queue_type & q)
+{
+    static const int items = 1000000;
+    static const int batch = 64;
+
+    auto start = chrono::steady_clock::now();
+    int item;
+    for (int i = 0; i < items; i += batch)
+    {
+        for (int b = 0; b < batch; ++b)
+        {
+            q.push(b);
+        }
+        for (int b = 0; b < batch; ++b)
+        {
+            q.pop(item);
+        }
+    }
+    auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    return static_cast<double>(ns) / items;
+}
+
+bool testcase_compare()
+{
+    lockfree::queue<int> q;
+    segmented_queue<int> sq;
+    auto queue_ns = ns_per_item(q);
+    auto segmented_ns = ns_per_item(sq);
+
+    cout << "\n success";
+    cout << " : compare test - ns per item pushed and popped: queue " << queue_ns << ", segmented_queue " << segmented_ns << "." << std::flush;
+    return true;
+}
+
+// A small message, trivially copyable.
+struct message
+{
+    std::uint32_t id;
+    std::uint32_t kind;
+    std::uint64_t payload;
+};
+
+// The same bytes as T, but with a user-provided copy, so that item_ops takes the generic path.
+template<typename T>
+struct not_trivial
+{
+    not_trivial() : value()
+    {
+    }
+
+    not_trivial(const not_trivial & other) : value(other.value)
+    {
+    }
+
+    not_trivial & operator=(const not_trivial & other)
+    {
+        value = other.value;
+        return *this;
+    }
+
+    T value;
+};
+
+static_assert(!std::is_trivially_copyable<not_trivial<message>>::value, "not_trivial must not be trivially copyable.");
+static_assert(sizeof(not_trivial<message>) == sizeof(message), "not_trivial must have the size of the item it wraps.");
+
+void set_item(int & item, int i)
+{
+    item = i;
+}
+
+void set_item(message & item, int i)
+{
+    item = message{ static_cast<std::uint32_t>(i), 0, 0 };
+}
+
+template<typename T>
+void set_item(not_trivial<T> & item, int i)
+{
+    set_item(item.value, i);
+}
+
+// Reports the cost of a push and pop pair, one at a time and in bulk. Not a pass or fail criterion.
+template<typename queue_type, typename T>
+double ns_per_item_bulk(queue_type & q, bool bulk)
+{
+    static const int items = 1000000;
+    static const int batch = 64;
+
+    T in[batch];
+    T out[batch];
+    for (int b = 0; b < batch; ++b)
+    {
+        set_item(in[b], b);
+    }
+
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < items; i += batch)
+    {
+        if (bulk)
+        {
+            q.push(in, batch);
+            q.pop(out, batch);
+        }
+        else
+        {
+            for (int b = 0; b < batch; ++b)
+            {
+                q.push(in[b]);
+            }
+            for (int b = 0; b < batch; ++b)
+            {
+                q.pop(out[b]);
+            }
+        }
+    }
+    auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    return static_cast<double>(ns) / items;
+}
+
+// Reports one at a time and bulk costs of a container of T, against the same container of not_trivial<T>.
+template<template<typename> class container, typename T>
+void report_trivial_gain(const char * name)
+{
+    using U = not_trivial<T>;
+    container<T> trivial;
+    container<U> generic;
+    auto trivial_ns = ns_per_item_bulk<container<T>, T>(trivial, false);
+    auto generic_ns = ns_per_item_bulk<container<U>, U>(generic, false);
+    auto trivial_bulk_ns = ns_per_item_bulk<container<T>, T>(trivial, true);
+    auto generic_bulk_ns = ns_per_item_bulk<container<U>, U>(generic, true);
+
+    cout << ", " << name << " " << trivial_ns << " vs " << generic_ns << ", in bulk " << trivial_bulk_ns << " vs " << generic_bulk_ns;
+}
+
+template<typename T>
+using queue_of = lockfree::queue<T>;
+
+template<typename T>
+using stack_of = lockfree::stack<T>;
+
+template<typename T>
+using segmented_queue_of = segmented_queue<T>;
+
+// The trivially copyable path of item_ops against the generic one, for the same bytes.
+template<typename T>
+bool testcase_compare_bulk(const char * name)
+{
+    cout << "\n success";
+    cout << " : compare bulk test - " << name << ", ns per item pushed and popped, trivially copyable vs not";
+    report_trivial_gain<queue_of, T>("queue");
+    report_trivial_gain<stack_of, T>("stack");
+    report_trivial_gain<segmented_queue_of, T>("segmented_queue");
+    cout << "." << std::flush;
+    return true;
+}
+
+#define RUN_TEST(...) { if (!(__VA_ARGS__)) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity());
+    RUN_TEST(testcase_parallelism<1>());
+    RUN_TEST(testcase_parallelism<4>());
+    RUN_TEST(testcase_parallelism<lockfree::default_segment_size<std::uint64_t>::value>());
+    RUN_TEST(testcase_bulk());
+    RUN_TEST(testcase_parallelism<1>(true));
+    RUN_TEST(testcase_parallelism<4>(true));
+    RUN_TEST(testcase_parallelism<lockfree::default_segment_size<std::uint64_t>::value>(true));
+    RUN_TEST(testcase_compare());
+    RUN_TEST(testcase_compare_bulk<int>("int"));
+    RUN_TEST(testcase_compare_bulk<message>("16 byte message"));
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
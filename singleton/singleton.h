@@ -9,6 +9,8 @@
 #include <atomic>
 #include <mutex>
 
+#include "../parking_lot/parking_mutex.h"
+
 using std::memory_order_relaxed;
 using std::memory_order_acquire;
 using std::memory_order_release;
@@ -24,6 +26,10 @@ The m_pObj.store() needs memory_order_release to syncronize with the first m_pOb
     Note that release semantic of mutex unlock cannot stand in for this because release-acquire
     semantic must match wrt the same atomic.
 
+The mutex is a lockfree::parking_mutex, so it is only one byte per Singleton type,
+    and threads racing the first get() spin briefly and then park on the global parking lot
+    instead of each needing a kernel mutex.
+
 The following link says this implementation is correct and is the best.
     http://preshing.com/20130930/double-checked-locking-is-fixed-in-cpp11/
 TODO:
@@ -41,7 +47,7 @@ public:
         auto pObj = m_pObj.load(memory_order_acquire);
         if (!pObj)
         {
-            std::lock_guard<std::mutex> lock(m_mtx);
+            std::lock_guard<lockfree::parking_mutex> lock(m_mtx);
             pObj = m_pObj.load(memory_order_relaxed);
             if (!pObj)
             {
@@ -54,11 +60,11 @@ public:
 
 private:
     static std::atomic<T *> m_pObj;
-    static std::mutex m_mtx;
+    static lockfree::parking_mutex m_mtx;
 };
 
 template <class T>
-std::mutex Singleton<T>::m_mtx;
+lockfree::parking_mutex Singleton<T>::m_mtx;
 
 template <class T>
 std::atomic<T *> Singleton<T>::m_pObj(nullptr);
@@ -0,0 +1,188 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "../backoff/backoff.h"
+#include "../trace/trace_point.h"
+
+using std::cerr;
+using std::memory_order_relaxed;
+using std::memory_order_consume;
+using std::memory_order_release;
+
+// Intrusive lock free stack implementation in C++11.
+// Note: The stacked objects are linked through a hook they embed, so no node storage exists.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread -march=native
+//      arch option is needed because not all architectures support 16 byte atomic.
+
+/*
+Notes:
+T must have a public member
+    T * pPrevious;
+which the stack owns while the object is stacked. An object can be in one intrusive stack at a time.
+push(p) links the object itself, and pop() returns it, or nullptr if the stack is empty.
+push(pFirst, pLast) pushes a chain of objects, linked from pLast through pPrevious down to pFirst,
+with a single compare and swap, as if pushed one by one from pFirst to pLast.
+pop(max_count, count) pops a run of up to max_count objects with a single compare and swap,
+as if popped one by one. It returns the top object, and the run is linked from it through pPrevious.
+So there is no allocation, and no node to miss in cache besides the object.
+stack.h is this stack over nodes drawn from an object_pool, that hold a copy of the item.
+
+Design:
+The top is an object pointer and a sequence number swapped with a 16 byte compare and swap.
+The sequence number is incremented on push, so an object popped and pushed back
+cannot fool a pop that read it before.
+The backoff policy from backoff.h is applied in every compare and swap retry loop.
+Compare and swap retries are trace points of trace_point.h, off unless LOCKFREE_TRACE is defined.
+
+Type-stable memory:
+A pop reads the pPrevious hook of the object at the top.
+Another thread may pop that object in between, and the application may then reuse it,
+so the read may see any value; the sequence number makes the compare and swap fail then.
+But the memory must still be readable. So an object popped from the stack must not be
+returned to the operating system while other threads may still pop from the stack.
+Objects from an object_pool, which keeps its slabs until it is destroyed, or from
+any other type-stable storage meet this. Objects deleted with delete may not.
+pop(max_count, count) also follows the pPrevious hooks of the run before its compare and swap,
+so the hook of a popped object must hold nullptr or another such object, whatever the application
+does with the object after. The blocks of an object_pool, free or not, meet this too.
+Then the run is what the hooks said if the compare and swap succeeds, since top and sequence number
+unchanged means nothing was pushed or popped in between, and stacked hooks are only written by push.
+*/
+namespace lockfree
+{
+
+template<typename T, typename backoff = no_backoff>
+class intrusive_stack
+{
+public:
+    intrusive_stack() : m_top{ nullptr }
+    {
+        if (!m_top.is_lock_free())
+        {
+            cerr << "\nFalling back to lock based implementation of lockfree::stack.";
+        }
+    }
+
+    intrusive_stack(const intrusive_stack &) = delete;
+    intrusive_stack & operator=(const intrusive_stack &) = delete;
+
+    void push(T * pNode)
+    {
+        push(pNode, pNode);
+    }
+
+    // pLast must lead to pFirst through pPrevious. The pPrevious of pFirst is overwritten.
+    void push(T * pFirst, T * pLast)
+    {
+        // memory_order_relaxed due to no following dereferencing of top.
+        auto top = m_top.load(memory_order_relaxed);
+
+        head newtop;
+        newtop.pNode = pLast;
+
+        backoff wait_retry;
+        for (;;)
+        {
+            pFirst->pPrevious = top.pNode;
+            newtop.seqNum = top.seqNum + 1;
+
+            // memory_order_release on success due to node need to be pop ready for another thread.
+            // memory_order_relaxed on failure due to no following dereferencing of top.
+            if (m_top.compare_exchange_weak(top, newtop, memory_order_release, memory_order_relaxed))
+            {
+                break;
+            }
+            LOCKFREE_TRACE_EVENT(stack_cas_retry, 0);
+            wait_retry();
+        }
+    }
+
+    // Returns nullptr if empty.
+    T * pop()
+    {
+        std::size_t count;
+        return pop(1, count);
+    }
+
+    // Pops up to max_count objects. Returns the top object, nullptr if empty, and the count popped in count.
+    // The run is linked from the returned object through pPrevious. The pPrevious of its last object is left as is,
+    // so walk count objects, not up to nullptr.
+    T * pop(std::size_t max_count, std::size_t & count)
+    {
+        count = 0;
+        if (!max_count)
+        {
+            return nullptr;
+        }
+
+        // memory_order_consume due to following dependent load operation top.pNode->pPrevious.
+        auto top = m_top.load(memory_order_consume);
+
+        head newtop;
+
+        backoff wait_retry;
+        while (top.pNode)
+        {
+            auto pLast = top.pNode;
+            count = 1;
+            while (count < max_count && pLast->pPrevious)
+            {
+                pLast = pLast->pPrevious;
+                ++count;
+            }
+            newtop.pNode = pLast->pPrevious;
+            newtop.seqNum = top.seqNum;
+
+            // memory_order_consume on failure due to following dependent load operation top.pNode->pPrevious.
+            //      Note: Dependent load allows faster memory_order_consume to be used instead of memory_order_release.
+            // memory_order_relaxed on success due to top actually read by the previous atomic operation, not the current one.
+            //      Note: However success cannot specify weaker ordering than failure until C++17.
+            if (m_top.compare_exchange_weak(top, newtop, memory_order_relaxed, memory_order_consume))
+            {
+                break;
+            }
+            LOCKFREE_TRACE_EVENT(stack_cas_retry, 0);
+            wait_retry();
+        }
+
+        if (!top.pNode)
+        {
+            count = 0;
+        }
+        return top.pNode;
+    }
+
+private:
+    struct head
+    {
+        T * pNode;
+        // Pointer sized, so that the struct has no padding bytes.
+        // compare_exchange compares padding bytes too, which are not preserved on copy.
+        std::uintptr_t seqNum;
+
+        head(T * p): pNode(p), seqNum(0)
+        {
+        }
+
+        // for default initialization.
+        head()
+        {
+        }
+    };
+
+    std::atomic<head> m_top;
+};
+
+}
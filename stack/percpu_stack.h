@@ -0,0 +1,197 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "intrusive_stack.h"
+#include "../util/cache_line.h"
+#include "../util/rseq.h"
+
+using std::memory_order_relaxed;
+
+// Intrusive per-cpu stack using Linux restartable sequences, over a shared lock free stack.
+// Note: push and pop on the list of the current cpu commit with a plain store, no atomic instruction.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread -march=native
+//      arch option is needed because the shared stack uses 16 byte atomic.
+
+/*
+Notes:
+T must be a standard layout type with public members
+    T * pPrevious;
+    std::uintptr_t depth;
+which the stack owns while the object is stacked.
+push(p) stacks the object on the list of the current cpu, and pop() takes the top of that list,
+or, if it is empty, pops the shared intrusive_stack. pop() returns nullptr if both are empty.
+per_cpu() tells whether the per-cpu lists are in use. They are not if use_rseq is false,
+or rseq_ops::available() of rseq.h is false. Then every push and pop goes to the shared stack.
+
+This is not one last in first out order. A pop sees the objects pushed on its own cpu,
+and those flushed to the shared stack, but not the ones on the lists of other cpus.
+So pop() may return nullptr while other cpus hold objects. It suits free lists, where a miss
+costs an allocation, eg. the blocks of object_pool.h, and not containers of items.
+At most max_per_cpu objects stay on the list of a cpu.
+
+Design:
+The list of a cpu is a top pointer on a cache line of its own, changed only by rseq sections on that cpu.
+push: reads the top, links the object to it, and commits it as the new top if the top is unchanged.
+pop:  reads the top and the pPrevious of the top object, and commits that as the new top,
+      all within one rseq section. No other thread of the cpu can run in between,
+      so there is no ABA, and no sequence number.
+A section that is preempted, migrated or signaled aborts, and is retried, on whatever cpu the thread is then.
+depth is the count of objects from the bottom of the list. When the list of a cpu holds max_per_cpu,
+a push first detaches the whole list by swapping its top for nullptr, and pushes it to the shared stack
+with a single compare and swap. So the 16 byte compare and swap is taken once per max_per_cpu pushes,
+and a cpu that frees more than it takes passes its surplus to the other cpus.
+A thread whose rseq is not registered uses the shared stack.
+
+Type-stable memory:
+As for intrusive_stack.h. A push reads the depth of the top object outside the rseq section,
+which another thread of the cpu may have popped and reused since.
+*/
+namespace lockfree
+{
+
+template<typename T, typename backoff = no_backoff>
+class percpu_stack
+{
+public:
+    static const unsigned int default_max_per_cpu = 64;
+
+    explicit percpu_stack(unsigned int max_per_cpu = default_max_per_cpu, bool use_rseq = true) :
+        m_maxPerCpu(max_per_cpu ? max_per_cpu : 1)
+    {
+        static_assert(std::is_standard_layout<T>::value, "percpu_stack needs a standard layout T, for offsetof pPrevious.");
+
+        if (use_rseq && rseq_ops::available())
+        {
+            for (unsigned int i = 0; i < rseq_ops::cpu_slots(); ++i)
+            {
+                m_heads.emplace_back(new cpu_head);
+            }
+        }
+    }
+
+    percpu_stack(const percpu_stack &) = delete;
+    percpu_stack & operator=(const percpu_stack &) = delete;
+
+    bool per_cpu() const
+    {
+        return !m_heads.empty();
+    }
+
+    void push(T * pNode)
+    {
+        for (;;)
+        {
+            auto cpu = rseq_ops::current_cpu();
+            if (cpu < 0 || static_cast<std::size_t>(cpu) >= m_heads.size())
+            {
+                m_shared.push(pNode);
+                return;
+            }
+
+            auto pTop = m_heads[cpu]->top_word();
+            // memory_order_relaxed due to the rseq section checks the top again before it commits.
+            auto top = reinterpret_cast<T *>(m_heads[cpu]->top.load(memory_order_relaxed));
+            if (top && top->depth >= m_maxPerCpu)
+            {
+                if (rseq_ops::compare_store(pTop, word(top), 0, cpu) == rseq_status::committed)
+                {
+                    flush(top);
+                }
+                continue;
+            }
+
+            pNode->pPrevious = top;
+            pNode->depth = top ? top->depth + 1 : 1;
+            if (rseq_ops::compare_store(pTop, word(top), word(pNode), cpu) == rseq_status::committed)
+            {
+                return;
+            }
+        }
+    }
+
+    // Returns nullptr if the list of this cpu and the shared stack are empty.
+    T * pop()
+    {
+        for (;;)
+        {
+            auto cpu = rseq_ops::current_cpu();
+            if (cpu < 0 || static_cast<std::size_t>(cpu) >= m_heads.size())
+            {
+                break;
+            }
+
+            std::intptr_t popped = 0;
+            auto status = rseq_ops::compare_not_pop(m_heads[cpu]->top_word(), 0, offsetof(T, pPrevious), &popped, cpu);
+            if (status == rseq_status::committed)
+            {
+                return reinterpret_cast<T *>(popped);
+            }
+            if (status == rseq_status::compare_failed)
+            {
+                break;
+            }
+        }
+
+        return m_shared.pop();
+    }
+
+    unsigned int max_per_cpu() const
+    {
+        return m_maxPerCpu;
+    }
+
+private:
+    struct alignas(cache_line_size) cpu_head : public cache_aligned
+    {
+        cpu_head() : top{ 0 }
+        {
+        }
+
+        // rseq sections store to it as a plain word.
+        std::intptr_t * top_word()
+        {
+            static_assert(sizeof(std::atomic<std::intptr_t>) == sizeof(std::intptr_t), "atomic word not a plain word.");
+            return reinterpret_cast<std::intptr_t *>(&top);
+        }
+
+        // Atomic only for the reads outside rseq sections.
+        std::atomic<std::intptr_t> top;
+    };
+
+    static std::intptr_t word(T * p)
+    {
+        return reinterpret_cast<std::intptr_t>(p);
+    }
+
+    // pTop is a list detached from its cpu, so only this thread sees it.
+    void flush(T * pTop)
+    {
+        auto pBottom = pTop;
+        while (pBottom->pPrevious)
+        {
+            pBottom = pBottom->pPrevious;
+        }
+        m_shared.push(pBottom, pTop);
+    }
+
+    const unsigned int m_maxPerCpu;
+    // Allocated one by one, so that each gets the cache_aligned operator new.
+    std::vector<std::unique_ptr<cpu_head>> m_heads;
+    intrusive_stack<T, backoff> m_shared;
+};
+
+}
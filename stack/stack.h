@@ -6,13 +6,14 @@
 
 #pragma once
 
-#include <iostream>
-#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
 
-using std::cerr;
-using std::memory_order_relaxed;
-using std::memory_order_consume;
-using std::memory_order_release;
+#include "intrusive_stack.h"
+#include "../backoff/backoff.h"
+#include "../pool/object_pool.h"
+#include "../util/item_ops.h"
 
 // Lock free stack implementation in C++11.
 // Stack can grow in size unbounded.
@@ -26,28 +27,62 @@ Notes:
 This implementation removes the restriction that you must use a per-thread arena allocator.
 This implementation also fixes the two problems identified in stack_lf_unbounded_pta.h
 Problem 1 is fixed by also adding a sequence number to atomic top variable which is incremented on push.
-Problem 2 is fixed by removing per-thread arena allocator restriction by using an internal free list for allocation.
+Problem 2 is fixed by removing per-thread arena allocator restriction by drawing nodes from an object_pool.
+    Popped nodes go back to the pool, so memory tracks the backlog.
+    By default a stack has a pool of its own. Stacks of the same type can instead share a node_pool
+    passed at construction, so that memory tracks their total backlog, rather than the sum of their peaks.
+    The slab_allocator policy parameter of the pool, from slab_allocator.h, can back the nodes with huge pages,
+    pre-faulted at construction, eg. for a stack with a large initial_capacity.
+    Opt in with per_cpu_free_lists, and where restartable sequences are available the own pool recycles
+    nodes through per-cpu free lists, see percpu_stack.h, at a cache line per cpu.
+    Then a push and a pop each take one 16 byte compare and swap, on the stack top,
+    instead of two. The occupied list stays one last in first out stack over all cpus.
+The nodes are linked by an intrusive_stack from intrusive_stack.h, which has the lock free list.
 
 Other notes:
 1. Cannot use a preallocated array as storage for stack elements because
     say for push,
     copy element and then atomic push will not work because copy can race,
     atomic push and then copy element will not work because pop can happen while copy.
-2. Since the nodes don't get deleted at pop, but goes to a free list, we must call
+2. Since the nodes don't get deleted at pop, but go back to the pool, we must call
     the element destructor manually. This is important if the stack is used to store
     smart pointers since the stack must not hold references to elements after pop.
 3. Since the nodes don't always get allocated at push, we must do in-place copy
     construction manually. We cannot use assignment because assignment needs a
     previously constructed object.
+4. The backoff policy from backoff.h is applied in every compare and swap retry loop.
+5. Compare and swap retries are trace points of trace_point.h, off unless LOCKFREE_TRACE is defined.
+6. For a trivially copyable T, item_ops from item_ops.h copies the bytes instead, and there is
+    no destructor to call. push(items, count) links the nodes of all the items first and pushes
+    them with a single compare and swap. pop(items, max_count) pops a run of up to max_count nodes
+    with a single compare and swap, see intrusive_stack.h, then moves the items out one by one.
 */
 namespace lockfree
 {
 
-template<typename T>
+template<typename T, typename backoff = no_backoff, typename slab_allocator = heap_slab_allocator>
 class stack
 {
+    struct node
+    {
+        node * pPrevious;
+        T item;
+    };
+
 public:
-    stack(unsigned int initial_capacity = 64): m_freeList(initial_capacity)
+    // Pool of nodes that stacks of the same type can share.
+    using node_pool = basic_object_pool<node, backoff, slab_allocator>;
+
+    // Draws nodes from a pool of its own, without per-thread caches, preallocated with initial_capacity nodes.
+    // The pool gets its slabs from allocator. per_cpu_free_lists, off by default, is that of basic_object_pool.
+    stack(unsigned int initial_capacity = 64, const slab_allocator & allocator = slab_allocator(), bool per_cpu_free_lists = false):
+        m_pOwnPool(new node_pool(initial_capacity, own_pool_slab_size, 0, allocator, per_cpu_free_lists)),
+        m_pool(*m_pOwnPool)
+    {
+    }
+
+    // Draws nodes from the given pool, which must outlive the stack.
+    explicit stack(node_pool & pool): m_pool(pool)
     {
     }
 
@@ -60,25 +95,26 @@ public:
     // Makes a copy of T internally. This allows proper object lifetime management. T can also be a smart pointer.
     void push(const T & item)
     {
-        auto pNode = m_freeList.pop();
+        auto pNode = static_cast<node *>(m_pool.allocate());
 
         // in-place copy construction
-        new (&(pNode->item)) T(item);
+        ops::construct(&(pNode->item), item);
 
         m_occupiedList.push(pNode);
     }
 
-    // Copies T on return. This allows stack management of its own internal storage.
+    // Moves T to the client on return. This allows stack management of its own internal storage.
     bool pop(T &item)
     {
         node * pNode;
         if (pNode = m_occupiedList.pop())
         {
-            // copy to client.
-            item = pNode->item;
+            // move to client, and destruct internal copy without freeing memory.
+            ops::move_out(item, &(pNode->item));
 
-            // destruct internal copy without freeing memory.
-            pNode->item.~T();
+            // A popper that read this node before it was popped only fails its compare and swap on it,
+            // since pushing the node back bumps seqNum.
+            m_pool.deallocate(pNode);
 
             return true;
         }
@@ -88,124 +124,79 @@ public:
         }
     }
 
-private:
-    struct node
+    // Pushes count items in order, with a single compare and swap.
+    // If a copy constructor throws, the items before the failing one are pushed.
+    void push(const T * items, std::size_t count)
     {
-        node * pPrevious;
-        T item;
-    };
-
-    class node_list
-    {
-    public:
-        node_list() : m_top{nullptr}
+        node * pFirst = nullptr;
+        node * pLast = nullptr;
+        try
         {
-            if (!m_top.is_lock_free())
-            {
-                cerr << "\nFalling back to lock based implementation of lockfree::stack.";
-            }
-        }
-
-        void push(node * pNode)
-        {
-            // memory_order_relaxed due to no following dereferencing of top.
-            auto top = m_top.load(memory_order_relaxed);
-
-            head newtop;
-            newtop.pNode = pNode;
-
-            do
+            for (std::size_t i = 0; i < count; ++i)
             {
-                pNode->pPrevious = top.pNode;
-                newtop.seqNum = top.seqNum + 1;
-            } while (!m_top.compare_exchange_weak(top, newtop, memory_order_release, memory_order_relaxed));
-            // memory_order_release on success due to node need to be pop ready for another thread.
-            // memory_order_relaxed on failure due to no following dereferencing of top.
-        }
-
-        node * pop()
-        {
-            // memory_order_consume due to following dependent load operation top.pNode->pPrevious.
-            auto top = m_top.load(memory_order_consume);
+                auto pNode = static_cast<node *>(m_pool.allocate());
+                try
+                {
+                    ops::construct(&(pNode->item), items[i]);
+                }
+                catch (...)
+                {
+                    m_pool.deallocate(pNode);
+                    throw;
+                }
 
-            head newtop;
-            
-            do
-            {
-                if (top.pNode)
+                if (pLast)
+                {
+                    pNode->pPrevious = pLast;
+                }
+                else
                 {
-                    newtop.pNode = top.pNode->pPrevious;
-                    newtop.seqNum = top.seqNum;
+                    pFirst = pNode;
                 }
+                pLast = pNode;
             }
-            while (top.pNode && (!m_top.compare_exchange_weak(top, newtop, memory_order_relaxed, memory_order_consume)));
-            // memory_order_consume on failure due to following dependent load operation top.pNode->pPrevious.
-            //      Note: Dependent load allows faster memory_order_consume to be used instead of memory_order_release.
-            // memory_order_relaxed on success due to top actually read by the previous atomic operation, not the current one.
-            //      Note: However success cannot specify weaker ordering than failure until C++17.
-
-            return top.pNode;
         }
-
-    private:
-        struct head
+        catch (...)
         {
-            node * pNode;
-            unsigned int seqNum;
-
-            head(node * node): pNode(node), seqNum(0)
+            if (pLast)
             {
+                m_occupiedList.push(pFirst, pLast);
             }
-
-            // for default initialization.
-            head()
-            {
-            }
-        };
-
-        std::atomic<head> m_top;
-    };
-
-    // This class makes sure pop() always returns a node.
-    // If node_list is empty on pop(), node is allocated and inserted into the list.
-    class free_list: public node_list
-    {
-    public:
-        free_list(unsigned int initial_capacity)
-        {
-            for (unsigned int i = 0; i < initial_capacity; ++i)
-            {
-                // There is no need to call constructor here. So just use malloc.
-                node_list::push(static_cast<node *>(malloc(sizeof(node))));
-            }
+            throw;
         }
 
-        ~free_list()
+        if (pLast)
         {
-            node * pNode = nullptr;
-
-            while (pNode = node_list::pop())
-            {
-                free(pNode);
-            }
+            m_occupiedList.push(pFirst, pLast);
         }
+    }
 
-        node * pop()
+    // Pops up to max_count items into items. Returns the number popped, 0 if the stack is empty.
+    std::size_t pop(T * items, std::size_t max_count)
+    {
+        std::size_t count;
+        auto pNode = m_occupiedList.pop(max_count, count);
+        for (std::size_t i = 0; i < count; ++i)
         {
-            node * ret = nullptr;
+            // read before the pool reuses the link.
+            auto pNext = pNode->pPrevious;
 
-            while (!(ret = node_list::pop()))
-            {
-                // There is no need to call constructor here. So just use malloc.
-                node_list::push(static_cast<node *>(malloc(sizeof(node))));
-            }
+            ops::move_out(items[i], &(pNode->item));
+            m_pool.deallocate(pNode);
 
-            return ret;
+            pNode = pNext;
         }
-    };
+        return count;
+    }
+
+private:
+    using ops = item_ops<T>;
+
+    static const unsigned int own_pool_slab_size = 16;
 
-    free_list m_freeList;
-    node_list m_occupiedList;
+    std::unique_ptr<node_pool> m_pOwnPool;
+    node_pool & m_pool;
+    intrusive_stack<node, backoff> m_occupiedList;
 };
 
 }
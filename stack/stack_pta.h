@@ -9,6 +9,8 @@
 #include <iostream>
 #include <atomic>
 
+#include "../backoff/backoff.h"
+
 using std::cerr;
 using std::memory_order_relaxed;
 using std::memory_order_consume;
@@ -30,7 +32,7 @@ Problems identified:
 namespace lockfree
 {
 
-template<typename T>
+template<typename T, typename backoff = no_backoff>
 class stack_pta
 {
 public:
@@ -56,12 +58,19 @@ public:
         // memory_order_relaxed due to no following dereferencing of top.
         auto top = m_top.load(memory_order_relaxed);
 
-        do
+        backoff wait_retry;
+        for (;;)
         {
             newtop->m_previous = top;
-        } while (!m_top.compare_exchange_weak(top, newtop, memory_order_release, memory_order_relaxed));
-        // memory_order_release on success due to item need to be pop ready for another thread.
-        // memory_order_relaxed on failure due to no following dereferencing of top.
+
+            // memory_order_release on success due to item need to be pop ready for another thread.
+            // memory_order_relaxed on failure due to no following dereferencing of top.
+            if (m_top.compare_exchange_weak(top, newtop, memory_order_release, memory_order_relaxed))
+            {
+                break;
+            }
+            wait_retry();
+        }
     }
 
     // Copies T on return. This allows stack management of its own internal storage.
@@ -74,7 +83,11 @@ public:
         //      Note: Dependent load allows faster memory_order_consume to be used instead of memory_order_release.
         // memory_order_relaxed on success due to top actually read by the previous atomic operation, not the current one.
         //      Note: However success cannot specify weaker ordering than failure until C++17.
-        while (top && (!m_top.compare_exchange_weak(top, top->m_previous, memory_order_relaxed, memory_order_consume)));
+        backoff wait_retry;
+        while (top && (!m_top.compare_exchange_weak(top, top->m_previous, memory_order_relaxed, memory_order_consume)))
+        {
+            wait_retry();
+        }
 
         if (top)
         {
@@ -0,0 +1,191 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread -march=native test_intrusive_stack.cpp -latomic
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "intrusive_stack.h"
+#include "../pool/object_pool.h"
+
+#include <iostream>
+#include <future>
+#include <vector>
+#include <stdexcept>
+
+using std::cout;
+using std::vector;
+using std::logic_error;
+using std::flush;
+using std::future;
+
+struct msg
+{
+    msg(int v) : pPrevious(nullptr), value(v)
+    {
+    }
+
+    msg * pPrevious;
+    int value;
+};
+
+bool testcase_sanity()
+{
+    bool bResult = false;
+    try
+    {
+        lockfree::intrusive_stack<msg> s;
+        if (s.pop()) throw logic_error("pop from empty stack returned an object.");
+
+        vector<msg> objects;
+        for (int i = 0; i < 10; ++i)
+        {
+            objects.emplace_back(i);
+        }
+        for (auto & m : objects)
+        {
+            s.push(&m);
+        }
+        for (int i = 9; i >= 0; --i)
+        {
+            if (s.pop() != &objects[i]) throw logic_error("not last in first out.");
+        }
+        if (s.pop()) throw logic_error("stack not empty.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - push pop sequence of the objects themselves." << std::flush;
+    return bResult;
+}
+
+// Runs pop last in first out, and up to what is stacked.
+bool testcase_run()
+{
+    bool bResult = false;
+    try
+    {
+        lockfree::intrusive_stack<msg> s;
+        std::size_t count = 1;
+        if (s.pop(4, count) || count != 0) throw logic_error("run pop from empty stack returned objects.");
+
+        vector<msg> objects;
+        for (int i = 0; i < 10; ++i)
+        {
+            objects.emplace_back(i);
+        }
+        for (auto & m : objects)
+        {
+            s.push(&m);
+        }
+        int next = 9;
+        for (std::size_t max_count : { 4, 3, 100 })
+        {
+            auto pMsg = s.pop(max_count, count);
+            if (count != (max_count < 100 ? max_count : 3)) throw logic_error("unexpected run length.");
+            for (std::size_t i = 0; i < count; ++i, pMsg = pMsg->pPrevious)
+            {
+                if (pMsg != &objects[next--]) throw logic_error("run not last in first out.");
+            }
+        }
+        if (s.pop(0, count) || count != 0) throw logic_error("run of zero popped objects.");
+        if (s.pop()) throw logic_error("stack not empty.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : run test - runs pop last in first out." << std::flush;
+    return bResult;
+}
+
+// A few objects are popped and pushed back over and over, the pattern that ABA hurts.
+// Threads pop runs of up to max_run objects, and push each run back as a chain.
+bool testcase_parallelism(std::size_t max_run)
+{
+    static const int threads = 4;
+    static const int rounds = 200000;
+    static const int objects = 8;
+
+    lockfree::intrusive_stack<msg> s;
+    vector<msg> storage;
+    for (int i = 0; i < objects; ++i)
+    {
+        storage.emplace_back(i);
+    }
+    for (auto & m : storage)
+    {
+        s.push(&m);
+    }
+
+    vector<future<void>> vf;
+    for (int t = 0; t < threads; ++t)
+    {
+        vf.emplace_back(async(std::launch::async, [&s, max_run]() {
+            for (int r = 0; r < rounds; ++r)
+            {
+                std::size_t count;
+                if (auto pTop = s.pop(max_run, count))
+                {
+                    // the run leads from its top to its last object through pPrevious, as push(pFirst, pLast) needs.
+                    auto pLast = pTop;
+                    for (std::size_t i = 1; i < count; ++i)
+                    {
+                        pLast = pLast->pPrevious;
+                    }
+                    s.push(pLast, pTop);
+                }
+            }
+        }));
+    }
+    for (auto & task : vf)
+    {
+        task.wait();
+    }
+
+    // every object must be on the stack exactly once.
+    vector<int> seen(objects, 0);
+    int count = 0;
+    while (auto pMsg = s.pop())
+    {
+        seen[pMsg->value]++;
+        if (++count > objects) break;
+    }
+    bool failed = (count != objects);
+    for (auto n : seen)
+    {
+        failed = failed || (n != 1);
+    }
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : parallelism test - " << threads << " threads pop runs of up to " << max_run << " and push back " << objects << " objects." << std::flush;
+    return !failed;
+}
+
+#define RUN_TEST(...) { if (!(__VA_ARGS__)) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity());
+    RUN_TEST(testcase_run());
+    RUN_TEST(testcase_parallelism(1));
+    RUN_TEST(testcase_parallelism(3));
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
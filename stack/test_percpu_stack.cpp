@@ -0,0 +1,245 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread -march=native test_percpu_stack.cpp -latomic
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "percpu_stack.h"
+#include "../topology/topology.h"
+
+#include <iostream>
+#include <future>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+
+using std::cout;
+using std::vector;
+using std::logic_error;
+using std::flush;
+using std::future;
+namespace chrono = std::chrono;
+
+using lockfree::percpu_stack;
+using lockfree::cpu_topology;
+
+struct msg
+{
+    msg(int v) : pPrevious(nullptr), depth(0), value(v)
+    {
+    }
+
+    msg * pPrevious;
+    std::uintptr_t depth;
+    int value;
+};
+
+// Pops every object left on the list of every cpu, from a thread pinned to each in turn.
+vector<msg *> drain(percpu_stack<msg> & s)
+{
+    vector<msg *> popped;
+    std::thread t([&s, &popped]() {
+        cpu_topology topology;
+        for (auto cpu : topology.cpus())
+        {
+            cpu_topology::pin_this_thread(cpu);
+            while (auto pMsg = s.pop())
+            {
+                popped.push_back(pMsg);
+            }
+        }
+    });
+    t.join();
+    return popped;
+}
+
+bool testcase_sanity(bool use_rseq)
+{
+    bool bResult = false;
+    bool per_cpu = false;
+    try
+    {
+        // On its own thread, pinned, so that all pushes and pops are on one cpu.
+        auto task = async(std::launch::async, [use_rseq, &per_cpu]() {
+            cpu_topology::pin_this_thread(cpu_topology::current_cpu());
+
+            percpu_stack<msg> s(4, use_rseq);
+            per_cpu = s.per_cpu();
+            if (!use_rseq && per_cpu) throw logic_error("per cpu lists in use though turned off.");
+            if (s.max_per_cpu() != 4) throw logic_error("unexpected max per cpu.");
+            if (s.pop()) throw logic_error("pop from empty stack returned an object.");
+
+            // More than max_per_cpu, so that the list of the cpu flushes to the shared stack twice.
+            vector<msg> objects;
+            for (int i = 0; i < 10; ++i)
+            {
+                objects.emplace_back(i);
+            }
+            for (auto & m : objects)
+            {
+                s.push(&m);
+            }
+            for (int i = 9; i >= 0; --i)
+            {
+                if (s.pop() != &objects[i]) throw logic_error("not last in first out on one cpu.");
+            }
+            if (s.pop()) throw logic_error("stack not empty.");
+        });
+        task.get();
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - " << (per_cpu ? "per cpu lists" : "shared stack only") << ", push pop sequence with flushes." << std::flush;
+    return bResult;
+}
+
+// A few objects are popped and pushed back over and over, by more threads than cpus,
+// so that rseq sections are preempted and retried.
+bool testcase_parallelism(bool use_rseq)
+{
+    static const int threads = 4;
+    static const int rounds = 200000;
+    static const int objects = 64;
+
+    percpu_stack<msg> s(8, use_rseq);
+    vector<msg> storage;
+    for (int i = 0; i < objects; ++i)
+    {
+        storage.emplace_back(i);
+    }
+    for (auto & m : storage)
+    {
+        s.push(&m);
+    }
+
+    vector<future<void>> vf;
+    for (int t = 0; t < threads; ++t)
+    {
+        vf.emplace_back(async(std::launch::async, [&s]() {
+            msg * held[2] = { nullptr, nullptr };
+            for (int r = 0; r < rounds; ++r)
+            {
+                // Holds up to two objects across rounds, so that lists grow and flush.
+                auto & slot = held[r % 2];
+                if (slot)
+                {
+                    s.push(slot);
+                    slot = nullptr;
+                }
+                else
+                {
+                    slot = s.pop();
+                }
+            }
+            for (auto pMsg : held)
+            {
+                if (pMsg) s.push(pMsg);
+            }
+        }));
+    }
+    for (auto & task : vf)
+    {
+        task.wait();
+    }
+
+    // every object must be on the stack exactly once.
+    vector<int> seen(objects, 0);
+    auto popped = drain(s);
+    bool failed = (popped.size() != static_cast<std::size_t>(objects));
+    for (auto pMsg : popped)
+    {
+        seen[pMsg->value]++;
+    }
+    for (auto n : seen)
+    {
+        failed = failed || (n != 1);
+    }
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : parallelism test - " << (s.per_cpu() ? "per cpu lists" : "shared stack only") << ", " << threads
+        << " threads pop and push back " << objects << " objects." << std::flush;
+    return !failed;
+}
+
+// Reports the cost of a push and pop pair with the per-cpu lists, and with the shared stack only,
+// which is intrusive_stack.h. Not a pass or fail criterion.
+double ns_per_pair(bool use_rseq, unsigned int threads)
+{
+    static const int pairs = 1000000;
+
+    percpu_stack<msg> s(64, use_rseq);
+    vector<msg> storage;
+    for (unsigned int i = 0; i < threads; ++i)
+    {
+        storage.emplace_back(static_cast<int>(i));
+    }
+    for (auto & m : storage)
+    {
+        s.push(&m);
+    }
+
+    auto start = chrono::steady_clock::now();
+    vector<future<void>> vf;
+    for (unsigned int t = 0; t < threads; ++t)
+    {
+        vf.emplace_back(async(std::launch::async, [&s]() {
+            for (int i = 0; i < pairs; ++i)
+            {
+                if (auto pMsg = s.pop())
+                {
+                    s.push(pMsg);
+                }
+            }
+        }));
+    }
+    for (auto & task : vf)
+    {
+        task.wait();
+    }
+    auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    return static_cast<double>(ns) / pairs;
+}
+
+bool testcase_performance()
+{
+    // At least two, so that a single cpu host shows preempted sections too.
+    auto threads = std::thread::hardware_concurrency();
+    threads = (threads < 2) ? 2 : threads;
+
+    bool available = percpu_stack<msg>().per_cpu();
+    auto percpu_1 = ns_per_pair(true, 1);
+    auto shared_1 = ns_per_pair(false, 1);
+    auto percpu_n = ns_per_pair(true, threads);
+    auto shared_n = ns_per_pair(false, threads);
+
+    cout << "\n success";
+    cout << " : performance test - per cpu lists " << (available ? "available" : "not available")
+        << ", wall ns per push pop pair, per cpu lists vs shared stack: 1 thread " << percpu_1 << " vs " << shared_1
+        << ", " << threads << " threads " << percpu_n << " vs " << shared_n << "." << std::flush;
+    return true;
+}
+
+#define RUN_TEST(...) { if (!(__VA_ARGS__)) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity(true));
+    RUN_TEST(testcase_sanity(false));
+    RUN_TEST(testcase_parallelism(true));
+    RUN_TEST(testcase_parallelism(false));
+    RUN_TEST(testcase_performance());
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
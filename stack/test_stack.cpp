@@ -1,6 +1,6 @@
 //
 // use the following command line to build using gcc
-// g++ -std=c++11 -pthread -march=native test_stack.cpp
+// g++ -std=c++11 -pthread -march=native test_stack.cpp -latomic
 //
 
 #include "stack.h"
@@ -55,6 +55,44 @@ int main(int argc, char ** argv)
     // expected output is all numbers from 1 to 12 in any order.
     print(result);
 
+    // stacks sharing one node pool.
+    stack<int>::node_pool pool;
+    stack<int> s1(pool);
+    stack<int> s2(pool);
+    for (int c = 1; c <= 3; ++c)
+    {
+        s1.push(c);
+        s2.push(-c);
+    }
+    // expected output is 3 2 1 -3 -2 -1.
+    cout << '\n';
+    print(s1);
+    print(s2);
+
+    // own pool with per cpu free lists, where available.
+    stack<int> percpu(64, heap_slab_allocator(), true);
+    for (int c = 1; c <= 3; ++c)
+    {
+        percpu.push(c);
+    }
+    // expected output is 3 2 1.
+    cout << '\n';
+    print(percpu);
+
+    // bulk push and pop.
+    stack<int> bulk;
+    int in[] = { 1, 2, 3, 4, 5 };
+    bulk.push(in, 5);
+    int out[5] = {};
+    auto count = bulk.pop(out, 2);
+    // expected output is 5 4 3 2 1.
+    cout << '\n';
+    for (size_t c = 0; c < count; ++c)
+    {
+        cout << out[c] << ' ';
+    }
+    print(bulk);
+
     cout << "\ndone" << flush;
     getchar();
     return 0;
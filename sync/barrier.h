@@ -0,0 +1,241 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "../util/cache_line.h"
+#include "../parking_lot/parking_lot.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <stdexcept>
+
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_release;
+using std::memory_order_acq_rel;
+using std::memory_order_seq_cst;
+
+// User mode reusable barrier implementations using C++11.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+barrier
+    Sense reversing central barrier. Any thread can arrive, no thread id is needed.
+    All threads decrement one counter, so arrival is O(n) on one cache line.
+    Good for a few threads.
+tree_barrier
+    Static 4-ary arrival tree. Each thread passes its id in [0, n).
+    Each thread waits only for its own up to 4 children, on its own cache line,
+    and then signals its parent. So no cache line is written by more than 4 threads per phase,
+    and arrival takes O(log n) steps. Good for many threads, eg. 64 phase parallel threads.
+
+Both barriers can be reused for any number of phases.
+Waiters spin for the calibrated budget, then register as parked and park.
+A waker unparks only if some thread registered, so without parking a phase never takes a bucket lock.
+The registration and the waker's check of it use memory_order_seq_cst, as do the
+waiter's check and the waker's state change, so that a wake-up cannot be lost.
+
+Design of the sense reversing barrier:
+The phase number is the generalized sense. A thread reads the phase, then decrements the counter.
+The last thread to arrive resets the counter and then increments the phase, which releases the others.
+Since the counter is reset before the phase changes, a released thread that arrives
+at the next phase at once sees the reset counter.
+
+Design of the tree barrier:
+Thread i is node i. Its children are nodes 4i+1 .. 4i+4, where less than n.
+Arrival:
+    1. wait until all children have cleared their flag in node i.
+    2. re-arm the flags of node i for the next phase.
+    3. clear own flag in the parent node. The root instead releases the phase.
+Wake-up: as in the central barrier, all threads wait for the phase number to change.
+The phase is written once per phase, so waiting on it causes no write contention.
+*/
+
+namespace lockfree
+{
+
+namespace detail
+{
+
+// Spin, then register as parked and park until done().
+template<typename Done>
+void barrier_wait(const void * addr, std::atomic<unsigned int> & parked, Done done)
+{
+    if (parking_lot::spin(done))
+    {
+        return;
+    }
+
+    parked.fetch_add(1, memory_order_seq_cst);
+    while (!done())
+    {
+        parking_lot::park(addr, [&done]() { return !done(); });
+    }
+    parked.fetch_sub(1, memory_order_relaxed);
+}
+
+// Call after the state change that done() waits for.
+inline void barrier_wake(const void * addr, std::atomic<unsigned int> & parked)
+{
+    if (parked.load(memory_order_seq_cst))
+    {
+        parking_lot::unpark_all(addr);
+    }
+}
+
+}
+
+class barrier
+{
+public:
+    explicit barrier(std::ptrdiff_t expected) : m_expected(expected), m_remaining{ expected }, m_phase{ 0 }
+    {
+        if (expected <= 0)
+        {
+            throw std::invalid_argument("barrier needs at least one thread.");
+        }
+    }
+
+    barrier(const barrier &) = delete;
+    barrier & operator=(const barrier &) = delete;
+
+    void arrive_and_wait()
+    {
+        auto phase = m_phase.load(memory_order_acquire);
+
+        // memory_order_acq_rel due to
+        //      release: writes of this thread before the barrier must be visible to the last thread.
+        //      acquire: the last thread must see the writes of all others before releasing the phase.
+        if (m_remaining.fetch_sub(1, memory_order_acq_rel) == 1)
+        {
+            m_remaining.store(m_expected, memory_order_relaxed);
+
+            // memory_order_seq_cst, which includes release, due to all writes before the barrier
+            // must be visible to the released threads.
+            m_phase.store(phase + 1, memory_order_seq_cst);
+            detail::barrier_wake(&m_phase, m_parked);
+            return;
+        }
+
+        detail::barrier_wait(&m_phase, m_parked, [this, phase]() {
+            return m_phase.load(memory_order_seq_cst) != phase;
+        });
+    }
+
+private:
+    const std::ptrdiff_t m_expected;
+    std::atomic<unsigned int> m_parked{ 0 };
+    alignas(cache_line_size) std::atomic<std::ptrdiff_t> m_remaining;
+    alignas(cache_line_size) std::atomic<unsigned int> m_phase;
+};
+
+class tree_barrier
+{
+public:
+    static const unsigned int fan_in = 4;
+
+    explicit tree_barrier(unsigned int expected) : m_expected(expected), m_phase{ 0 }
+    {
+        if (expected == 0)
+        {
+            throw std::invalid_argument("tree_barrier needs at least one thread.");
+        }
+
+        for (unsigned int i = 0; i < expected; ++i)
+        {
+            std::unique_ptr<node> pNode(new node);
+            for (unsigned int c = 0; c < fan_in; ++c)
+            {
+                pNode->haveChild[c] = (fan_in * i + c + 1) < expected;
+                pNode->childNotReady[c].store(pNode->haveChild[c], memory_order_relaxed);
+            }
+            m_nodes.push_back(std::move(pNode));
+        }
+    }
+
+    tree_barrier(const tree_barrier &) = delete;
+    tree_barrier & operator=(const tree_barrier &) = delete;
+
+    // id must be unique among the threads of a phase, and in [0, expected).
+    void arrive_and_wait(unsigned int id)
+    {
+        if (id >= m_expected)
+        {
+            throw std::out_of_range("tree_barrier thread id out of range.");
+        }
+
+        auto & me = *m_nodes[id];
+        auto phase = m_phase.load(memory_order_acquire);
+
+        //
+        // Wait for all children to arrive.
+        //
+        detail::barrier_wait(&me, me.parked, [&me]() { return me.children_ready(); });
+
+        // Re-arm for the next phase. No child can arrive for the next phase before this phase is released.
+        for (unsigned int c = 0; c < fan_in; ++c)
+        {
+            me.childNotReady[c].store(me.haveChild[c], memory_order_relaxed);
+        }
+
+        if (id == 0)
+        {
+            // memory_order_seq_cst, which includes release, due to all writes before the barrier
+            // must be visible to the released threads.
+            m_phase.store(phase + 1, memory_order_seq_cst);
+            detail::barrier_wake(&m_phase, m_parked);
+            return;
+        }
+
+        //
+        // Signal the parent, then wait for the phase to be released.
+        //
+        auto & parent = *m_nodes[(id - 1) / fan_in];
+        // memory_order_seq_cst, which includes release, due to writes of this subtree before the barrier
+        // must be visible to the parent.
+        parent.childNotReady[(id - 1) % fan_in].store(false, memory_order_seq_cst);
+        detail::barrier_wake(&parent, parent.parked);
+
+        detail::barrier_wait(&m_phase, m_parked, [this, phase]() {
+            return m_phase.load(memory_order_seq_cst) != phase;
+        });
+    }
+
+private:
+    struct alignas(cache_line_size) node : public cache_aligned
+    {
+        bool children_ready() const
+        {
+            for (unsigned int c = 0; c < fan_in; ++c)
+            {
+                // memory_order_seq_cst, which includes acquire, due to the child subtree writes
+                // must be visible on return.
+                if (childNotReady[c].load(memory_order_seq_cst))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        std::atomic<bool> childNotReady[fan_in];
+        bool haveChild[fan_in];
+        std::atomic<unsigned int> parked{ 0 };
+    };
+
+    const unsigned int m_expected;
+    std::atomic<unsigned int> m_parked{ 0 };
+    // Allocated one by one, so that each gets the cache_aligned operator new.
+    std::vector<std::unique_ptr<node>> m_nodes;
+    alignas(cache_line_size) std::atomic<unsigned int> m_phase;
+};
+
+}
@@ -0,0 +1,170 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "../parking_lot/parking_lot.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_seq_cst;
+
+// User mode condition variable implementation using C++11.
+// Note: Works with lockfree::shared_mutex in both exclusive and shared modes.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+The interface adheres to the C++11 condition_variable_any interface.
+Any BasicLockable can be passed, eg.
+    std::unique_lock<lockfree::shared_mutex> to wait holding exclusive access,
+    std::shared_lock<lockfree::shared_mutex> (C++14) to wait holding shared access.
+Unlike std::condition_variable_any, there is no internal mutex,
+and a waiter enters the kernel only if it is not notified within the calibrated spin budget.
+As with any condition variable, wake-ups can be spurious, so wait in a loop or use the predicate overloads.
+
+Design:
+A sequence counter, and a count of registered waiters. Waiters park on the sequence counter.
+wait(lock):
+    1. register as a waiter, and read the sequence, while still holding the lock.
+    2. unlock, then spin for the calibrated budget, then park, until the sequence moves on.
+    3. unregister, and lock again.
+notify_one():
+    increment the sequence. Only if there are registered waiters, unpark one of them.
+notify_all():
+    increment the sequence. Only if there are registered waiters, unpark all of them.
+The sequence is read before unlock, so a notify after the waiter released the lock always moves
+the sequence past what the waiter read, and the parking lot revalidates the sequence under
+its bucket lock before sleeping, so a wake-up cannot be lost.
+Registration and the notifier's check for waiters both use memory_order_seq_cst,
+so at least one of the two sees the other.
+
+notify_one() wakes exactly one parked waiter, not all of them, so there is no thundering herd.
+A waiter still spinning sees the sequence move and also returns; that is a spurious wake-up,
+bounded by the short spin budget.
+The sequence is 32 bits; a waiter misses a notify only if exactly 2^32 notifies happen
+between its read of the sequence and its next check, which is not a practical concern.
+*/
+
+namespace lockfree
+{
+
+class condition_variable
+{
+public:
+    condition_variable() : m_seq{ 0 }, m_waiters{ 0 }
+    {
+    }
+
+    condition_variable(const condition_variable &) = delete;
+    condition_variable & operator=(const condition_variable &) = delete;
+
+    void notify_one()
+    {
+        // memory_order_seq_cst due to the notifier's check for waiters following this, see Design.
+        m_seq.fetch_add(1, memory_order_seq_cst);
+        if (m_waiters.load(memory_order_seq_cst))
+        {
+            parking_lot::unpark_one(&m_seq);
+        }
+    }
+
+    void notify_all()
+    {
+        // memory_order_seq_cst due to the notifier's check for waiters following this, see Design.
+        m_seq.fetch_add(1, memory_order_seq_cst);
+        if (m_waiters.load(memory_order_seq_cst))
+        {
+            parking_lot::unpark_all(&m_seq);
+        }
+    }
+
+    template<typename Lock>
+    void wait(Lock & lock)
+    {
+        auto seq = enter();
+        lock.unlock();
+        parking_lot::spin_then_park(&m_seq, [this, seq]() { return moved_on(seq); });
+        leave();
+        lock.lock();
+    }
+
+    template<typename Lock, typename Predicate>
+    void wait(Lock & lock, Predicate pred)
+    {
+        while (!pred())
+        {
+            wait(lock);
+        }
+    }
+
+    template<typename Lock, typename Clock, typename Duration>
+    std::cv_status wait_until(Lock & lock, const std::chrono::time_point<Clock, Duration> & abs_time)
+    {
+        auto seq = enter();
+        lock.unlock();
+        auto notified = parking_lot::spin_then_park_until(&m_seq, [this, seq]() { return moved_on(seq); }, abs_time);
+        leave();
+        lock.lock();
+        return notified ? std::cv_status::no_timeout : std::cv_status::timeout;
+    }
+
+    template<typename Lock, typename Clock, typename Duration, typename Predicate>
+    bool wait_until(Lock & lock, const std::chrono::time_point<Clock, Duration> & abs_time, Predicate pred)
+    {
+        while (!pred())
+        {
+            if (wait_until(lock, abs_time) == std::cv_status::timeout)
+            {
+                return pred();
+            }
+        }
+        return true;
+    }
+
+    template<typename Lock, typename Rep, typename Period>
+    std::cv_status wait_for(Lock & lock, const std::chrono::duration<Rep, Period> & rel_time)
+    {
+        return wait_until(lock, std::chrono::steady_clock::now() + rel_time);
+    }
+
+    template<typename Lock, typename Rep, typename Period, typename Predicate>
+    bool wait_for(Lock & lock, const std::chrono::duration<Rep, Period> & rel_time, Predicate pred)
+    {
+        return wait_until(lock, std::chrono::steady_clock::now() + rel_time, pred);
+    }
+
+private:
+    // Call holding the lock. Returns the sequence to wait on.
+    unsigned int enter()
+    {
+        // memory_order_seq_cst due to the waiter's read of the sequence following this, see Design.
+        m_waiters.fetch_add(1, memory_order_seq_cst);
+        return m_seq.load(memory_order_seq_cst);
+    }
+
+    void leave()
+    {
+        m_waiters.fetch_sub(1, memory_order_relaxed);
+    }
+
+    bool moved_on(unsigned int seq) const
+    {
+        // Ordering with the data is provided by the lock, which the waiter takes again before returning.
+        return m_seq.load(memory_order_relaxed) != seq;
+    }
+
+    std::atomic<unsigned int> m_seq;
+    std::atomic<unsigned int> m_waiters;
+};
+
+}
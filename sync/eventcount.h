@@ -0,0 +1,156 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "../parking_lot/parking_lot.h"
+
+#include <atomic>
+#include <cstdint>
+
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_seq_cst;
+
+// Eventcount implementation using C++11.
+// Note: Lets a consumer sleep until a lock free container is no longer empty, or full,
+//  without adding a lock to the container.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+A consumer of eg. lockfree::queue waits for an item as follows.
+    for (;;)
+    {
+        if (q.pop(item)) break;
+        auto key = ec.prepare_wait();
+        if (q.pop(item)) { ec.cancel_wait(); break; }
+        ec.commit_wait(key);
+    }
+and the producer calls ec.notify() after every q.push(item).
+await(condition) is the same loop for a condition that has no result, eg. a flag.
+
+The second check after prepare_wait() is what makes it safe: a push after prepare_wait()
+changes the epoch, so commit_wait() returns at once, and a push before it is seen by the check.
+
+Design:
+One 64 bit word. The high 32 bits are the epoch, the low 32 bits count the prepared waiters.
+prepare_wait():
+    add one waiter and return the epoch, as the key.
+cancel_wait():
+    remove one waiter.
+commit_wait(key):
+    spin for the calibrated budget, then park on the word, until the epoch is not the key.
+    Then remove one waiter.
+notify() / notify_all():
+    a fence, then a relaxed load of the word. If there are no waiters, done.
+    Else increment the epoch and unpark one waiter, or all waiters.
+So a producer pays a fence and one relaxed load when nobody waits, and never writes a shared
+cache line. The fence pairs with the memory_order_seq_cst add of prepare_wait(): either the
+waiter's second check sees the item, or the notifier sees the waiter.
+On x86 the push is usually a locked compare and swap which is already a full fence;
+the fence is needed by the C++ memory model all the same.
+
+notify() wakes one parked waiter, so many consumers of a queue do not all wake for one item.
+Waiters that are still spinning see the epoch move too; they recheck the container and wait again.
+*/
+
+namespace lockfree
+{
+
+class eventcount
+{
+public:
+    typedef std::uint32_t key;
+
+    eventcount() : m_word{ 0 }
+    {
+    }
+
+    eventcount(const eventcount &) = delete;
+    eventcount & operator=(const eventcount &) = delete;
+
+    key prepare_wait()
+    {
+        // memory_order_seq_cst due to the waiter's second check of the container following this, see Design.
+        auto word = m_word.fetch_add(one_waiter, memory_order_seq_cst);
+        return static_cast<key>(word >> epoch_shift);
+    }
+
+    void cancel_wait()
+    {
+        m_word.fetch_sub(one_waiter, memory_order_relaxed);
+    }
+
+    void commit_wait(key k)
+    {
+        parking_lot::spin_then_park(&m_word, [this, k]() { return epoch() != k; });
+        m_word.fetch_sub(one_waiter, memory_order_relaxed);
+    }
+
+    void notify()
+    {
+        if (have_waiters())
+        {
+            m_word.fetch_add(one_epoch, memory_order_seq_cst);
+            parking_lot::unpark_one(&m_word);
+        }
+    }
+
+    void notify_all()
+    {
+        if (have_waiters())
+        {
+            m_word.fetch_add(one_epoch, memory_order_seq_cst);
+            parking_lot::unpark_all(&m_word);
+        }
+    }
+
+    // Waits until condition() returns true.
+    template<typename Condition>
+    void await(Condition condition)
+    {
+        for (;;)
+        {
+            if (condition())
+            {
+                return;
+            }
+            auto k = prepare_wait();
+            if (condition())
+            {
+                cancel_wait();
+                return;
+            }
+            commit_wait(k);
+        }
+    }
+
+private:
+    static const unsigned int epoch_shift = 32;
+    static const std::uint64_t one_waiter = 1;
+    static const std::uint64_t one_epoch = std::uint64_t(1) << epoch_shift;
+    static const std::uint64_t waiter_mask = one_epoch - 1;
+
+    key epoch() const
+    {
+        // memory_order_acquire due to the container read by the waiter after this must see the notifier's writes.
+        return static_cast<key>(m_word.load(memory_order_acquire) >> epoch_shift);
+    }
+
+    bool have_waiters() const
+    {
+        // memory_order_seq_cst fence due to the notifier's write to the container before this, see Design.
+        std::atomic_thread_fence(memory_order_seq_cst);
+        return (m_word.load(memory_order_relaxed) & waiter_mask) != 0;
+    }
+
+    std::atomic<std::uint64_t> m_word;
+};
+
+}
@@ -0,0 +1,85 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "../parking_lot/parking_lot.h"
+
+#include <atomic>
+#include <stdexcept>
+
+using std::memory_order_acquire;
+using std::memory_order_acq_rel;
+
+// User mode latch implementation using C++11.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+The interface adheres to the C++20 latch interface.
+
+Design:
+A counter counts down to zero. Waiters spin for the calibrated budget, then park on the counter.
+The count_down() that reaches zero unparks all. That is the only time the latch enters the kernel,
+and only if some waiter actually parked.
+*/
+
+namespace lockfree
+{
+
+class latch
+{
+public:
+    explicit latch(std::ptrdiff_t expected) : m_count{ expected }
+    {
+        if (expected < 0)
+        {
+            throw std::invalid_argument("latch count must not be negative.");
+        }
+    }
+
+    latch(const latch &) = delete;
+    latch & operator=(const latch &) = delete;
+
+    void count_down(std::ptrdiff_t update = 1)
+    {
+        // memory_order_acq_rel due to
+        //      release: all writes issued before this must 'happen before' the waiters return.
+        //      acquire: the last counter must see all writes of the others before unparking.
+        auto previous = m_count.fetch_sub(update, memory_order_acq_rel);
+        if (previous < update)
+        {
+            throw std::logic_error("latch counted down below zero.");
+        }
+        if (previous == update)
+        {
+            parking_lot::unpark_all(&m_count);
+        }
+    }
+
+    bool try_wait() const
+    {
+        return m_count.load(memory_order_acquire) == 0;
+    }
+
+    void wait() const
+    {
+        parking_lot::spin_then_park(&m_count, [this]() { return try_wait(); });
+    }
+
+    void arrive_and_wait(std::ptrdiff_t update = 1)
+    {
+        count_down(update);
+        wait();
+    }
+
+private:
+    std::atomic<std::ptrdiff_t> m_count;
+};
+
+}
@@ -0,0 +1,175 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "../parking_lot/parking_lot.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_seq_cst;
+
+// User mode counting semaphore implementation using C++11.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+The interface adheres to the C++20 counting_semaphore interface, except that max() is a runtime value.
+release() beyond max() clamps the count at max(), where C++20 leaves it undefined.
+So binary_semaphore, with a max() of 1, lets one acquirer through however many times it is released.
+
+Design:
+A counter holds the available count. A second counter holds the count of parked or parking waiters.
+acquire():
+    fast path: compare and swap count to count - 1, if count is positive.
+    slow path: spin for the calibrated budget, then register as a waiter and park on the counter
+        for as long as the count is zero.
+release(n):
+    add n to count, clamped at max(). Only if there are waiters, unpark up to as many as were added.
+    The clamp takes a compare and swap loop instead of the add, only for a max() below the default.
+So when nobody waits, release() is one atomic add and one load, and never enters the kernel.
+
+The waiter registers before its last check of count, and release() checks for waiters after
+adding to count. Both use memory_order_seq_cst, so at least one of the two sees the other,
+and a wake-up cannot be lost.
+The waiter takes its permit with try_acquire() as the done() of parking_lot::spin_then_park,
+which returns as soon as done() returns true, so a permit is taken exactly once.
+*/
+
+namespace lockfree
+{
+
+class counting_semaphore
+{
+public:
+    explicit counting_semaphore(std::ptrdiff_t desired, std::ptrdiff_t max = default_max()) :
+        m_max(max), m_count{ desired }, m_waiters{ 0 }
+    {
+        if (desired < 0 || max < 1 || desired > max)
+        {
+            throw std::invalid_argument("counting_semaphore initial count must be within 0 and max, and max positive.");
+        }
+    }
+
+    static std::ptrdiff_t default_max()
+    {
+        return std::numeric_limits<std::ptrdiff_t>::max();
+    }
+
+    counting_semaphore(const counting_semaphore &) = delete;
+    counting_semaphore & operator=(const counting_semaphore &) = delete;
+
+    std::ptrdiff_t max() const
+    {
+        return m_max;
+    }
+
+    void release(std::ptrdiff_t update = 1)
+    {
+        if (m_max == default_max())
+        {
+            m_count.fetch_add(update, memory_order_seq_cst);
+        }
+        else
+        {
+            // memory_order_relaxed due to the compare and swap below checks it.
+            auto count = m_count.load(memory_order_relaxed);
+            std::ptrdiff_t added;
+            // memory_order_seq_cst on success due to the waiters check below, see Design.
+            // memory_order_relaxed on failure due to count only used to retry.
+            do
+            {
+                added = (update < m_max - count) ? update : m_max - count;
+                if (added <= 0)
+                {
+                    return;
+                }
+            } while (!m_count.compare_exchange_weak(count, count + added, memory_order_seq_cst, memory_order_relaxed));
+            update = added;
+        }
+
+        if (m_waiters.load(memory_order_seq_cst))
+        {
+            for (std::ptrdiff_t i = 0; i < update; ++i)
+            {
+                if (!parking_lot::unpark_one(&m_count).have_more)
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    void acquire()
+    {
+        if (try_acquire())
+        {
+            return;
+        }
+
+        m_waiters.fetch_add(1, memory_order_seq_cst);
+        parking_lot::spin_then_park(&m_count, [this]() { return try_acquire(); });
+        m_waiters.fetch_sub(1, memory_order_relaxed);
+    }
+
+    bool try_acquire()
+    {
+        // memory_order_seq_cst due to this being the waiter's check of count after registering, see Design.
+        auto count = m_count.load(memory_order_seq_cst);
+        while (count > 0)
+        {
+            // memory_order_acquire on success due to all reads issued after this must 'happen after' the release().
+            if (m_count.compare_exchange_weak(count, count - 1, memory_order_acquire, memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template<typename Rep, typename Period>
+    bool try_acquire_for(const std::chrono::duration<Rep, Period> & rel_time)
+    {
+        return try_acquire_until(std::chrono::steady_clock::now() + rel_time);
+    }
+
+    template<typename Clock, typename Duration>
+    bool try_acquire_until(const std::chrono::time_point<Clock, Duration> & abs_time)
+    {
+        if (try_acquire())
+        {
+            return true;
+        }
+
+        m_waiters.fetch_add(1, memory_order_seq_cst);
+        auto acquired = parking_lot::spin_then_park_until(&m_count, [this]() { return try_acquire(); }, abs_time);
+        m_waiters.fetch_sub(1, memory_order_relaxed);
+        return acquired;
+    }
+
+private:
+    const std::ptrdiff_t m_max;
+    std::atomic<std::ptrdiff_t> m_count;
+    std::atomic<unsigned int> m_waiters;
+};
+
+class binary_semaphore : public counting_semaphore
+{
+public:
+    explicit binary_semaphore(std::ptrdiff_t desired) : counting_semaphore(desired, 1)
+    {
+    }
+};
+
+}
@@ -0,0 +1,132 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread test_barrier.cpp
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "barrier.h"
+
+#include <iostream>
+#include <future>
+#include <vector>
+#include <stdexcept>
+
+using std::cout;
+using std::vector;
+using std::logic_error;
+using std::flush;
+using std::future;
+using std::atomic;
+
+using lockfree::barrier;
+using lockfree::tree_barrier;
+
+//
+// Each phase every thread writes its own slot, then after the barrier
+// checks that every other slot has been written for this phase.
+//
+void check_phase(const vector<atomic<int>> & slots, int phase)
+{
+    for (auto & s : slots)
+    {
+        if (s.load(std::memory_order_relaxed) < phase)
+        {
+            throw logic_error("thread passed barrier before all threads arrived.");
+        }
+    }
+}
+
+bool run_phases(const char * name, unsigned int threads, int phases, bool tree)
+{
+    barrier b(threads);
+    tree_barrier tb(threads);
+    vector<atomic<int>> slots(threads);
+    for (auto & s : slots)
+    {
+        s.store(0);
+    }
+
+    bool failed = false;
+    {
+        vector<future<void>> vf;
+        for (unsigned int t = 0; t < threads; ++t)
+        {
+            vf.emplace_back(async(std::launch::async, [&, t]() {
+                for (int p = 1; p <= phases; ++p)
+                {
+                    slots[t].store(p, std::memory_order_relaxed);
+                    if (tree) tb.arrive_and_wait(t); else b.arrive_and_wait();
+                    check_phase(slots, p);
+                    // a second barrier so nobody writes the next phase before all have checked.
+                    if (tree) tb.arrive_and_wait(t); else b.arrive_and_wait();
+                }
+            }));
+        }
+        try
+        {
+            for (auto & task : vf)
+            {
+                task.get();
+            }
+        }
+        catch (std::exception & e)
+        {
+            failed = true;
+#ifdef PRINT_TRACE
+            std::cerr << "\n" << e.what() << std::flush;
+#endif
+        }
+    }
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : parallelism test - " << name << " " << threads << " threads " << phases << " phases." << std::flush;
+    return !failed;
+}
+
+bool testcase_sanity()
+{
+    bool bResult = false;
+    try
+    {
+        // a single thread never waits.
+        barrier b(1);
+        tree_barrier tb(1);
+        for (int p = 0; p < 3; ++p)
+        {
+            b.arrive_and_wait();
+            tb.arrive_and_wait(0);
+        }
+
+        bool threw = false;
+        try { tb.arrive_and_wait(1); } catch (std::out_of_range &) { threw = true; }
+        if (!threw) throw logic_error("bad thread id not detected.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - single thread barrier." << std::flush;
+    return bResult;
+}
+
+#define RUN_TEST(...) { if (!(__VA_ARGS__)) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity());
+    RUN_TEST(run_phases("barrier", 8, 50, false));
+    RUN_TEST(run_phases("tree_barrier", 8, 50, true));
+    // 3 levels of a 4-ary tree.
+    RUN_TEST(run_phases("tree_barrier", 64, 10, true));
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
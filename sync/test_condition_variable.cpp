@@ -0,0 +1,203 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++14 -pthread test_condition_variable.cpp
+//
+// Note: C++14 is needed for compiling test only, not condition_variable.h
+// It is because we wait holding the wrapper 'shared_lock' from C++14.
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "condition_variable.h"
+#include "../mutex/shared_mutex.h"
+
+#include <mutex>
+#include <shared_mutex>
+#include <iostream>
+#include <future>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <stdexcept>
+
+using std::cout;
+using std::vector;
+using std::deque;
+using std::logic_error;
+using std::flush;
+using std::future;
+using std::unique_lock;
+using std::shared_lock;
+namespace chrono = std::chrono;
+
+using lockfree::condition_variable;
+using lockfree::shared_mutex;
+
+bool testcase_sanity()
+{
+    bool bResult = false;
+    try
+    {
+        shared_mutex m;
+        condition_variable cv;
+
+        // notify with no waiters is harmless.
+        cv.notify_one();
+        cv.notify_all();
+
+        unique_lock<shared_mutex> lk(m);
+        auto start = chrono::steady_clock::now();
+        if (cv.wait_for(lk, chrono::milliseconds(20)) != std::cv_status::timeout) throw logic_error("wait did not time out.");
+        if (chrono::steady_clock::now() - start < chrono::milliseconds(20)) throw logic_error("wait returned early.");
+        if (cv.wait_for(lk, chrono::milliseconds(1), []() { return true; }) != true) throw logic_error("true predicate not honoured.");
+        if (cv.wait_for(lk, chrono::milliseconds(1), []() { return false; }) != false) throw logic_error("false predicate not honoured.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - single threaded timed wait." << std::flush;
+    return bResult;
+}
+
+// Consumers wait in exclusive mode on an empty deque.
+bool testcase_exclusive()
+{
+    static const int consumers = 4;
+    static const int items = 1000;
+
+    shared_mutex m;
+    condition_variable cv;
+    deque<int> d;
+    long long sum = 0;
+
+    vector<future<void>> vf;
+    for (int t = 0; t < consumers; ++t)
+    {
+        vf.emplace_back(async(std::launch::async, [&]() {
+            for (int c = 0; c < items; ++c)
+            {
+                unique_lock<shared_mutex> lk(m);
+                cv.wait(lk, [&d]() { return !d.empty(); });
+                sum += d.front();
+                d.pop_front();
+            }
+        }));
+    }
+    for (int c = 0; c < consumers * items; ++c)
+    {
+        {
+            unique_lock<shared_mutex> lk(m);
+            d.push_back(c);
+        }
+        cv.notify_one();
+        if (c % 256 == 0) std::this_thread::sleep_for(chrono::microseconds(200));
+    }
+    for (auto & task : vf)
+    {
+        task.wait();
+    }
+
+    long long n = consumers * items;
+    bool failed = (sum != n * (n - 1) / 2);
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : parallelism test - wait holding exclusive access." << std::flush;
+    return !failed;
+}
+
+// Readers wait in shared mode for a writer to publish.
+bool testcase_shared()
+{
+    static const int readers = 8;
+
+    shared_mutex m;
+    condition_variable cv;
+    int published = 0;
+
+    vector<future<int>> vf;
+    for (int t = 0; t < readers; ++t)
+    {
+        vf.emplace_back(async(std::launch::async, [&]() {
+            shared_lock<shared_mutex> lk(m);
+            cv.wait(lk, [&published]() { return published != 0; });
+            return published;
+        }));
+    }
+
+    std::this_thread::sleep_for(chrono::milliseconds(20));
+    {
+        unique_lock<shared_mutex> lk(m);
+        published = 42;
+    }
+    cv.notify_all();
+
+    bool failed = false;
+    for (auto & task : vf)
+    {
+        if (task.get() != 42) failed = true;
+    }
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : parallelism test - wait holding shared access." << std::flush;
+    return !failed;
+}
+
+// notify_one wakes one parked waiter, not all.
+bool testcase_targeted()
+{
+    static const int waiters = 6;
+
+    shared_mutex m;
+    condition_variable cv;
+    std::atomic<int> woken{ 0 };
+
+    vector<future<void>> vf;
+    for (int t = 0; t < waiters; ++t)
+    {
+        vf.emplace_back(async(std::launch::async, [&]() {
+            unique_lock<shared_mutex> lk(m);
+            cv.wait(lk);
+            woken++;
+        }));
+    }
+
+    // long enough for all to spin out and park.
+    std::this_thread::sleep_for(chrono::milliseconds(50));
+    cv.notify_one();
+    std::this_thread::sleep_for(chrono::milliseconds(50));
+    auto after_one = woken.load();
+
+    cv.notify_all();
+    for (auto & task : vf)
+    {
+        task.wait();
+    }
+
+    bool failed = (after_one != 1) || (woken.load() != waiters);
+#ifdef PRINT_TRACE
+    if (failed) std::cerr << "\n woken after notify_one " << after_one << ", after notify_all " << woken.load();
+#endif
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : targeted test - notify_one wakes one parked waiter." << std::flush;
+    return !failed;
+}
+
+#define RUN_TEST(testcase) { if (!testcase()) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity);
+    RUN_TEST(testcase_exclusive);
+    RUN_TEST(testcase_shared);
+    RUN_TEST(testcase_targeted);
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
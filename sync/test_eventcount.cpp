@@ -0,0 +1,172 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread -mcx16 test_eventcount.cpp -latomic
+//
+// This test shows how to add blocking pop to a lock free container using the eventcount.
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "eventcount.h"
+#include "../queue/queue.h"
+#include "../stack/stack.h"
+
+#include <iostream>
+#include <future>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+
+using std::cout;
+using std::vector;
+using std::logic_error;
+using std::flush;
+using std::future;
+using std::atomic;
+namespace chrono = std::chrono;
+
+using lockfree::eventcount;
+
+// Blocking pop, as in the eventcount Notes.
+template<typename container_type, typename T>
+void blocking_pop(container_type & c, eventcount & ec, T & item)
+{
+    for (;;)
+    {
+        if (c.pop(item)) return;
+        auto key = ec.prepare_wait();
+        if (c.pop(item))
+        {
+            ec.cancel_wait();
+            return;
+        }
+        ec.commit_wait(key);
+    }
+}
+
+bool testcase_sanity()
+{
+    bool bResult = false;
+    try
+    {
+        eventcount ec;
+
+        // notify with no waiters is harmless.
+        ec.notify();
+        ec.notify_all();
+
+        // an epoch change between prepare and commit means no sleep.
+        auto key = ec.prepare_wait();
+        ec.cancel_wait();
+        key = ec.prepare_wait();
+        ec.notify();
+        ec.commit_wait(key);
+
+        ec.await([]() { return true; });
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - single threaded prepare, cancel, commit." << std::flush;
+    return bResult;
+}
+
+// Consumers block on an empty container. Producers push in bursts with pauses so consumers park.
+template<typename container_type>
+bool testcase_blocking_pop(const char * name)
+{
+    static const int producers = 2;
+    static const int consumers = 4;
+    static const int items = 2000;
+
+    container_type c;
+    eventcount ec;
+    atomic<long long> sum{ 0 };
+
+    {
+        vector<future<void>> vf;
+        for (int t = 0; t < consumers; ++t)
+        {
+            vf.emplace_back(async(std::launch::async, [&]() {
+                for (int i = 0; i < producers * items / consumers; ++i)
+                {
+                    int item = 0;
+                    blocking_pop(c, ec, item);
+                    sum += item;
+                }
+            }));
+        }
+        for (int t = 0; t < producers; ++t)
+        {
+            vf.emplace_back(async(std::launch::async, [&]() {
+                for (int i = 1; i <= items; ++i)
+                {
+                    c.push(i);
+                    ec.notify();
+                    if (i % 128 == 0) std::this_thread::sleep_for(chrono::microseconds(500));
+                }
+            }));
+        }
+        for (auto & task : vf)
+        {
+            task.wait();
+        }
+    }
+
+    long long expected = producers * (static_cast<long long>(items) * (items + 1) / 2);
+    bool failed = (sum.load() != expected);
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : parallelism test - blocking pop on " << name << "." << std::flush;
+    return !failed;
+}
+
+// await on a flag.
+bool testcase_await()
+{
+    static const int waiters = 8;
+
+    eventcount ec;
+    atomic<bool> flag{ false };
+
+    vector<future<void>> vf;
+    for (int t = 0; t < waiters; ++t)
+    {
+        vf.emplace_back(async(std::launch::async, [&]() {
+            ec.await([&flag]() { return flag.load(std::memory_order_acquire); });
+        }));
+    }
+    std::this_thread::sleep_for(chrono::milliseconds(20));
+    flag.store(true, std::memory_order_release);
+    ec.notify_all();
+
+    bool failed = false;
+    for (auto & task : vf)
+    {
+        if (task.wait_for(chrono::seconds(10)) != std::future_status::ready) failed = true;
+    }
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : parallelism test - await wakes all on notify_all." << std::flush;
+    return !failed;
+}
+
+#define RUN_TEST(...) { if (!(__VA_ARGS__)) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity());
+    RUN_TEST(testcase_blocking_pop<lockfree::queue<int>>("queue"));
+    RUN_TEST(testcase_blocking_pop<lockfree::stack<int>>("stack"));
+    RUN_TEST(testcase_await());
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
@@ -0,0 +1,106 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread test_latch.cpp
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "latch.h"
+
+#include <iostream>
+#include <future>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+
+using std::cout;
+using std::vector;
+using std::logic_error;
+using std::flush;
+using std::future;
+using std::atomic;
+namespace chrono = std::chrono;
+
+using lockfree::latch;
+
+bool testcase_sanity()
+{
+    bool bResult = false;
+    try
+    {
+        latch l(3);
+        if (l.try_wait()) throw logic_error("latch open before count down.");
+        l.count_down(2);
+        if (l.try_wait()) throw logic_error("latch open too early.");
+        l.count_down();
+        if (!l.try_wait()) throw logic_error("latch not open at zero.");
+        l.wait();
+
+        bool threw = false;
+        try { l.count_down(); } catch (std::logic_error &) { threw = true; }
+        if (!threw) throw logic_error("count down below zero not detected.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - single threaded count down." << std::flush;
+    return bResult;
+}
+
+// Workers publish results, then count down. The waiter must see all results.
+bool testcase_parallelism()
+{
+    static const int workers = 16;
+
+    latch done(workers);
+    latch start(1);
+    vector<int> results(workers, 0);
+
+    vector<future<void>> vf;
+    for (int t = 0; t < workers; ++t)
+    {
+        vf.emplace_back(async(std::launch::async, [&done, &start, &results, t]() {
+            // parked on start until the main thread opens it.
+            start.wait();
+            results[t] = t + 1;
+            done.count_down();
+        }));
+    }
+
+    std::this_thread::sleep_for(chrono::milliseconds(20));
+    start.count_down();
+    done.wait();
+
+    bool failed = false;
+    for (int t = 0; t < workers; ++t)
+    {
+        if (results[t] != t + 1) failed = true;
+    }
+    for (auto & task : vf)
+    {
+        task.wait();
+    }
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : parallelism test - waiters released with all writes visible." << std::flush;
+    return !failed;
+}
+
+#define RUN_TEST(testcase) { if (!testcase()) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity);
+    RUN_TEST(testcase_parallelism);
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
@@ -0,0 +1,282 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread test_semaphore.cpp
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "semaphore.h"
+
+#include <iostream>
+#include <future>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+
+using std::cout;
+using std::vector;
+using std::logic_error;
+using std::flush;
+using std::future;
+using std::atomic;
+namespace chrono = std::chrono;
+
+using lockfree::counting_semaphore;
+using lockfree::binary_semaphore;
+using lockfree::spin_calibration;
+
+bool testcase_sanity()
+{
+    bool bResult = false;
+    try
+    {
+        counting_semaphore s(2);
+
+        if (!s.try_acquire() || !s.try_acquire()) throw logic_error("initial count not available.");
+        if (s.try_acquire()) throw logic_error("acquired beyond count.");
+
+        auto start = chrono::steady_clock::now();
+        if (s.try_acquire_for(chrono::milliseconds(20))) throw logic_error("timed acquire did not time out.");
+        if (chrono::steady_clock::now() - start < chrono::milliseconds(20)) throw logic_error("timed acquire returned early.");
+
+        s.release(2);
+        s.acquire();
+        s.acquire();
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - single threaded acquire release." << std::flush;
+    return bResult;
+}
+
+// Semaphore bounds concurrency. Threads also block long enough now and then to park.
+bool testcase_parallelism()
+{
+    static const int permits = 3;
+    static const int threads = 12;
+    static const int rounds = 500;
+
+    counting_semaphore s(permits);
+    atomic<int> inside{ 0 };
+
+    bool failed = false;
+    {
+        vector<future<void>> vf;
+        for (int t = 0; t < threads; ++t)
+        {
+            vf.emplace_back(async(std::launch::async, [&s, &inside]() {
+                for (int c = 0; c < rounds; ++c)
+                {
+                    s.acquire();
+                    if (inside.fetch_add(1) >= permits) throw logic_error("more threads inside than permits.");
+                    if (c % 100 == 0) std::this_thread::sleep_for(chrono::microseconds(200));
+                    inside.fetch_sub(1);
+                    s.release();
+                }
+            }));
+        }
+        try
+        {
+            for (auto & task : vf)
+            {
+                task.get();
+            }
+        }
+        catch (std::exception & e)
+        {
+            failed = true;
+#ifdef PRINT_TRACE
+            std::cerr << "\n" << e.what() << std::flush;
+#endif
+        }
+    }
+
+    // all permits must be back.
+    for (int p = 0; p < permits; ++p)
+    {
+        if (!s.try_acquire()) failed = true;
+    }
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : parallelism test - semaphore bounds concurrency." << std::flush;
+    return !failed;
+}
+
+// Consumers blocked on an empty semaphore must all be woken by producers.
+bool testcase_handoff()
+{
+    static const int consumers = 6;
+    static const int items = 200;
+
+    counting_semaphore s(0);
+    atomic<int> consumed{ 0 };
+
+    vector<future<void>> vf;
+    for (int t = 0; t < consumers; ++t)
+    {
+        vf.emplace_back(async(std::launch::async, [&s, &consumed]() {
+            for (int c = 0; c < items; ++c)
+            {
+                s.acquire();
+                consumed++;
+            }
+        }));
+    }
+    for (int c = 0; c < consumers * items; ++c)
+    {
+        s.release();
+        if (c % 64 == 0) std::this_thread::sleep_for(chrono::microseconds(100));
+    }
+    for (auto & task : vf)
+    {
+        task.wait();
+    }
+
+    bool failed = (consumed.load() != consumers * items);
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : handoff test - blocked acquirers woken by release." << std::flush;
+    return !failed;
+}
+
+// Releases beyond max() are clamped, so a binary semaphore lets one acquirer through.
+bool testcase_binary()
+{
+    bool bResult = false;
+    try
+    {
+        binary_semaphore b(0);
+        if (b.max() != 1) throw logic_error("binary semaphore max not 1.");
+        b.release();
+        b.release();
+        if (!b.try_acquire()) throw logic_error("released permit not available.");
+        if (b.try_acquire()) throw logic_error("second release not clamped.");
+
+        counting_semaphore s(1, 3);
+        s.release(5);
+        int taken = 0;
+        while (s.try_acquire())
+        {
+            taken++;
+        }
+        if (taken != 3) throw logic_error("count not clamped at max.");
+
+        bool threw = false;
+        try
+        {
+            binary_semaphore bad(2);
+        }
+        catch (std::invalid_argument &)
+        {
+            threw = true;
+        }
+        if (!threw) throw logic_error("initial count above max accepted.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : binary test - releases beyond max are clamped." << std::flush;
+    return bResult;
+}
+
+// With no spin phase every acquire that misses parks at once, so the park validator,
+// which takes the permit, succeeds often. Each permit must be taken exactly once.
+bool testcase_no_spin(bool timed)
+{
+    static const int producers = 4;
+    static const int consumers = 4;
+    static const int per_thread = 100000;
+
+    auto saved = spin_calibration::budget();
+    auto no_spin = saved;
+    no_spin.spins_before_park = 0;
+    spin_calibration::set(no_spin);
+
+    counting_semaphore s(0);
+    atomic<int> acquired{ 0 };
+
+    vector<future<void>> vf;
+    for (int t = 0; t < consumers; ++t)
+    {
+        vf.emplace_back(async(std::launch::async, [&s, &acquired, timed]() {
+            for (int c = 0; c < per_thread; ++c)
+            {
+                if (timed)
+                {
+                    while (!s.try_acquire_for(chrono::milliseconds(10)))
+                    {
+                    }
+                }
+                else
+                {
+                    s.acquire();
+                }
+                acquired++;
+            }
+        }));
+    }
+    for (int t = 0; t < producers; ++t)
+    {
+        vf.emplace_back(async(std::launch::async, [&s]() {
+            for (int c = 0; c < per_thread; ++c)
+            {
+                s.release();
+            }
+        }));
+    }
+
+    // A lost permit leaves consumers blocked. Free them after a deadline, and report the failure.
+    bool hung = false;
+    for (auto & task : vf)
+    {
+        while (task.wait_for(chrono::seconds(30)) != std::future_status::ready)
+        {
+            hung = true;
+            s.release(consumers * per_thread);
+        }
+    }
+
+    int leftover = 0;
+    while (!hung && s.try_acquire())
+    {
+        leftover++;
+    }
+    spin_calibration::set(saved);
+
+    bool failed = hung || (acquired.load() != consumers * per_thread) || (leftover != 0);
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : no spin test - " << (timed ? "timed acquire" : "acquire") << ", spins before park 0, acquired "
+        << acquired.load() << " of " << consumers * per_thread << ", leftover permits " << leftover << (hung ? ", consumers hung" : "") << "." << std::flush;
+    return !failed;
+}
+
+#define RUN_TEST(...) { if (!(__VA_ARGS__)) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity());
+    RUN_TEST(testcase_parallelism());
+    RUN_TEST(testcase_handoff());
+    RUN_TEST(testcase_binary());
+    RUN_TEST(testcase_no_spin(false));
+    RUN_TEST(testcase_no_spin(true));
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
@@ -0,0 +1,160 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread -march=native test_timer_wheel.cpp -latomic
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "timer_wheel.h"
+
+#include <iostream>
+#include <future>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+
+using std::cout;
+using std::vector;
+using std::logic_error;
+using std::flush;
+using std::future;
+using std::atomic;
+namespace chrono = std::chrono;
+
+using lockfree::timer_wheel;
+
+bool testcase_sanity()
+{
+    bool bResult = false;
+    try
+    {
+        timer_wheel wheel(chrono::milliseconds(1), false);
+        auto t0 = timer_wheel::clock::now();
+        int fired = 0;
+
+        auto id = wheel.schedule_at(t0 + chrono::milliseconds(5), [&fired]() { fired++; });
+        if (wheel.advance(t0 + chrono::milliseconds(4)) != 0) throw logic_error("fired early.");
+        if (wheel.advance(t0 + chrono::milliseconds(6)) != 1 || fired != 1) throw logic_error("did not fire.");
+        if (wheel.cancel(id)) throw logic_error("cancelled after firing.");
+
+        id = wheel.schedule_at(t0 + chrono::milliseconds(10), [&fired]() { fired++; });
+        if (!wheel.cancel(id)) throw logic_error("cancel failed.");
+        if (wheel.cancel(id)) throw logic_error("cancelled twice.");
+        if (wheel.advance(t0 + chrono::milliseconds(20)) != 0 || fired != 1) throw logic_error("cancelled timer fired.");
+
+        // a timer in the past fires at the next advance.
+        wheel.schedule_at(t0, [&fired]() { fired++; });
+        if (wheel.advance(t0 + chrono::milliseconds(20)) != 1) throw logic_error("past timer did not fire.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : sanity test - single threaded schedule, fire, cancel." << std::flush;
+    return bResult;
+}
+
+// Timers at the edges of every level, and beyond the span of the wheel, fire on time.
+bool testcase_levels()
+{
+    bool bResult = false;
+    try
+    {
+        timer_wheel wheel(chrono::milliseconds(1), false);
+        auto t0 = timer_wheel::clock::now();
+
+        const long long delays[] = { 1, 2, 63, 64, 65, 127, 128, 4095, 4096, 4097, 262143, 262144, 262145,
+            16777215, 16777216, 16777300, 40000000 };
+        vector<long long> fired_at;
+        long long now_ms = 0;
+
+        for (auto d : delays)
+        {
+            wheel.schedule_at(t0 + chrono::milliseconds(d), [&fired_at, &now_ms]() { fired_at.push_back(now_ms); });
+        }
+
+        // advance one millisecond at a time around each expiry, and in big steps in between.
+        const size_t count = sizeof(delays) / sizeof(delays[0]);
+        for (size_t i = 0; i < count; ++i)
+        {
+            now_ms = delays[i] - 1;
+            wheel.advance(t0 + chrono::milliseconds(now_ms));
+            if (fired_at.size() != i) throw logic_error("fired early.");
+            now_ms = delays[i] + 1;
+            wheel.advance(t0 + chrono::milliseconds(now_ms));
+            if (fired_at.size() != i + 1) throw logic_error("did not fire on time, delay " + std::to_string(delays[i]));
+        }
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : levels test - cascade across all levels and beyond the span." << std::flush;
+    return bResult;
+}
+
+// Many threads schedule and cancel timers, fired by the wheel's own tick thread.
+bool testcase_parallelism()
+{
+    static const int threads = 4;
+    static const int timers = 5000;
+
+    atomic<int> fired{ 0 };
+    atomic<int> cancelled{ 0 };
+    {
+        timer_wheel wheel;
+        vector<future<void>> vf;
+        for (int t = 0; t < threads; ++t)
+        {
+            vf.emplace_back(async(std::launch::async, [&wheel, &fired, &cancelled]() {
+                for (int i = 0; i < timers; ++i)
+                {
+                    auto id = wheel.schedule_after(chrono::milliseconds(i % 20), [&fired]() { fired++; });
+                    if ((i % 2) && wheel.cancel(id))
+                    {
+                        cancelled++;
+                    }
+                }
+            }));
+        }
+        for (auto & task : vf)
+        {
+            task.wait();
+        }
+        std::this_thread::sleep_for(chrono::milliseconds(100));
+    }
+
+    bool failed = (fired.load() + cancelled.load() != threads * timers) || (cancelled.load() == 0);
+#ifdef PRINT_TRACE
+    if (failed) std::cerr << "\n fired " << fired.load() << " cancelled " << cancelled.load();
+#endif
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : parallelism test - concurrent schedule and cancel with tick thread." << std::flush;
+    return !failed;
+}
+
+#define RUN_TEST(testcase) { if (!testcase()) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity);
+    RUN_TEST(testcase_levels);
+    RUN_TEST(testcase_parallelism);
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
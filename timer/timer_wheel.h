@@ -0,0 +1,361 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "../queue/queue.h"
+#include "../stack/stack.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_release;
+using std::memory_order_acq_rel;
+
+// Hierarchical timer wheel with lock free insertion and cancellation, using C++11.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread -march=native
+//      arch option is needed by lockfree::queue and lockfree::stack.
+
+/*
+Notes:
+    lockfree::timer_wheel wheel;        // 1 millisecond resolution, own tick thread.
+    auto id = wheel.schedule_after(std::chrono::milliseconds(50), []() { ... });
+    wheel.cancel(id);
+schedule_after(), schedule_at() and cancel() can be called from any thread. They are O(1) and lock free.
+Callbacks run on the tick thread, in batches, one tick at a time. A callback must be short;
+a long callback delays the timers behind it.
+A timer fires at the first tick at or after its expiry, so up to one resolution late, never early.
+With own_thread false no tick thread is started, and the owner calls advance() itself, eg. from an event loop.
+
+Design:
+4 levels of 64 slots. Level l slots are 64^l ticks wide, so the wheel spans 64^4 ticks,
+about 4.6 hours at 1 millisecond. A timer further out waits in the top level slot that comes around last,
+and is placed again when that slot comes around.
+A slot is a singly linked list of timer nodes. The slots are only accessed by the tick thread.
+Insertion:
+    take a node from the free pool, a lockfree::stack, and push it to the incoming lockfree::queue.
+    The tick thread drains the incoming queue into the slots once per advance().
+Cancellation:
+    the node state word holds a generation and a status. timer_id holds the node and generation.
+    cancel() is one compare and swap of the status from pending to cancelled for that generation.
+    The tick thread sees the cancelled status when it reaches the node, and recycles it without firing.
+    So a cancelled timer holds its node until its expiry tick, which keeps cancel() O(1).
+    A timer_id of a node that has been recycled has an old generation, so cancel() on it fails safely.
+Tick:
+    level 0 slot of the new tick fires. When the level 0 index wraps to 0, the current slot of
+    level 1 is cascaded: its nodes are placed again, now into lower levels. Likewise up the levels.
+    A node is placed at the lowest level whose span covers its delay, in the slot of its expiry at that level.
+    That slot comes around no later than the expiry, at which point the node is placed again, lower.
+Nodes are never returned to the memory allocator until the wheel is destroyed,
+so a timer_id never dangles.
+*/
+
+namespace lockfree
+{
+
+class timer_wheel
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    static const unsigned int level_bits = 6;
+    static const unsigned int slot_count = 1 << level_bits;
+    static const unsigned int level_count = 4;
+
+    class timer_id
+    {
+    public:
+        timer_id() : m_pNode(nullptr), m_generation(0)
+        {
+        }
+
+    private:
+        friend class timer_wheel;
+
+        timer_id(void * pNode, std::uint64_t generation) : m_pNode(pNode), m_generation(generation)
+        {
+        }
+
+        void * m_pNode;
+        std::uint64_t m_generation;
+    };
+
+    explicit timer_wheel(clock::duration resolution = std::chrono::milliseconds(1), bool own_thread = true) :
+        m_resolution(resolution),
+        m_start(clock::now()),
+        m_now(0),
+        m_stop{ false }
+    {
+        for (auto & level : m_slots)
+        {
+            for (auto & pSlot : level)
+            {
+                pSlot = nullptr;
+            }
+        }
+
+        if (own_thread)
+        {
+            m_thread = std::thread([this]() { run(); });
+        }
+    }
+
+    timer_wheel(const timer_wheel &) = delete;
+    timer_wheel & operator=(const timer_wheel &) = delete;
+
+    // Timers still pending are dropped without firing.
+    ~timer_wheel()
+    {
+        m_stop.store(true, memory_order_release);
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+
+        node * pNode = nullptr;
+        while (m_allNodes.pop(pNode))
+        {
+            delete pNode;
+        }
+    }
+
+    template<typename Rep, typename Period, typename Callback>
+    timer_id schedule_after(const std::chrono::duration<Rep, Period> & delay, Callback callback)
+    {
+        return schedule_at(clock::now() + delay, callback);
+    }
+
+    template<typename Duration, typename Callback>
+    timer_id schedule_at(const std::chrono::time_point<clock, Duration> & when, Callback callback)
+    {
+        auto pNode = get_node();
+        pNode->callback = callback;
+        pNode->expiry = tick_of(when);
+
+        // Only the thread holding a free node writes its state, so a load and a store suffice.
+        auto generation = (pNode->state.load(memory_order_relaxed) >> status_bits) + 1;
+
+        // memory_order_release due to the node fields written above must be visible with the state.
+        pNode->state.store((generation << status_bits) | pending, memory_order_release);
+        m_incoming.push(pNode);
+        return timer_id(pNode, generation);
+    }
+
+    // Returns true if the timer was cancelled before it fired.
+    bool cancel(const timer_id & id)
+    {
+        if (!id.m_pNode)
+        {
+            return false;
+        }
+        auto pNode = static_cast<node *>(id.m_pNode);
+        auto expected = (id.m_generation << status_bits) | pending;
+        return pNode->state.compare_exchange_strong(expected, (id.m_generation << status_bits) | done,
+            memory_order_relaxed, memory_order_relaxed);
+    }
+
+    // Fires all timers due up to now. Returns the count fired.
+    // Only one thread may call advance(); the tick thread, if own_thread.
+    unsigned int advance(clock::time_point now = clock::now())
+    {
+        drain_incoming();
+
+        unsigned int fired = fire(m_due);
+        m_due = nullptr;
+
+        auto target = static_cast<std::uint64_t>((now - m_start) / m_resolution);
+        while (m_now < target)
+        {
+            m_now++;
+            cascade();
+
+            auto & slot = m_slots[0][m_now & (slot_count - 1)];
+            auto pList = slot;
+            slot = nullptr;
+            fired += fire(pList);
+        }
+        return fired;
+    }
+
+    clock::duration resolution() const
+    {
+        return m_resolution;
+    }
+
+private:
+    static const unsigned int status_bits = 2;
+    static const std::uint64_t pending = 1;
+    static const std::uint64_t done = 2;
+
+    struct node
+    {
+        node() : expiry(0), pNext(nullptr), state{ 0 }
+        {
+        }
+
+        std::function<void()> callback;
+        std::uint64_t expiry;
+        // link in a slot. Only accessed by the tick thread.
+        node * pNext;
+        // generation << status_bits | status.
+        std::atomic<std::uint64_t> state;
+    };
+
+    std::uint64_t tick_of(clock::time_point when) const
+    {
+        if (when <= m_start)
+        {
+            return 0;
+        }
+        // round up, so a timer never fires early.
+        return static_cast<std::uint64_t>((when - m_start + m_resolution - clock::duration(1)) / m_resolution);
+    }
+
+    node * get_node()
+    {
+        node * pNode = nullptr;
+        if (!m_freeNodes.pop(pNode))
+        {
+            pNode = new node;
+            m_allNodes.push(pNode);
+        }
+        return pNode;
+    }
+
+    void recycle(node * pNode)
+    {
+        // release the callback's captures now, not at reuse.
+        pNode->callback = nullptr;
+        m_freeNodes.push(pNode);
+    }
+
+    void drain_incoming()
+    {
+        node * pNode = nullptr;
+        while (m_incoming.pop(pNode))
+        {
+            place(pNode);
+        }
+    }
+
+    void place(node * pNode)
+    {
+        if (pNode->expiry <= m_now)
+        {
+            pNode->pNext = m_due;
+            m_due = pNode;
+            return;
+        }
+
+        // lowest level that spans the delay. Beyond the span of the wheel, wait in the top level
+        // slot that comes around last, and get placed again from there.
+        auto delay = pNode->expiry - m_now;
+        auto span = (std::uint64_t(1) << (level_bits * level_count)) - 1;
+        auto expiry = m_now + ((delay < span) ? delay : span);
+
+        unsigned int level = 0;
+        while (level < level_count - 1 && (delay >> (level_bits * (level + 1))))
+        {
+            level++;
+        }
+        auto index = (expiry >> (level_bits * level)) & (slot_count - 1);
+
+        auto & slot = m_slots[level][index];
+        pNode->pNext = slot;
+        slot = pNode;
+    }
+
+    // On a tick where lower level indices wrap to 0, place again the nodes of the current higher level slots.
+    void cascade()
+    {
+        for (unsigned int level = 1; level < level_count; ++level)
+        {
+            if (m_now & ((std::uint64_t(1) << (level_bits * level)) - 1))
+            {
+                break;
+            }
+
+            auto & slot = m_slots[level][(m_now >> (level_bits * level)) & (slot_count - 1)];
+            auto pNode = slot;
+            slot = nullptr;
+            while (pNode)
+            {
+                auto pNext = pNode->pNext;
+                place(pNode);
+                pNode = pNext;
+            }
+        }
+
+        // nodes placed due by the cascade fire with this tick.
+        if (m_due)
+        {
+            auto & slot = m_slots[0][m_now & (slot_count - 1)];
+            while (m_due)
+            {
+                auto pNext = m_due->pNext;
+                m_due->pNext = slot;
+                slot = m_due;
+                m_due = pNext;
+            }
+        }
+    }
+
+    unsigned int fire(node * pNode)
+    {
+        unsigned int fired = 0;
+        while (pNode)
+        {
+            auto pNext = pNode->pNext;
+            auto state = pNode->state.load(memory_order_relaxed);
+
+            // memory_order_acquire on success due to the callback written by the scheduling thread.
+            if (((state & pending) != 0) &&
+                pNode->state.compare_exchange_strong(state, (state & ~pending) | done, memory_order_acquire, memory_order_relaxed))
+            {
+                pNode->callback();
+                fired++;
+            }
+            recycle(pNode);
+            pNode = pNext;
+        }
+        return fired;
+    }
+
+    void run()
+    {
+        auto next = clock::now();
+        while (!m_stop.load(memory_order_acquire))
+        {
+            next += m_resolution;
+            std::this_thread::sleep_until(next);
+            advance(clock::now());
+        }
+    }
+
+    const clock::duration m_resolution;
+    const clock::time_point m_start;
+
+    // Tick thread only.
+    std::uint64_t m_now;
+    node * m_slots[level_count][slot_count];
+    node * m_due = nullptr;
+
+    queue<node *> m_incoming;
+    stack<node *> m_freeNodes;
+    stack<node *> m_allNodes;
+
+    std::atomic<bool> m_stop;
+    std::thread m_thread;
+};
+
+}
@@ -0,0 +1,147 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <ftw.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+// Fake sysfs tree in a temp directory, for tests of cpu_topology from topology.h.
+
+// To build using gcc need the following options
+//      -std=c++11
+
+/*
+Notes:
+    lockfree::simulated_sysfs sysfs({ "0-1", "2-3" });
+    sysfs.add_cpu(0, 0, 0, "0", "0-1", "0-1");
+    lockfree::cpu_topology t(sysfs.root());
+The constructor writes node/online and node/nodeN/cpulist, a node per cpulist.
+add_cpu() writes the core ids and the data and instruction caches of a cpu.
+The destructor removes the whole tree, so it is removed also when a test throws.
+Directories are made with mkdir(2), and removed with nftw(3), without a shell.
+*/
+
+namespace lockfree
+{
+
+class simulated_sysfs
+{
+public:
+    explicit simulated_sysfs(const std::vector<std::string> & node_cpulists)
+    {
+        char root[] = "/tmp/lockfree_sysfs_XXXXXX";
+        if (!mkdtemp(root))
+        {
+            throw std::runtime_error("cannot create temp directory for simulated sysfs.");
+        }
+        m_root = root;
+
+        try
+        {
+            std::string online = "0";
+            if (node_cpulists.size() > 1)
+            {
+                online += "-" + std::to_string(node_cpulists.size() - 1);
+            }
+            make_dir(m_root + "/node");
+            write(m_root + "/node/online", online);
+            for (std::size_t n = 0; n < node_cpulists.size(); ++n)
+            {
+                auto dir = m_root + "/node/node" + std::to_string(n);
+                make_dir(dir);
+                write(dir + "/cpulist", node_cpulists[n]);
+            }
+        }
+        catch (...)
+        {
+            remove_tree(m_root);
+            throw;
+        }
+    }
+
+    simulated_sysfs(const simulated_sysfs &) = delete;
+    simulated_sysfs & operator=(const simulated_sysfs &) = delete;
+
+    ~simulated_sysfs()
+    {
+        remove_tree(m_root);
+    }
+
+    const std::string & root() const
+    {
+        return m_root;
+    }
+
+    // A cpu with its core, and L1 data and instruction, L2 and L3 caches shared by the given cpus.
+    void add_cpu(unsigned int cpu, unsigned int package, unsigned int core,
+        const std::string & l1_cpulist, const std::string & l2_cpulist, const std::string & l3_cpulist)
+    {
+        auto dir = m_root + "/cpu/cpu" + std::to_string(cpu);
+        make_dir(dir + "/topology");
+        write(dir + "/topology/physical_package_id", std::to_string(package));
+        write(dir + "/topology/core_id", std::to_string(core));
+
+        struct cache { const char * level; const char * type; const char * size; std::string cpulist; };
+        std::vector<cache> caches{ { "1", "Data", "48K", l1_cpulist }, { "1", "Instruction", "32K", l1_cpulist },
+            { "2", "Unified", "2048K", l2_cpulist }, { "3", "Unified", "32M", l3_cpulist } };
+        for (std::size_t i = 0; i < caches.size(); ++i)
+        {
+            auto cacheDir = dir + "/cache/index" + std::to_string(i);
+            make_dir(cacheDir);
+            write(cacheDir + "/level", caches[i].level);
+            write(cacheDir + "/type", caches[i].type);
+            write(cacheDir + "/size", caches[i].size);
+            write(cacheDir + "/shared_cpu_list", caches[i].cpulist);
+        }
+    }
+
+private:
+    // Makes path and any missing parents below the root.
+    void make_dir(const std::string & path)
+    {
+        for (auto slash = path.find('/', m_root.size() + 1); ; slash = path.find('/', slash + 1))
+        {
+            auto dir = path.substr(0, slash);
+            if (mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST)
+            {
+                throw std::runtime_error("cannot create simulated sysfs directory " + dir + ".");
+            }
+            if (slash == std::string::npos)
+            {
+                break;
+            }
+        }
+    }
+
+    static void write(const std::string & path, const std::string & content)
+    {
+        std::ofstream f(path);
+        if (!(f << content << "\n"))
+        {
+            throw std::runtime_error("cannot write simulated sysfs file " + path + ".");
+        }
+    }
+
+    // Children first, without following symbolic links.
+    static void remove_tree(const std::string & path)
+    {
+        nftw(path.c_str(), [](const char * p, const struct stat *, int, struct FTW *) { return std::remove(p); }, 16, FTW_DEPTH | FTW_PHYS);
+    }
+
+    std::string m_root;
+};
+
+}
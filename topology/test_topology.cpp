@@ -0,0 +1,316 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread -march=native test_topology.cpp -latomic
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+#include "topology.h"
+#include "simulated_sysfs.h"
+#include "../queue/queue.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <future>
+#include <chrono>
+#include <stdexcept>
+
+#include <unistd.h>
+
+using std::cout;
+using std::vector;
+using std::string;
+using std::logic_error;
+using std::flush;
+using lockfree::cpu_topology;
+using lockfree::simulated_sysfs;
+using lockfree::pair_placement;
+namespace chrono = std::chrono;
+
+bool testcase_parse_cpulist()
+{
+    bool bResult = false;
+    try
+    {
+        if (cpu_topology::parse_cpulist("0-3,8,10-11\n") != vector<unsigned int>{ 0, 1, 2, 3, 8, 10, 11 })
+            throw logic_error("bad parse of ranges.");
+        if (!cpu_topology::parse_cpulist("\n").empty())
+            throw logic_error("bad parse of empty list.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : parse cpulist test." << std::flush;
+    return bResult;
+}
+
+// The simulated tree is removed when the test using it throws.
+bool testcase_simulated_sysfs_cleanup()
+{
+    bool bResult = false;
+    string root;
+    try
+    {
+        try
+        {
+            simulated_sysfs sysfs({ "0-1" });
+            sysfs.add_cpu(0, 0, 0, "0", "0-1", "0-1");
+            root = sysfs.root();
+            if (access((root + "/cpu/cpu0/cache/index3/size").c_str(), F_OK) != 0) throw logic_error("simulated cpu not written.");
+            throw std::runtime_error("failing test.");
+        }
+        catch (std::runtime_error &)
+        {
+        }
+        if (root.empty() || access(root.c_str(), F_OK) == 0) throw logic_error("simulated sysfs left behind.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : simulated sysfs cleanup test - tree removed on the exception path." << std::flush;
+    return bResult;
+}
+
+bool testcase_simulated_topology()
+{
+    bool bResult = false;
+    try
+    {
+        simulated_sysfs sysfs({ "0-1,4-5", "2-3,6-7" });
+        cpu_topology t(sysfs.root());
+
+        if (t.node_count() != 2) throw logic_error("unexpected node count.");
+        if (t.cpu_count() != 8) throw logic_error("unexpected cpu count.");
+        if (t.node_of_cpu(5) != 0 || t.node_of_cpu(6) != 1) throw logic_error("unexpected node of cpu.");
+        if (t.cpus_of_node(1) != vector<unsigned int>{ 2, 3, 6, 7 }) throw logic_error("unexpected cpus of node.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : simulated two node topology test." << std::flush;
+    return bResult;
+}
+
+bool testcase_fallback_topology()
+{
+    bool bResult = false;
+    try
+    {
+        cpu_topology t("/nonexistent");
+
+        if (t.node_count() != 1) throw logic_error("fallback must have one node.");
+        if (t.cpu_count() == 0) throw logic_error("fallback must have all cpus.");
+        if (t.current_node() != 0) throw logic_error("fallback current node must be 0.");
+
+        // The real topology must at least know the cpu this thread runs on.
+        auto & s = cpu_topology::system();
+        if (s.current_node() >= s.node_count()) throw logic_error("current node out of range.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : fallback and system topology test." << std::flush;
+    return bResult;
+}
+
+// Two packages, a node each, of two cores with two SMT threads each.
+// cpu i is on core i % 4, whose siblings are i and i + 4.
+bool testcase_simulated_cores_and_caches()
+{
+    bool bResult = false;
+    try
+    {
+        simulated_sysfs sysfs({ "0-1,4-5", "2-3,6-7" });
+        for (unsigned int cpu = 0; cpu < 8; ++cpu)
+        {
+            auto core = cpu % 4;
+            auto package = core / 2;
+            auto siblings = std::to_string(core) + "," + std::to_string(core + 4);
+            auto packageCpus = (package == 0) ? "0-1,4-5" : "2-3,6-7";
+            sysfs.add_cpu(cpu, package, core % 2, siblings, siblings, packageCpus);
+        }
+        cpu_topology t(sysfs.root());
+
+        if (t.core_count() != 4) throw logic_error("unexpected core count.");
+        if (t.core_of_cpu(1) != t.core_of_cpu(5) || t.core_of_cpu(1) == t.core_of_cpu(3)) throw logic_error("core ids repeat across packages.");
+        if (t.package_of_cpu(6) != 1) throw logic_error("unexpected package of cpu.");
+        if (t.smt_siblings(1) != vector<unsigned int>{ 1, 5 }) throw logic_error("unexpected smt siblings.");
+        if (t.caches_of_cpu(0).size() != 3) throw logic_error("instruction cache not skipped.");
+        if (t.caches_of_cpu(0)[2].size != 32u << 20) throw logic_error("unexpected cache size.");
+        if (t.cpus_sharing_cache(1, 3) != vector<unsigned int>{ 0, 1, 4, 5 }) throw logic_error("unexpected l3 sharers.");
+        if (!t.share_cache(2, 6, 2) || t.share_cache(2, 3, 2)) throw logic_error("unexpected l2 sharing.");
+
+        auto shared = t.plan_pairs(4, pair_placement::shared_cache);
+        if (shared.size() != 4) throw logic_error("unexpected shared cache plan size.");
+        for (auto & pair : shared)
+        {
+            if (t.core_of_cpu(pair.producer) != t.core_of_cpu(pair.consumer)) throw logic_error("shared cache pair not smt siblings.");
+        }
+
+        auto separate = t.plan_pairs(4, pair_placement::separate_cores);
+        if (separate.size() != 2) throw logic_error("separate cores plan not one cpu per core.");
+        for (auto & pair : separate)
+        {
+            if (t.share_cache(pair.producer, pair.consumer, 2) || t.node_of_cpu(pair.producer) != t.node_of_cpu(pair.consumer))
+                throw logic_error("separate cores pair shares l2 or crosses nodes.");
+        }
+
+        auto remote = t.plan_pairs(1, pair_placement::separate_nodes);
+        if (remote.size() != 1 || t.node_of_cpu(remote[0].producer) == t.node_of_cpu(remote[0].consumer))
+            throw logic_error("separate nodes pair on one node.");
+
+        // no cache or core files, so each cpu is a core of its own.
+        simulated_sysfs bareSysfs({ "0-3" });
+        cpu_topology bare(bareSysfs.root());
+        if (bare.core_count() != 4 || bare.smt_siblings(2) != vector<unsigned int>{ 2 }) throw logic_error("cpu without topology files not a core of its own.");
+        if (!bare.plan_pairs(2, pair_placement::shared_cache).empty()) throw logic_error("shared cache pair without cache info.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : simulated cores and caches test - smt siblings, cache sharing and placement plans." << std::flush;
+    return bResult;
+}
+
+bool testcase_pinning()
+{
+    bool bResult = false;
+    try
+    {
+        auto & s = cpu_topology::system();
+        auto cpu = s.cpus().front();
+        bool pinned = false;
+        unsigned int ranOn = 0;
+        std::thread t([&pinned, &ranOn, cpu]() {
+            pinned = cpu_topology::pin_this_thread(cpu);
+            ranOn = cpu_topology::current_cpu();
+        });
+        t.join();
+        if (pinned && ranOn != cpu) throw logic_error("pinned thread ran on another cpu.");
+        if (cpu_topology::pin_this_thread(CPU_SETSIZE)) throw logic_error("pinned to a cpu out of range.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+
+    cout << " : pinning test." << std::flush;
+    return bResult;
+}
+
+// Round trips of an item between the producer and consumer of a pair, pinned as planned.
+// Reports the cost of a round trip per placement this machine allows. Not a pass or fail criterion.
+bool testcase_placement_benchmark()
+{
+    static const int round_trips = 100000;
+
+    auto & s = cpu_topology::system();
+    cout << "\n success : placement benchmark - " << s.cpus().size() << " cpus, " << s.core_count() << " cores, "
+        << s.node_count() << " nodes, ns per round trip:";
+    const char * separator = " ";
+
+    const char * names[] = { "shared cache", "separate cores", "separate nodes" };
+    pair_placement placements[] = { pair_placement::shared_cache, pair_placement::separate_cores, pair_placement::separate_nodes };
+    for (int p = 0; p < 3; ++p)
+    {
+        auto plan = s.plan_pairs(1, placements[p]);
+        if (plan.empty())
+        {
+            cout << separator << names[p] << " n/a";
+            separator = ", ";
+            continue;
+        }
+
+        lockfree::queue<int> ping;
+        lockfree::queue<int> pong;
+        auto start = chrono::steady_clock::now();
+        std::thread consumer([&ping, &pong, &plan]() {
+            cpu_topology::pin_this_thread(plan[0].consumer);
+            int item;
+            for (int i = 0; i < round_trips; ++i)
+            {
+                while (!ping.pop(item));
+                pong.push(item);
+            }
+        });
+        std::thread producer([&ping, &pong, &plan]() {
+            cpu_topology::pin_this_thread(plan[0].producer);
+            int item;
+            for (int i = 0; i < round_trips; ++i)
+            {
+                ping.push(i);
+                while (!pong.pop(item));
+            }
+        });
+        producer.join();
+        consumer.join();
+        auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        cout << separator << names[p] << " " << ns / round_trips;
+        separator = ", ";
+    }
+    cout << "." << std::flush;
+    return true;
+}
+
+#define RUN_TEST(testcase) { if (!testcase()) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_parse_cpulist);
+    RUN_TEST(testcase_simulated_sysfs_cleanup);
+    RUN_TEST(testcase_simulated_topology);
+    RUN_TEST(testcase_fallback_topology);
+    RUN_TEST(testcase_simulated_cores_and_caches);
+    RUN_TEST(testcase_pinning);
+    RUN_TEST(testcase_placement_benchmark);
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
@@ -0,0 +1,469 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// CPU topology discovery using the Linux sysfs, thread pinning, and placement plans.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+NUMA nodes and their cpus are read from
+    <sysfs_root>/node/online            eg. "0-1"
+    <sysfs_root>/node/node<N>/cpulist   eg. "0-7,16-23"
+Cores, SMT siblings and caches of each cpu are read from
+    <sysfs_root>/cpu/cpu<N>/topology/physical_package_id
+    <sysfs_root>/cpu/cpu<N>/topology/core_id
+    <sysfs_root>/cpu/cpu<N>/cache/index<K>/level, type, size, shared_cpu_list
+The default sysfs_root is /sys/devices/system.
+A different root can be given to describe a simulated topology, eg. for testing.
+
+If the files cannot be read, eg. on a kernel without NUMA support or on a different OS,
+the topology falls back to a single node that has all cpus.
+A cpu without topology files is a core of its own, and one without cache files shares no cache.
+
+Node ids are the sysfs ids, so node_count() is the highest node id + 1.
+Core ids are numbered densely from 0 over all packages, since sysfs core_id repeats across packages.
+
+Pinning:
+pin_this_thread(cpu) and pin_thread(thread, cpu) set the affinity of a thread to one cpu
+with pthread_setaffinity_np. They return false if that fails, eg. on a different OS, or for a cpu
+outside the cpuset of the process. A pinned thread no longer migrates, so current_node() stays true.
+
+Placement plans:
+The locks and queues of this repo assume a software thread per hardware core. plan_pairs() picks
+the cpus of producer consumer pairs, for a benchmark or an executor to pin its threads to.
+    shared_cache    : both on cpus that share the cache of the given level, eg. SMT siblings or
+                      cores of one L2 cluster. Handoffs stay in that cache.
+    separate_cores  : on different cores that do not share the cache of the given level, on the same
+                      node where possible. Handoffs cross the cache, as between most pairs of threads.
+    separate_nodes  : on different nodes. Handoffs cross the interconnect.
+Each cpu is used by one pair at most, and separate_cores and separate_nodes use one cpu per core.
+A plan may have fewer pairs than asked for, eg. none on a machine with one cpu.
+*/
+
+namespace lockfree
+{
+
+enum class pair_placement
+{
+    shared_cache,
+    separate_cores,
+    separate_nodes
+};
+
+struct pair_plan
+{
+    unsigned int producer;
+    unsigned int consumer;
+};
+
+class cpu_topology
+{
+public:
+    // A data or unified cache of a cpu.
+    struct cache_info
+    {
+        unsigned int level;
+        std::size_t size;
+        std::vector<unsigned int> cpus;
+    };
+
+    explicit cpu_topology(const std::string & sysfs_root = "/sys/devices/system")
+    {
+        std::vector<unsigned int> nodes;
+        std::string online;
+        if (read_line(sysfs_root + "/node/online", online))
+        {
+            nodes = parse_cpulist(online);
+        }
+
+        for (auto node : nodes)
+        {
+            std::string cpulist;
+            if (!read_line(sysfs_root + "/node/node" + std::to_string(node) + "/cpulist", cpulist))
+            {
+                continue;
+            }
+            for (auto cpu : parse_cpulist(cpulist))
+            {
+                add(cpu, node);
+            }
+        }
+
+        if (m_cpusOfNode.empty())
+        {
+            unsigned int cpus = std::thread::hardware_concurrency();
+            for (unsigned int cpu = 0; cpu < (cpus ? cpus : 1); ++cpu)
+            {
+                add(cpu, 0);
+            }
+        }
+
+        std::sort(m_cpus.begin(), m_cpus.end());
+        m_coreOfCpu.resize(cpu_count(), 0);
+        m_packageOfCpu.resize(cpu_count(), 0);
+        m_cachesOfCpu.resize(cpu_count());
+        std::map<std::uint64_t, unsigned int> cores;
+        for (auto cpu : m_cpus)
+        {
+            read_cpu(sysfs_root + "/cpu/cpu" + std::to_string(cpu), cpu, cores);
+        }
+        m_coreCount = static_cast<unsigned int>(cores.size());
+    }
+
+    // Topology of the machine this process runs on, read once.
+    static const cpu_topology & system()
+    {
+        static const cpu_topology t;
+        return t;
+    }
+
+    unsigned int node_count() const
+    {
+        return static_cast<unsigned int>(m_cpusOfNode.size());
+    }
+
+    // Highest cpu id + 1.
+    unsigned int cpu_count() const
+    {
+        return static_cast<unsigned int>(m_nodeOfCpu.size());
+    }
+
+    // Node 0 for a cpu id that is not known.
+    unsigned int node_of_cpu(unsigned int cpu) const
+    {
+        return (cpu < m_nodeOfCpu.size()) ? m_nodeOfCpu[cpu] : 0;
+    }
+
+    const std::vector<unsigned int> & cpus_of_node(unsigned int node) const
+    {
+        return m_cpusOfNode.at(node);
+    }
+
+    // Known cpu ids, in order.
+    const std::vector<unsigned int> & cpus() const
+    {
+        return m_cpus;
+    }
+
+    unsigned int core_count() const
+    {
+        return m_coreCount;
+    }
+
+    unsigned int core_of_cpu(unsigned int cpu) const
+    {
+        return (cpu < m_coreOfCpu.size()) ? m_coreOfCpu[cpu] : 0;
+    }
+
+    unsigned int package_of_cpu(unsigned int cpu) const
+    {
+        return (cpu < m_packageOfCpu.size()) ? m_packageOfCpu[cpu] : 0;
+    }
+
+    // cpus of the same core, cpu included.
+    std::vector<unsigned int> smt_siblings(unsigned int cpu) const
+    {
+        std::vector<unsigned int> siblings;
+        for (auto other : m_cpus)
+        {
+            if (core_of_cpu(other) == core_of_cpu(cpu))
+            {
+                siblings.push_back(other);
+            }
+        }
+        return siblings;
+    }
+
+    // Data and unified caches of a cpu, by level.
+    const std::vector<cache_info> & caches_of_cpu(unsigned int cpu) const
+    {
+        return m_cachesOfCpu.at(cpu);
+    }
+
+    // cpus that share the cache of the given level with cpu, cpu included. Only cpu if not known.
+    std::vector<unsigned int> cpus_sharing_cache(unsigned int cpu, unsigned int level) const
+    {
+        if (cpu < m_cachesOfCpu.size())
+        {
+            for (auto & cache : m_cachesOfCpu[cpu])
+            {
+                if (cache.level == level)
+                {
+                    return cache.cpus;
+                }
+            }
+        }
+        return std::vector<unsigned int>{ cpu };
+    }
+
+    bool share_cache(unsigned int cpu1, unsigned int cpu2, unsigned int level) const
+    {
+        auto sharers = cpus_sharing_cache(cpu1, level);
+        return std::find(sharers.begin(), sharers.end(), cpu2) != sharers.end();
+    }
+
+    // Returns up to pairs pairs of cpus, no cpu in more than one pair.
+    std::vector<pair_plan> plan_pairs(unsigned int pairs, pair_placement placement, unsigned int cache_level = 2) const
+    {
+        std::vector<pair_plan> plan;
+        std::vector<bool> used(cpu_count(), false);
+
+        // shared_cache takes any cpu, the others one cpu per core.
+        std::vector<unsigned int> candidates;
+        std::vector<bool> coreTaken(m_coreCount, false);
+        for (auto cpu : m_cpus)
+        {
+            if (placement == pair_placement::shared_cache || !coreTaken[core_of_cpu(cpu)])
+            {
+                coreTaken[core_of_cpu(cpu)] = true;
+                candidates.push_back(cpu);
+            }
+        }
+
+        for (auto producer : candidates)
+        {
+            if (plan.size() == pairs)
+            {
+                break;
+            }
+            if (used[producer])
+            {
+                continue;
+            }
+
+            // lower rank is better. Not a candidate if none.
+            int bestRank = -1;
+            unsigned int consumer = 0;
+            for (auto other : candidates)
+            {
+                if (used[other] || other == producer)
+                {
+                    continue;
+                }
+                int rank = -1;
+                bool sameNode = (node_of_cpu(other) == node_of_cpu(producer));
+                switch (placement)
+                {
+                case pair_placement::shared_cache:
+                    if (core_of_cpu(other) == core_of_cpu(producer)) rank = 0;
+                    else if (share_cache(producer, other, cache_level)) rank = 1;
+                    break;
+                case pair_placement::separate_cores:
+                    if (!share_cache(producer, other, cache_level)) rank = sameNode ? 0 : 1;
+                    break;
+                case pair_placement::separate_nodes:
+                    if (!sameNode) rank = 0;
+                    break;
+                }
+                if (rank >= 0 && (bestRank < 0 || rank < bestRank))
+                {
+                    bestRank = rank;
+                    consumer = other;
+                }
+            }
+
+            if (bestRank >= 0)
+            {
+                used[producer] = true;
+                used[consumer] = true;
+                plan.push_back(pair_plan{ producer, consumer });
+            }
+        }
+        return plan;
+    }
+
+    // Returns false if the thread could not be pinned.
+    static bool pin_this_thread(unsigned int cpu)
+    {
+#ifdef __linux__
+        return pin(pthread_self(), cpu);
+#else
+        return false;
+#endif
+    }
+
+    static bool pin_thread(std::thread & t, unsigned int cpu)
+    {
+#ifdef __linux__
+        return pin(t.native_handle(), cpu);
+#else
+        return false;
+#endif
+    }
+
+    // cpu the calling thread is running on right now. 0 if not known.
+    // Note: The thread may migrate right after, so use the result only as a hint.
+    static unsigned int current_cpu()
+    {
+#ifdef __linux__
+        int cpu = sched_getcpu();
+        return (cpu < 0) ? 0 : static_cast<unsigned int>(cpu);
+#else
+        return 0;
+#endif
+    }
+
+    unsigned int current_node() const
+    {
+        return node_of_cpu(current_cpu());
+    }
+
+    // Parses the kernel list format, eg. "0-3,8,10-11".
+    static std::vector<unsigned int> parse_cpulist(const std::string & list)
+    {
+        std::vector<unsigned int> ids;
+        std::stringstream ss(list);
+        std::string range;
+        while (std::getline(ss, range, ','))
+        {
+            if (range.find_first_of("0123456789") == std::string::npos)
+            {
+                continue;
+            }
+            auto dash = range.find('-');
+            unsigned long first = std::stoul(range.substr(0, dash));
+            unsigned long last = (dash == std::string::npos) ? first : std::stoul(range.substr(dash + 1));
+            for (auto id = first; id <= last; ++id)
+            {
+                ids.push_back(static_cast<unsigned int>(id));
+            }
+        }
+        return ids;
+    }
+
+private:
+    static bool read_line(const std::string & path, std::string & line)
+    {
+        std::ifstream f(path);
+        return f && std::getline(f, line);
+    }
+
+#ifdef __linux__
+    static bool pin(pthread_t thread, unsigned int cpu)
+    {
+        if (cpu >= CPU_SETSIZE)
+        {
+            return false;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+    }
+#endif
+
+    // Parses a cache size, eg. "48K", "2048K", "32M".
+    static std::size_t parse_size(const std::string & text)
+    {
+        if (text.find_first_of("0123456789") == std::string::npos)
+        {
+            return 0;
+        }
+        std::size_t end = 0;
+        std::size_t size = std::stoul(text, &end);
+        auto unit = (end < text.size()) ? text[end] : ' ';
+        if (unit == 'K') size <<= 10;
+        else if (unit == 'M') size <<= 20;
+        else if (unit == 'G') size <<= 30;
+        return size;
+    }
+
+    // cores maps package and core_id to the dense core id.
+    void read_cpu(const std::string & dir, unsigned int cpu, std::map<std::uint64_t, unsigned int> & cores)
+    {
+        std::string package;
+        std::string core;
+        std::uint64_t key;
+        if (read_line(dir + "/topology/physical_package_id", package) && read_line(dir + "/topology/core_id", core) &&
+            package.find_first_of("0123456789") != std::string::npos && core.find_first_of("0123456789") != std::string::npos)
+        {
+            m_packageOfCpu[cpu] = static_cast<unsigned int>(std::stoul(package));
+            key = (static_cast<std::uint64_t>(m_packageOfCpu[cpu]) << 32) | std::stoul(core);
+        }
+        else
+        {
+            // a core of its own.
+            key = (static_cast<std::uint64_t>(1) << 63) | cpu;
+        }
+        auto inserted = cores.insert(std::make_pair(key, static_cast<unsigned int>(cores.size())));
+        m_coreOfCpu[cpu] = inserted.first->second;
+
+        for (unsigned int index = 0; ; ++index)
+        {
+            auto cacheDir = dir + "/cache/index" + std::to_string(index);
+            std::string level;
+            if (!read_line(cacheDir + "/level", level) || level.find_first_of("0123456789") == std::string::npos)
+            {
+                break;
+            }
+            std::string type;
+            read_line(cacheDir + "/type", type);
+            if (type == "Instruction")
+            {
+                continue;
+            }
+            cache_info cache;
+            cache.level = static_cast<unsigned int>(std::stoul(level));
+            std::string size;
+            cache.size = read_line(cacheDir + "/size", size) ? parse_size(size) : 0;
+            std::string shared;
+            if (read_line(cacheDir + "/shared_cpu_list", shared))
+            {
+                cache.cpus = parse_cpulist(shared);
+            }
+            if (cache.cpus.empty())
+            {
+                cache.cpus.push_back(cpu);
+            }
+            m_cachesOfCpu[cpu].push_back(cache);
+        }
+    }
+
+    void add(unsigned int cpu, unsigned int node)
+    {
+        if (cpu >= m_nodeOfCpu.size())
+        {
+            m_nodeOfCpu.resize(cpu + 1, 0);
+        }
+        m_nodeOfCpu[cpu] = node;
+
+        if (node >= m_cpusOfNode.size())
+        {
+            m_cpusOfNode.resize(node + 1);
+        }
+        m_cpusOfNode[node].push_back(cpu);
+        m_cpus.push_back(cpu);
+    }
+
+    std::vector<unsigned int> m_nodeOfCpu;
+    std::vector<std::vector<unsigned int>> m_cpusOfNode;
+    std::vector<unsigned int> m_cpus;
+    std::vector<unsigned int> m_coreOfCpu;
+    std::vector<unsigned int> m_packageOfCpu;
+    std::vector<std::vector<cache_info>> m_cachesOfCpu;
+    unsigned int m_coreCount;
+};
+
+}
@@ -0,0 +1,179 @@
+//
+// use the following command line to build using gcc
+// g++ -std=c++11 -pthread -march=native test_trace.cpp -latomic
+//
+
+// To enable output of more info on failure.
+#define PRINT_TRACE
+
+// Turns on the trace points of the containers and locks.
+#define LOCKFREE_TRACE
+
+#include "trace.h"
+#include "../queue/queue.h"
+#include "../mutex/shared_mutex.h"
+#include "../parking_lot/parking_lot.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <future>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <stdexcept>
+#include <csignal>
+
+using std::cout;
+using std::vector;
+using std::string;
+using std::logic_error;
+using std::flush;
+using std::future;
+namespace chrono = std::chrono;
+
+using lockfree::trace_recorder;
+
+string read_file(const string & path)
+{
+    std::ifstream in(path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+unsigned int count_of(const string & text, const string & what)
+{
+    unsigned int count = 0;
+    for (auto pos = text.find(what); pos != string::npos; pos = text.find(what, pos + 1))
+    {
+        count++;
+    }
+    return count;
+}
+
+bool testcase_sanity()
+{
+    bool bResult = false;
+    const string path = "/tmp/lockfree_trace_sanity.json";
+    try
+    {
+        auto id = trace_recorder::register_event("my_event");
+        trace_recorder::record(id, 42);
+
+        // overwrite oldest: only the last ring_capacity events of a thread are kept.
+        std::thread([id]() {
+            for (unsigned int i = 0; i < 3 * trace_recorder::ring_capacity; ++i)
+            {
+                trace_recorder::record(id + 1, i);
+            }
+        }).join();
+
+        if (!trace_recorder::dump(path)) throw logic_error("dump failed.");
+        auto text = read_file(path);
+        if (text.compare(0, 16, "{\"traceEvents\":[") != 0) throw logic_error("not a chrome trace.");
+        if (count_of(text, "\"name\":\"my_event\"") != 1) throw logic_error("registered event not dumped.");
+        if (text.find("\"arg\":42}") == string::npos) throw logic_error("argument not dumped.");
+        if (count_of(text, "\"name\":\"event_") != trace_recorder::ring_capacity) throw logic_error("ring did not keep the last events only.");
+        if (text.find(std::to_string(3 * trace_recorder::ring_capacity - 1) + "}}") == string::npos) throw logic_error("newest event missing.");
+
+        cout << "\n success";
+        bResult = true;
+    }
+    catch (std::exception & e)
+    {
+#ifdef PRINT_TRACE
+        std::cerr << "\n" << e.what();
+#endif
+        cout << "\n FAIL";
+    }
+    std::remove(path.c_str());
+
+    cout << " : sanity test - record, overwrite oldest, dump." << std::flush;
+    return bResult;
+}
+
+// Contended containers and locks emit their trace points.
+bool testcase_trace_points()
+{
+    const string path = "/tmp/lockfree_trace_points.json";
+    {
+        lockfree::queue<int> q;
+        lockfree::shared_mutex m;
+        std::atomic<int> word{ 0 };
+
+        vector<future<void>> vf;
+        for (int t = 0; t < 4; ++t)
+        {
+            vf.emplace_back(async(std::launch::async, [&]() {
+                int item;
+                for (int i = 0; i < 2000; ++i)
+                {
+                    // a refill happens when a pop finds more than one pushed item.
+                    q.push(i);
+                    q.push(i);
+                    q.pop(item);
+                    q.pop(item);
+                    m.lock();
+                    m.unlock();
+                    m.lock_shared();
+                    m.unlock_shared();
+                }
+            }));
+        }
+        // park one thread, then wake it.
+        auto parked = async(std::launch::async, [&word]() { lockfree::parking_lot::wait(word, 0); });
+        std::this_thread::sleep_for(chrono::milliseconds(20));
+        word.store(1);
+        lockfree::parking_lot::notify_all(word);
+        parked.wait();
+        for (auto & task : vf)
+        {
+            task.wait();
+        }
+    }
+
+    bool failed = !trace_recorder::dump(path);
+    auto text = read_file(path);
+    failed = failed || (text.find("\"name\":\"queue_refill\"") == string::npos);
+    failed = failed || (text.find("\"name\":\"park\",\"ph\":\"B\"") == string::npos);
+    failed = failed || (text.find("\"name\":\"park\",\"ph\":\"E\"") == string::npos);
+    failed = failed || (text.find("\"name\":\"unpark\"") == string::npos);
+    std::remove(path.c_str());
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : trace points test - queue, shared_mutex and parking_lot events dumped." << std::flush;
+    return !failed;
+}
+
+bool testcase_signal()
+{
+    const string path = "/tmp/lockfree_trace_signal.json";
+    trace_recorder::dump_on_signal(SIGUSR1, path);
+
+    auto before = trace_recorder::signal_dumps();
+    std::raise(SIGUSR1);
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(10);
+    while (trace_recorder::signal_dumps() == before && chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    bool failed = read_file(path).find("traceEvents") == string::npos;
+    std::remove(path.c_str());
+
+    cout << (failed ? "\n FAIL" : "\n success");
+    cout << " : signal test - dump on signal." << std::flush;
+    return !failed;
+}
+
+#define RUN_TEST(testcase) { if (!testcase()) return 1;}
+int main(int argc, char ** argv)
+{
+    RUN_TEST(testcase_sanity);
+    RUN_TEST(testcase_trace_points);
+    RUN_TEST(testcase_signal);
+
+    cout << "\ndone\n" << flush;
+    return 0;
+}
@@ -0,0 +1,392 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include "trace_point.h"
+#include "../util/cache_line.h"
+#include "../util/timestamp.h"
+#include "../mutex/spin_lock.h"
+
+#include <atomic>
+#include <algorithm>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <semaphore.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_release;
+
+// Flight recorder of per-thread trace rings, dumped in Chrome trace format, using C++11.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+//      and -DLOCKFREE_TRACE to turn on the trace points of the containers and locks.
+
+/*
+Notes:
+Every thread that records gets a ring of the last ring_capacity events. The oldest are overwritten.
+An event is a timestamp from read_timestamp() of timestamp.h, an event id, and a 64 bit argument.
+Recording is a thread_local load, a timestamp read, three plain stores and a release store;
+no atomic read-modify-write, and no shared cache line is written. So it can stay on in production.
+
+dump(path) writes the rings of all threads, live or exited, as a JSON file that
+chrome://tracing and Perfetto open. Events are instant events; park_begin and park_end
+are shown as the duration parked.
+dump_on_signal(signo, path) dumps on the signal, eg. SIGUSR1, from a helper thread,
+since formatting is not async signal safe. The handler only posts a semaphore.
+register_event(name) adds an event type of the application, recorded with record(id, arg).
+
+Design:
+A ring is written only by its thread: store the event in slot head, then store head + 1 with release.
+dump() reads head with acquire, copies the slots, then reads head again. Slots the writer may
+have overwritten while they were copied, those below the second head minus capacity, are discarded.
+Rings are kept in a list under a spin_lock, which only the first record() of a thread and dump() take.
+A ring is released when its thread exits, so its events stay for dumps, until a new thread reuses it.
+*/
+
+namespace lockfree
+{
+
+class trace_recorder
+{
+public:
+    static const unsigned int ring_capacity = 4096;
+
+    // Hot path.
+    static void record(std::uint32_t event, std::uint64_t arg)
+    {
+        this_thread_ring().record(event, arg);
+    }
+
+    static void record(trace_event event, std::uint64_t arg)
+    {
+        record(static_cast<std::uint32_t>(event), arg);
+    }
+
+    // Returns the id to record the new event type with.
+    static std::uint32_t register_event(const std::string & name)
+    {
+        auto & r = instance();
+        std::lock_guard<spin_lock> lk(r.m_lock);
+        r.m_userEvents.push_back(name);
+        return static_cast<std::uint32_t>(trace_event::first_user) + static_cast<std::uint32_t>(r.m_userEvents.size()) - 1;
+    }
+
+    // Returns false if the file could not be written.
+    static bool dump(const std::string & path)
+    {
+        auto fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            return false;
+        }
+        auto ok = dump(fd);
+        ::close(fd);
+        return ok;
+    }
+
+    static bool dump(int fd)
+    {
+        return instance().dump_all(fd);
+    }
+
+    // Dumps to path whenever signo is raised. Call once per signal.
+    static void dump_on_signal(int signo, const std::string & path)
+    {
+        auto & r = instance();
+        {
+            std::lock_guard<spin_lock> lk(r.m_lock);
+            if (!r.m_signalThread.joinable())
+            {
+                r.m_signalThread = std::thread([&r]() { r.signal_dumper(); });
+            }
+            r.m_signalPaths.push_back(std::make_pair(signo, path));
+        }
+        std::signal(signo, &trace_recorder::on_signal);
+    }
+
+    // Count of dumps done by dump_on_signal. For tests.
+    static unsigned int signal_dumps()
+    {
+        return instance().m_signalDumps.load(memory_order_acquire);
+    }
+
+private:
+    struct event_record
+    {
+        std::uint64_t stamp;
+        std::uint64_t arg;
+        std::uint32_t event;
+        std::uint32_t tid;
+    };
+
+    class ring : public cache_aligned
+    {
+    public:
+        ring() : m_head{ 0 }, m_owned{ true }, m_tid(0)
+        {
+        }
+
+        void claim_by_this_thread()
+        {
+            m_tid = static_cast<std::uint32_t>(::syscall(SYS_gettid));
+        }
+
+        void record(std::uint32_t event, std::uint64_t arg)
+        {
+            // Only this thread writes head.
+            auto head = m_head.load(memory_order_relaxed);
+            auto & e = m_events[head & (ring_capacity - 1)];
+            e.stamp = read_timestamp();
+            e.arg = arg;
+            e.event = event;
+            e.tid = m_tid;
+            // memory_order_release due to the event written must be visible to dump() with the head.
+            m_head.store(head + 1, memory_order_release);
+        }
+
+        // Appends the events still intact.
+        void copy(std::vector<event_record> & out) const
+        {
+            // memory_order_acquire due to the events up to head must be visible.
+            auto head = m_head.load(memory_order_acquire);
+            auto first = (head > ring_capacity) ? head - ring_capacity : 0;
+            auto start = out.size();
+            for (auto i = first; i < head; ++i)
+            {
+                out.push_back(m_events[i & (ring_capacity - 1)]);
+            }
+
+            // memory_order_acquire fence due to the copies above must be ordered before the second read of head.
+            std::atomic_thread_fence(memory_order_acquire);
+            auto after = m_head.load(memory_order_relaxed);
+            auto intact = (after > ring_capacity) ? after - ring_capacity : 0;
+            if (intact > first)
+            {
+                auto torn = std::min<std::uint64_t>(intact - first, out.size() - start);
+                out.erase(out.begin() + start, out.begin() + start + torn);
+            }
+        }
+
+        bool try_claim()
+        {
+            bool expected = false;
+            return m_owned.compare_exchange_strong(expected, true, memory_order_acquire, memory_order_relaxed);
+        }
+
+        void release()
+        {
+            m_owned.store(false, memory_order_release);
+        }
+
+    private:
+        event_record m_events[ring_capacity];
+        std::atomic<std::uint64_t> m_head;
+        std::atomic<bool> m_owned;
+        std::uint32_t m_tid;
+    };
+
+    struct ring_holder
+    {
+        ring_holder() : pRing(instance().acquire_ring())
+        {
+        }
+
+        ~ring_holder()
+        {
+            pRing->release();
+        }
+
+        ring * pRing;
+    };
+
+    trace_recorder() : m_pendingSignal{ 0 }, m_signalDumps{ 0 }, m_stop{ false }
+    {
+        sem_init(&m_signalSem, 0, 0);
+    }
+
+    ~trace_recorder()
+    {
+        if (m_signalThread.joinable())
+        {
+            m_stop.store(true, memory_order_release);
+            sem_post(&m_signalSem);
+            m_signalThread.join();
+        }
+        sem_destroy(&m_signalSem);
+        // Rings are not freed; threads still running at exit may record into them.
+    }
+
+    static trace_recorder & instance()
+    {
+        static trace_recorder r;
+        return r;
+    }
+
+    static ring & this_thread_ring()
+    {
+        static thread_local ring_holder holder;
+        return *holder.pRing;
+    }
+
+    ring * acquire_ring()
+    {
+        std::lock_guard<spin_lock> lk(m_lock);
+        for (auto pRing : m_rings)
+        {
+            if (pRing->try_claim())
+            {
+                pRing->claim_by_this_thread();
+                return pRing;
+            }
+        }
+        auto pRing = new ring;
+        pRing->claim_by_this_thread();
+        m_rings.push_back(pRing);
+        return pRing;
+    }
+
+    static void on_signal(int signo)
+    {
+        auto & r = instance();
+        r.m_pendingSignal.store(signo, memory_order_relaxed);
+        // sem_post is async signal safe.
+        sem_post(&r.m_signalSem);
+    }
+
+    void signal_dumper()
+    {
+        for (;;)
+        {
+            while (sem_wait(&m_signalSem) != 0)
+            {
+            }
+            if (m_stop.load(memory_order_acquire))
+            {
+                return;
+            }
+
+            auto signo = m_pendingSignal.load(memory_order_relaxed);
+            std::string path;
+            {
+                std::lock_guard<spin_lock> lk(m_lock);
+                for (auto & p : m_signalPaths)
+                {
+                    if (p.first == signo)
+                    {
+                        path = p.second;
+                    }
+                }
+            }
+            if (!path.empty())
+            {
+                dump(path);
+            }
+            m_signalDumps.fetch_add(1, memory_order_release);
+        }
+    }
+
+    static std::string event_name(std::uint32_t event, const std::vector<std::string> & userEvents)
+    {
+        static const char * const names[] = {
+            "queue_cas_retry", "queue_refill", "stack_cas_retry", "shared_mutex_cas_retry",
+            "shared_mutex_wait_readers", "park", "park", "unpark" };
+
+        if (event < sizeof(names) / sizeof(names[0]))
+        {
+            return names[event];
+        }
+        auto user = event - static_cast<std::uint32_t>(trace_event::first_user);
+        if (event >= static_cast<std::uint32_t>(trace_event::first_user) && user < userEvents.size())
+        {
+            return userEvents[user];
+        }
+        return "event_" + std::to_string(event);
+    }
+
+    bool dump_all(int fd)
+    {
+        std::lock_guard<std::mutex> dumpLock(m_dumpMutex);
+
+        std::vector<event_record> events;
+        std::vector<std::string> userEvents;
+        {
+            std::lock_guard<spin_lock> lk(m_lock);
+            for (auto pRing : m_rings)
+            {
+                pRing->copy(events);
+            }
+            userEvents = m_userEvents;
+        }
+        std::stable_sort(events.begin(), events.end(), [](const event_record & a, const event_record & b) { return a.stamp < b.stamp; });
+        m_scale.update();
+
+        std::string out = "{\"traceEvents\":[\n";
+        char buffer[256];
+        bool first = true;
+        for (auto & e : events)
+        {
+            const char * phase = "i";
+            if (e.event == static_cast<std::uint32_t>(trace_event::park_begin))
+            {
+                phase = "B";
+            }
+            else if (e.event == static_cast<std::uint32_t>(trace_event::park_end))
+            {
+                phase = "E";
+            }
+
+            auto name = event_name(e.event, userEvents);
+            auto us = static_cast<double>(m_scale.to_ns(e.stamp)) / 1000.0;
+            std::snprintf(buffer, sizeof(buffer),
+                "%s{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":%d,\"tid\":%u,\"s\":\"t\",\"args\":{\"arg\":%llu}}",
+                first ? "" : ",\n", name.c_str(), phase, us, static_cast<int>(::getpid()), e.tid,
+                static_cast<unsigned long long>(e.arg));
+            out += buffer;
+            first = false;
+        }
+        out += "\n],\"displayTimeUnit\":\"ns\"}\n";
+
+        std::size_t written = 0;
+        while (written < out.size())
+        {
+            auto n = ::write(fd, out.data() + written, out.size() - written);
+            if (n <= 0)
+            {
+                return false;
+            }
+            written += static_cast<std::size_t>(n);
+        }
+        return true;
+    }
+
+    spin_lock m_lock;
+    std::vector<ring *> m_rings;
+    std::vector<std::string> m_userEvents;
+    std::vector<std::pair<int, std::string>> m_signalPaths;
+
+    std::mutex m_dumpMutex;
+    timestamp_scale m_scale;
+
+    sem_t m_signalSem;
+    std::atomic<int> m_pendingSignal;
+    std::atomic<unsigned int> m_signalDumps;
+    std::atomic<bool> m_stop;
+    std::thread m_signalThread;
+};
+
+}
@@ -0,0 +1,46 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+
+// Trace points for the flight recorder in trace.h.
+
+/*
+Notes:
+Trace points compile to nothing unless LOCKFREE_TRACE is defined, eg. with -DLOCKFREE_TRACE.
+So the containers and locks carry them at no cost, and a build can turn them on for production.
+LOCKFREE_TRACE_EVENT(event, arg) records the trace_event named event with a 64 bit argument.
+*/
+
+namespace lockfree
+{
+
+enum class trace_event : std::uint32_t
+{
+    queue_cas_retry,
+    queue_refill,
+    stack_cas_retry,
+    shared_mutex_cas_retry,
+    shared_mutex_wait_readers,
+    park_begin,
+    park_end,
+    unpark,
+
+    // ids from here on are for register_event() of trace.h.
+    first_user = 64
+};
+
+}
+
+#ifdef LOCKFREE_TRACE
+#include "trace.h"
+#define LOCKFREE_TRACE_EVENT(event, arg) \
+    ::lockfree::trace_recorder::record(static_cast<std::uint32_t>(::lockfree::trace_event::event), static_cast<std::uint64_t>(arg))
+#else
+#define LOCKFREE_TRACE_EVENT(event, arg) ((void)0)
+#endif
@@ -0,0 +1,50 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+/*
+Notes:
+Data written by different threads is kept on separate cache lines to avoid false sharing.
+std::hardware_destructive_interference_size is only available from C++17,
+so the common value for x86-64 and most ARM cores is used here.
+
+Heap allocation of an over-aligned type honors the alignment only from C++17.
+Types allocated with new that need cache line alignment derive from cache_aligned,
+which provides class specific operator new and delete that align manually.
+*/
+
+namespace lockfree
+{
+
+static const std::size_t cache_line_size = 64;
+
+struct cache_aligned
+{
+    static void * operator new(std::size_t size)
+    {
+        // over allocate, align, and store the original pointer just before the aligned block.
+        auto raw = static_cast<char *>(::operator new(size + cache_line_size + sizeof(void *)));
+        auto addr = reinterpret_cast<std::uintptr_t>(raw + sizeof(void *));
+        auto aligned = reinterpret_cast<char *>((addr + cache_line_size - 1) & ~(cache_line_size - 1));
+        reinterpret_cast<void **>(aligned)[-1] = raw;
+        return aligned;
+    }
+
+    static void operator delete(void * p)
+    {
+        if (p)
+        {
+            ::operator delete(static_cast<void **>(p)[-1]);
+        }
+    }
+};
+
+}
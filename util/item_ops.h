@@ -0,0 +1,95 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/*
+Notes:
+Containers that keep items in raw storage construct them in place on push, and move them out
+and destroy them on pop. For a trivially copyable T that is a plain copy of the bytes, with no
+destructor to call, and a run of items next to each other copies with a single memcpy.
+item_ops picks the implementation by the std::is_trivially_copyable trait, since if constexpr
+is only available from C++17.
+
+construct_n counts the items it constructed in an out argument, so that a container can tell
+which slots hold an item if a copy constructor throws. The trivially copyable version never throws.
+*/
+
+namespace lockfree
+{
+
+template<typename T, bool trivial = std::is_trivially_copyable<T>::value>
+struct item_ops
+{
+    static const bool is_trivial = false;
+
+    template<typename U>
+    static void construct(T * p, U && item)
+    {
+        new (p) T(std::forward<U>(item));
+    }
+
+    static void construct_n(T * p, const T * items, std::size_t count, std::size_t & constructed)
+    {
+        for (constructed = 0; constructed < count; ++constructed)
+        {
+            new (p + constructed) T(items[constructed]);
+        }
+    }
+
+    // Moves the item to the client, and destroys the copy held.
+    static void move_out(T & item, T * p)
+    {
+        item = std::move(*p);
+        p->~T();
+    }
+
+    static void move_out_n(T * items, T * p, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            move_out(items[i], p + i);
+        }
+    }
+};
+
+template<typename T>
+struct item_ops<T, true>
+{
+    static const bool is_trivial = true;
+
+    template<typename U>
+    static void construct(T * p, U && item)
+    {
+        const T & source = item;
+        std::memcpy(static_cast<void *>(p), &source, sizeof(T));
+    }
+
+    static void construct_n(T * p, const T * items, std::size_t count, std::size_t & constructed)
+    {
+        std::memcpy(static_cast<void *>(p), items, count * sizeof(T));
+        constructed = count;
+    }
+
+    // No destructor to call.
+    static void move_out(T & item, T * p)
+    {
+        std::memcpy(static_cast<void *>(&item), p, sizeof(T));
+    }
+
+    static void move_out_n(T * items, T * p, std::size_t count)
+    {
+        std::memcpy(static_cast<void *>(items), p, count * sizeof(T));
+    }
+};
+
+}
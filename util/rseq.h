@@ -0,0 +1,223 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__linux__) && defined(__x86_64__) && defined(__has_include)
+#if __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#include <unistd.h>
+#define LOCKFREE_HAS_RSEQ 1
+#endif
+#endif
+
+// Per-cpu operations that commit without atomic instructions, using Linux restartable sequences.
+
+// To build using gcc need the following options
+//      -std=c++11 -pthread
+
+/*
+Notes:
+A restartable sequence is a short critical section that the kernel aborts if the thread is preempted,
+migrated or signaled before it commits, by jumping to an abort handler instead of resuming it.
+So a thread that checks it runs on cpu N at the start of the section can update data of cpu N with
+plain loads and stores, and ends with a single store that commits. No other thread on cpu N can run
+in between, and threads on other cpus never touch the data of cpu N.
+glibc from 2.35 registers a struct rseq for every thread, at __rseq_offset from the thread pointer.
+
+rseq_ops::available()   : false if glibc did not register, eg. an older glibc, a kernel before 4.18,
+                          or GLIBC_TUNABLES=glibc.pthread.rseq=0, or not x86-64.
+rseq_ops::current_cpu() : cpu of the calling thread from the struct rseq, without a system call.
+rseq_ops::cpu_slots()   : cpu ids are below this.
+Operations, each on the data of the given cpu, which must be the current cpu:
+    compare_store(v, expect, desired, cpu)          : if *v == expect, *v = desired.
+    compare_not_pop(v, expect_not, offset, pLoad, cpu)  : if *v != expect_not, *pLoad = *v, and
+                                                      *v = the word at offset in the object *v points to.
+                                                      ie. pop from the list whose top is *v.
+    add(v, count, cpu)                              : *v += count.
+They return aborted if the thread was preempted or migrated, or is not on cpu, and the caller retries.
+The critical sections are x86-64 assembly. On other architectures available() is false,
+and the callers fall back to atomics.
+
+The sections follow the layout of the kernel selftests and librseq: a descriptor in section __rseq_cs,
+and an abort handler in section __rseq_failure preceded by the signature glibc registered.
+*/
+
+namespace lockfree
+{
+
+enum class rseq_status
+{
+    committed,
+    compare_failed,
+    aborted
+};
+
+#ifdef LOCKFREE_HAS_RSEQ
+
+#define LOCKFREE_RSEQ_STR_1(x) #x
+#define LOCKFREE_RSEQ_STR(x) LOCKFREE_RSEQ_STR_1(x)
+
+// Signature glibc registers on x86.
+#define LOCKFREE_RSEQ_SIG 0x53053053
+
+// Labels 1, 2 and 4 are the start, commit and abort of the section, 3 its descriptor.
+// Offsets 4 and 8 of struct rseq are cpu_id and rseq_cs.
+#define LOCKFREE_RSEQ_BEGIN                                     \
+    ".pushsection __rseq_cs, \"aw\"\n\t"                        \
+    ".balign 32\n\t"                                            \
+    "3:\n\t"                                                    \
+    ".long 0, 0\n\t"                                            \
+    ".quad 1f, (2f - 1f), 4f\n\t"                               \
+    ".popsection\n\t"                                           \
+    "leaq 3b(%%rip), %%rax\n\t"                                 \
+    "movq %%rax, %%fs:8(%[rseqOffset])\n\t"                     \
+    "1:\n\t"                                                    \
+    "cmpl %[cpu], %%fs:4(%[rseqOffset])\n\t"                    \
+    "jnz 4f\n\t"
+
+#define LOCKFREE_RSEQ_END                                       \
+    "2:\n\t"                                                    \
+    ".pushsection __rseq_failure, \"ax\"\n\t"                   \
+    ".byte 0x0f, 0xb9, 0x3d\n\t"                                \
+    ".long " LOCKFREE_RSEQ_STR(LOCKFREE_RSEQ_SIG) "\n\t"        \
+    "4:\n\t"                                                    \
+    "jmp %l[aborted]\n\t"                                       \
+    ".popsection\n\t"
+
+#endif
+
+class rseq_ops
+{
+public:
+    static bool available()
+    {
+#ifdef LOCKFREE_HAS_RSEQ
+        static const bool registered = (__rseq_size > 0) && (current_cpu() >= 0) && (cpu_slots() > 0);
+        return registered;
+#else
+        return false;
+#endif
+    }
+
+    // -1 if not registered.
+    static int current_cpu()
+    {
+#ifdef LOCKFREE_HAS_RSEQ
+        return static_cast<int>(area()->cpu_id);
+#else
+        return -1;
+#endif
+    }
+
+    static unsigned int cpu_slots()
+    {
+#ifdef LOCKFREE_HAS_RSEQ
+        static const long slots = sysconf(_SC_NPROCESSORS_CONF);
+        return (slots > 0) ? static_cast<unsigned int>(slots) : 0;
+#else
+        return 0;
+#endif
+    }
+
+    static rseq_status compare_store(std::intptr_t * v, std::intptr_t expect, std::intptr_t desired, int cpu)
+    {
+#ifdef LOCKFREE_HAS_RSEQ
+        __asm__ __volatile__ goto(
+            LOCKFREE_RSEQ_BEGIN
+            "cmpq %[v], %[expect]\n\t"
+            "jnz %l[failed]\n\t"
+            // commit.
+            "movq %[desired], %[v]\n\t"
+            LOCKFREE_RSEQ_END
+            :
+            : [cpu] "r" (cpu),
+              [rseqOffset] "r" (static_cast<long>(__rseq_offset)),
+              [v] "m" (*v),
+              [expect] "r" (expect),
+              [desired] "r" (desired)
+            : "memory", "cc", "rax"
+            : aborted, failed);
+        return rseq_status::committed;
+    aborted:
+        return rseq_status::aborted;
+    failed:
+        return rseq_status::compare_failed;
+#else
+        return rseq_status::aborted;
+#endif
+    }
+
+    static rseq_status compare_not_pop(std::intptr_t * v, std::intptr_t expect_not, std::ptrdiff_t offset, std::intptr_t * pLoad, int cpu)
+    {
+#ifdef LOCKFREE_HAS_RSEQ
+        __asm__ __volatile__ goto(
+            LOCKFREE_RSEQ_BEGIN
+            "movq %[v], %%rbx\n\t"
+            "cmpq %%rbx, %[expectNot]\n\t"
+            "je %l[failed]\n\t"
+            "movq %%rbx, %[load]\n\t"
+            "addq %[offset], %%rbx\n\t"
+            "movq (%%rbx), %%rbx\n\t"
+            // commit.
+            "movq %%rbx, %[v]\n\t"
+            LOCKFREE_RSEQ_END
+            :
+            : [cpu] "r" (cpu),
+              [rseqOffset] "r" (static_cast<long>(__rseq_offset)),
+              [v] "m" (*v),
+              [expectNot] "r" (expect_not),
+              [offset] "er" (offset),
+              [load] "m" (*pLoad)
+            : "memory", "cc", "rax", "rbx"
+            : aborted, failed);
+        return rseq_status::committed;
+    aborted:
+        return rseq_status::aborted;
+    failed:
+        return rseq_status::compare_failed;
+#else
+        return rseq_status::aborted;
+#endif
+    }
+
+    static rseq_status add(std::intptr_t * v, std::intptr_t count, int cpu)
+    {
+#ifdef LOCKFREE_HAS_RSEQ
+        __asm__ __volatile__ goto(
+            LOCKFREE_RSEQ_BEGIN
+            // commit.
+            "addq %[count], %[v]\n\t"
+            LOCKFREE_RSEQ_END
+            :
+            : [cpu] "r" (cpu),
+              [rseqOffset] "r" (static_cast<long>(__rseq_offset)),
+              [v] "m" (*v),
+              [count] "er" (count)
+            : "memory", "cc", "rax"
+            : aborted);
+        return rseq_status::committed;
+    aborted:
+        return rseq_status::aborted;
+#else
+        return rseq_status::aborted;
+#endif
+    }
+
+private:
+#ifdef LOCKFREE_HAS_RSEQ
+    static volatile struct ::rseq * area()
+    {
+        return reinterpret_cast<volatile struct ::rseq *>(static_cast<char *>(__builtin_thread_pointer()) + __rseq_offset);
+    }
+#endif
+};
+
+}
@@ -0,0 +1,89 @@
+//----------------------------------------------------------------------------
+// year   : 2017
+// author : John Paul
+// email  : johnpaultaken@gmail.com
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+Notes:
+read_timestamp() is the cheapest monotonic timestamp of the cpu, for hot paths that record
+now and convert later: the time stamp counter on x86, about a third of the cost of
+steady_clock::now() on virtual machines where the vDSO clock is slow.
+Elsewhere it is steady_clock nanoseconds.
+The time stamp counter is constant rate and synchronized across cores on every x86 cpu of
+the last decade, which is assumed here.
+
+timestamp_scale converts timestamps to steady_clock time. It pairs a timestamp and
+a steady_clock reading at construction, and again at each update(), and interpolates.
+So conversions get more precise the longer apart the two pairs are.
+*/
+
+namespace lockfree
+{
+
+inline std::uint64_t read_timestamp()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+class timestamp_scale
+{
+public:
+    timestamp_scale() :
+        m_startStamp(read_timestamp()), m_startTime(std::chrono::steady_clock::now()), m_nsPerTick(1.0)
+    {
+    }
+
+    // Call now and then, from one thread, eg. the thread that converts.
+    void update()
+    {
+        auto stamp = read_timestamp();
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_startTime).count();
+        if (stamp > m_startStamp && elapsed > 0)
+        {
+            m_nsPerTick = static_cast<double>(elapsed) / static_cast<double>(stamp - m_startStamp);
+        }
+    }
+
+    // Nanoseconds from construction. A timestamp from before construction gives 0.
+    std::int64_t to_ns(std::uint64_t stamp) const
+    {
+        return (stamp > m_startStamp) ? static_cast<std::int64_t>(static_cast<double>(stamp - m_startStamp) * m_nsPerTick) : 0;
+    }
+
+    std::chrono::steady_clock::time_point to_steady(std::uint64_t stamp) const
+    {
+        return m_startTime + std::chrono::nanoseconds(to_ns(stamp));
+    }
+
+    std::chrono::steady_clock::time_point start() const
+    {
+        return m_startTime;
+    }
+
+    double ns_per_tick() const
+    {
+        return m_nsPerTick;
+    }
+
+private:
+    const std::uint64_t m_startStamp;
+    const std::chrono::steady_clock::time_point m_startTime;
+    double m_nsPerTick;
+};
+
+}